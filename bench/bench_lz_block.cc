@@ -0,0 +1,99 @@
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/binary_serializer.hpp"
+#include "../src/lz_block.hpp"
+
+class Trade {
+public:
+  std::string symbol;
+  std::string venue;
+  int64_t price;
+  int32_t quantity;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Trade &x) {
+  return f.object(x).fields(f.field("symbol", x.symbol),
+                            f.field("venue", x.venue),
+                            f.field("price", x.price),
+                            f.field("quantity", x.quantity));
+}
+
+byte_buffer make_trades(size_t num) {
+  std::mt19937 rng{1};
+  std::vector<Trade> trades;
+  for (size_t i = 0; i < num; ++i)
+    trades.push_back(Trade{"SYM" + std::to_string(rng() % 64),
+                           rng() % 2 ? "XNAS" : "XNYS",
+                           static_cast<int64_t>(100000 + rng() % 500),
+                           static_cast<int32_t>(rng() % 1000)});
+  byte_buffer result;
+  binary_serializer sink(result);
+  if (!sink.apply(trades))
+    std::cerr << "failed to serialize trades\n";
+  return result;
+}
+
+byte_buffer make_text(size_t size) {
+  std::mt19937 rng{2};
+  const char *words[] = {"order", "filled", "cancel", "price", "venue",
+                         "account", "limit", "market", "the", "of"};
+  std::string text;
+  while (text.size() < size) {
+    text += words[rng() % 10];
+    text += ' ';
+  }
+  auto bytes = as_bytes(make_span(text));
+  return byte_buffer(bytes.begin(), bytes.begin() + size);
+}
+
+byte_buffer make_random(size_t size) {
+  std::mt19937 rng{3};
+  byte_buffer result(size);
+  for (auto &b : result)
+    b = static_cast<std::byte>(rng());
+  return result;
+}
+
+template <class F> double seconds(size_t rounds, F f) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < rounds; ++i)
+    f();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() -
+                                          start;
+  return elapsed.count();
+}
+
+void run(const char *name, const byte_buffer &input) {
+  constexpr size_t rounds = 200;
+  byte_buffer compressed;
+  auto comp_time = seconds(rounds, [&] {
+    compressed.clear();
+    lz_compress(make_span(input), compressed);
+  });
+  byte_buffer output(input.size());
+  auto decomp_time = seconds(rounds, [&] {
+    if (!lz_decompress(make_span(compressed), make_span(output)))
+      std::cerr << "failed to decompress " << name << "\n";
+  });
+  auto gb = static_cast<double>(input.size() * rounds) / 1e9;
+  std::cout << std::left << std::setw(8) << name << std::right
+            << std::setw(10) << input.size() << " bytes, ratio "
+            << std::fixed << std::setprecision(2)
+            << static_cast<double>(input.size()) /
+                   static_cast<double>(compressed.size())
+            << ", compress " << gb / comp_time << " GB/s, decompress "
+            << gb / decomp_time << " GB/s\n";
+}
+
+int main() {
+  run("trades", make_trades(20000));
+  run("text", make_text(512 * 1024));
+  run("random", make_random(512 * 1024));
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/binary_serializer.hpp"
+#include "../src/lz_block.hpp"
+
+class Event {
+public:
+  std::string kind;
+  std::string account;
+  std::string instrument;
+  std::string status;
+  int64_t order_id;
+  int64_t price;
+  int32_t quantity;
+  std::vector<std::string> tags;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Event &x) {
+  return f.object(x).fields(
+      f.field("kind", x.kind), f.field("account", x.account),
+      f.field("instrument", x.instrument), f.field("status", x.status),
+      f.field("order_id", x.order_id), f.field("price", x.price),
+      f.field("quantity", x.quantity), f.field("tags", x.tags));
+}
+
+std::vector<byte_buffer> make_messages(size_t num, unsigned seed) {
+  const char *kinds[] = {"ORDER_NEW", "ORDER_CANCEL", "ORDER_REPLACE",
+                         "EXECUTION_REPORT"};
+  const char *statuses[] = {"STATUS_ACCEPTED", "STATUS_REJECTED",
+                            "STATUS_PARTIALLY_FILLED", "STATUS_FILLED"};
+  std::mt19937 rng{seed};
+  std::vector<byte_buffer> result;
+  for (size_t i = 0; i < num; ++i) {
+    Event ev;
+    ev.kind = kinds[rng() % 4];
+    ev.account = "acct-eu-west-" + std::to_string(rng() % 1000);
+    ev.instrument = "instrument:equity:XNAS:" + std::to_string(rng() % 5000);
+    ev.status = statuses[rng() % 4];
+    ev.order_id = 7000000000 + static_cast<int64_t>(rng() % 100000);
+    ev.price = 100000 + rng() % 1000;
+    ev.quantity = static_cast<int32_t>(rng() % 500);
+    ev.tags = {"desk:delta-one", "strategy:vwap"};
+    byte_buffer buf;
+    binary_serializer sink(buf);
+    if (!sink.apply(ev))
+      std::cerr << "failed to serialize event\n";
+    result.emplace_back(std::move(buf));
+  }
+  return result;
+}
+
+int main() {
+  auto training = make_messages(2000, 1);
+  auto messages = make_messages(10000, 2);
+  std::vector<span<const std::byte>> samples;
+  for (auto &msg : training)
+    samples.emplace_back(make_span(msg));
+  for (size_t capacity : {1024, 4096, 16384}) {
+    auto dict = lz_dictionary::train(make_span(samples), capacity);
+    size_t raw = 0;
+    size_t plain = 0;
+    size_t with_dict = 0;
+    for (auto &msg : messages) {
+      byte_buffer out;
+      raw += msg.size();
+      plain += lz_compress(make_span(msg), out);
+      with_dict += lz_compress(make_span(msg), out, dict);
+    }
+    auto per_msg = [&](size_t total) {
+      return static_cast<double>(total) /
+             static_cast<double>(messages.size());
+    };
+    std::cout << "dictionary " << std::setw(5) << dict.content().size()
+              << " bytes: raw " << std::fixed << std::setprecision(1)
+              << per_msg(raw) << ", lz " << per_msg(plain)
+              << ", lz+dictionary " << per_msg(with_dict)
+              << " bytes per message\n";
+  }
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "../src/binary_deserializer.hpp"
+#include "../src/binary_serializer.hpp"
+
+class Tick {
+public:
+  int64_t timestamp;
+  int32_t instrument;
+  int32_t venue;
+  int64_t bid;
+  int64_t ask;
+  int32_t bid_size;
+  int32_t ask_size;
+  bool is_trade;
+  uint8_t flags;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Tick &x) {
+  return f.object(x).fields(
+      f.field("timestamp", x.timestamp), f.field("instrument", x.instrument),
+      f.field("venue", x.venue), f.field("bid", x.bid), f.field("ask", x.ask),
+      f.field("bid_size", x.bid_size), f.field("ask_size", x.ask_size),
+      f.field("is_trade", x.is_trade), f.field("flags", x.flags));
+}
+
+constexpr size_t fields_per_tick = 9;
+
+template <class F> double seconds(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() -
+                                          start;
+  return elapsed.count();
+}
+
+int main() {
+  constexpr size_t num_ticks = 100000;
+  constexpr size_t rounds = 50;
+  std::vector<Tick> ticks(num_ticks);
+  for (size_t i = 0; i < num_ticks; ++i) {
+    auto n = static_cast<int64_t>(i);
+    ticks[i] = Tick{1600000000000 + n, static_cast<int32_t>(i % 500), 3,
+                    10000 + n % 7, 10001 + n % 5, 100, 200, i % 3 == 0,
+                    static_cast<uint8_t>(i)};
+  }
+  byte_buffer buf;
+  buf.reserve(num_ticks * 40);
+  auto save_time = seconds([&] {
+    for (size_t round = 0; round < rounds; ++round) {
+      buf.clear();
+      binary_serializer sink(buf);
+      for (auto &tick : ticks)
+        if (!sink.apply(tick))
+          std::cerr << "failed to serialize\n";
+    }
+  });
+  Tick tmp;
+  int64_t checksum = 0;
+  auto load_time = seconds([&] {
+    for (size_t round = 0; round < rounds; ++round) {
+      binary_deserializer source{buf};
+      for (size_t i = 0; i < num_ticks; ++i) {
+        if (!source.apply(tmp))
+          std::cerr << "failed to deserialize\n";
+        checksum += tmp.bid;
+      }
+    }
+  });
+  auto fields = static_cast<double>(num_ticks * rounds * fields_per_tick);
+  std::cout << std::fixed << std::setprecision(2) << "save: "
+            << save_time * 1e9 / fields << " ns/field, load: "
+            << load_time * 1e9 / fields << " ns/field (" << buf.size()
+            << " bytes per round, checksum " << checksum << ")\n";
+  return 0;
+}
@@ -1,34 +1,15 @@
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <iomanip>
+#include <limits>
 #include <sstream>
 #include <type_traits>
 
 #include "binary_deserializer.hpp"
-#include "ieee_754.hpp"
 #include "my_error.hpp"
 #include "network_order.hpp"
 
-template <class T> bool int_value(binary_deserializer &source, T &x) {
-  auto tmp = std::make_unsigned_t<T>{};
-  if (source.value(as_writable_bytes(make_span(&tmp, 1)))) {
-    x = static_cast<T>(from_network_order(tmp));
-    return true;
-  } else {
-    return false;
-  }
-}
-
-template <class T> bool float_value(binary_deserializer &source, T &x) {
-  auto tmp = typename ieee_754_trait<T>::packed_type{};
-  if (int_value(source, tmp)) {
-    x = unpack754(tmp);
-    return true;
-  } else {
-    return false;
-  }
-}
-
 // Does not perform any range checks.
 template <class T> void unsafe_int_value(binary_deserializer &source, T &x) {
   std::make_unsigned_t<T> tmp;
@@ -37,48 +18,212 @@ template <class T> void unsafe_int_value(binary_deserializer &source, T &x) {
   x = static_cast<T>(from_network_order(tmp));
 }
 
+bool binary_deserializer::end_of_stream() noexcept {
+  truncated_ = true;
+  emplace_error(error_code::end_of_stream);
+  return false;
+}
+
+bool binary_deserializer::invalid_bool() noexcept {
+  emplace_error(error_code::invalid_argument, "bool value other than 0 or 1");
+  return false;
+}
+
+bool binary_deserializer::invalid_size() noexcept {
+  emplace_error(error_code::invalid_argument, "size exceeds 32 bits");
+  return false;
+}
+
+bool binary_deserializer::verify_bools(size_t num_bytes) noexcept {
+  if (!range_check(num_bytes))
+    return end_of_stream();
+  for (size_t i = 0; i < num_bytes; ++i)
+    if (static_cast<uint8_t>(current_[i]) > 1)
+      return invalid_bool();
+  return skip_bytes(num_bytes);
+}
+
 bool binary_deserializer::fetch_next_object_type(type_id_t &type) noexcept {
   type = invalid_type_id;
-  emplace_error(error_code::unsupported_operation,
-                "the default binary format does not embed type information");
-  return false;
+  if (!typed_stream_) {
+    emplace_error(error_code::unsupported_operation,
+                  "the default binary format does not embed type information");
+    return false;
+  }
+  if (!range_check(sizeof(type_id_t)))
+    return end_of_stream();
+  auto tmp = type_id_t{0};
+  memcpy(&tmp, current_, sizeof(tmp));
+  type = from_network_order(tmp);
+  return true;
 }
 
-bool binary_deserializer::begin_sequence(size_t &list_size) noexcept {
-  // Use varbyte encoding to compress sequence size on the wire.
-  uint32_t x = 0;
-  int n = 0;
-  uint8_t low7 = 0;
-  do {
-    if (!value(low7))
-      return false;
-    x |= static_cast<uint32_t>((low7 & 0x7F)) << (7 * n);
-    ++n;
-  } while (low7 & 0x80);
-  list_size = x;
+bool binary_deserializer::read_object_header(type_id_t &type,
+                                             uint32_t &size) noexcept {
+  if (!value(type) || !value(size))
+    return false;
+  if (!range_check(size))
+    return end_of_stream();
   return true;
 }
 
+bool binary_deserializer::skip_object() noexcept {
+  if (!typed_stream_) {
+    emplace_error(error_code::unsupported_operation,
+                  "the default binary format does not embed type information");
+    return false;
+  }
+  auto type = type_id_t{0};
+  auto size = uint32_t{0};
+  if (!read_object_header(type, size))
+    return false;
+  current_ += size;
+  if (checksum_due())
+    update_checksum();
+  return true;
+}
+
+bool binary_deserializer::begin_typed_object(type_id_t type) noexcept {
+  auto received = type_id_t{0};
+  auto size = uint32_t{0};
+  if (!read_object_header(received, size))
+    return false;
+  if (received != type) {
+    emplace_error(error_code::invalid_field_type,
+                  "received an object of another type");
+    return false;
+  }
+  object_end_ = current_ + size;
+  return true;
+}
+
+bool binary_deserializer::end_typed_object() noexcept {
+  if (current_ != object_end_) {
+    emplace_error(error_code::invalid_argument,
+                  "object size does not match its encoding");
+    return false;
+  }
+  return true;
+}
+
+bool binary_deserializer::begin_nested_object() noexcept {
+  auto size = uint32_t{0};
+  if (!value(size))
+    return false;
+  if (!range_check(size))
+    return end_of_stream();
+  nested_.push_back(current_ + size);
+  return true;
+}
+
+bool binary_deserializer::end_nested_object() noexcept {
+  auto end = nested_.back();
+  nested_.pop_back();
+  if (current_ != end) {
+    emplace_error(error_code::invalid_argument,
+                  "object size does not match its encoding");
+    return false;
+  }
+  return true;
+}
+
+bool binary_deserializer::skip_map_index(size_t size,
+                                         uint32_t &entries_size) noexcept {
+  if (!value(entries_size))
+    return false;
+  if (size > remaining() / sizeof(uint32_t))
+    return end_of_stream();
+  if (!skip_bytes(size * sizeof(uint32_t)))
+    return false;
+  if (entries_size > remaining())
+    return end_of_stream();
+  return true;
+}
+
+bool binary_deserializer::skip_indexed_map() noexcept {
+  size_t size = 0;
+  auto entries_size = uint32_t{0};
+  return begin_sequence(size) && skip_map_index(size, entries_size) &&
+         skip_bytes(entries_size);
+}
+
 void binary_deserializer::skip(size_t num_bytes) {
   if (num_bytes > remaining())
     assert(false);
   current_ += num_bytes;
 }
 
-void binary_deserializer::reset(span<const std::byte> bytes) noexcept {
+void binary_deserializer::reset(span<const std::byte> bytes,
+                                size_t depth) noexcept {
   current_ = bytes.data();
   end_ = current_ + bytes.size();
+  checksum_pos_ = nullptr;
+  checksum_limit_ = nullptr;
+  depth_ = depth;
+  object_end_ = nullptr;
+  presence_.clear();
+  nested_.clear();
+  shared_.clear();
+  truncated_ = false;
 }
 
-bool binary_deserializer::begin_field(std::string_view,
-                                      bool &is_present) noexcept {
-  auto tmp = uint8_t{0};
-  if (!value(tmp))
+void binary_deserializer::abort_objects() noexcept {
+  depth_ = 0;
+  object_end_ = nullptr;
+  presence_.clear();
+  nested_.clear();
+  shared_.clear();
+}
+
+void binary_deserializer::add_shared_object(size_t pos, const void *type,
+                                            std::shared_ptr<void> ptr) {
+  shared_[pos] = shared_entry{type, std::move(ptr)};
+}
+
+std::shared_ptr<void>
+binary_deserializer::shared_object(size_t pos, size_t distance,
+                                   const void *type) const {
+  if (distance > std::numeric_limits<size_t>::max() - pos)
+    return nullptr;
+  auto i = shared_.find(pos + distance);
+  if (i == shared_.end() || i->second.type != type)
+    return nullptr;
+  return i->second.ptr;
+}
+
+// number of bytes to collect before updating the checksum
+constexpr size_t checksum_block_size = 4096;
+
+void binary_deserializer::begin_checksum() noexcept {
+  checksum_.reset();
+  checksum_pos_ = current_;
+  checksum_limit_ = current_ + std::min(checksum_block_size, remaining());
+}
+
+bool binary_deserializer::verify_checksum() noexcept {
+  if (checksum_limit_ == nullptr) {
+    emplace_error(error_code::runtime_error, "no checksum in progress");
     return false;
-  is_present = static_cast<bool>(tmp);
+  }
+  update_checksum();
+  checksum_limit_ = nullptr;
+  auto expected = checksum_.value();
+  auto received = uint32_t{0};
+  if (!value(received))
+    return false;
+  if (received != expected) {
+    emplace_error(error_code::checksum_mismatch);
+    return false;
+  }
   return true;
 }
 
+void binary_deserializer::update_checksum() noexcept {
+  checksum_.update(make_span(checksum_pos_, current_));
+  checksum_pos_ = current_;
+  checksum_limit_ = current_ + std::min(checksum_block_size, remaining());
+}
+
 template <class T>
 constexpr size_t max_value = static_cast<size_t>(std::numeric_limits<T>::max());
 
@@ -137,73 +282,6 @@ bool binary_deserializer::begin_field(std::string_view, bool &is_present,
   }
 }
 
-bool binary_deserializer::value(bool &x) noexcept {
-  int8_t tmp = 0;
-  if (!value(tmp))
-    return false;
-  x = tmp != 0;
-  return true;
-}
-
-bool binary_deserializer::value(std::byte &x) noexcept {
-  if (range_check(1)) {
-    x = *current_++;
-    return true;
-  }
-  emplace_error(error_code::end_of_stream);
-  return false;
-}
-
-bool binary_deserializer::value(int8_t &x) noexcept {
-  if (range_check(1)) {
-    x = static_cast<int8_t>(*current_++);
-    return true;
-  }
-  emplace_error(error_code::end_of_stream);
-  return false;
-}
-
-bool binary_deserializer::value(uint8_t &x) noexcept {
-  if (range_check(1)) {
-    x = static_cast<uint8_t>(*current_++);
-    return true;
-  }
-  emplace_error(error_code::end_of_stream);
-  return false;
-}
-
-bool binary_deserializer::value(int16_t &x) noexcept {
-  return int_value(*this, x);
-}
-
-bool binary_deserializer::value(uint16_t &x) noexcept {
-  return int_value(*this, x);
-}
-
-bool binary_deserializer::value(int32_t &x) noexcept {
-  return int_value(*this, x);
-}
-
-bool binary_deserializer::value(uint32_t &x) noexcept {
-  return int_value(*this, x);
-}
-
-bool binary_deserializer::value(int64_t &x) noexcept {
-  return int_value(*this, x);
-}
-
-bool binary_deserializer::value(uint64_t &x) noexcept {
-  return int_value(*this, x);
-}
-
-bool binary_deserializer::value(float &x) noexcept {
-  return float_value(*this, x);
-}
-
-bool binary_deserializer::value(double &x) noexcept {
-  return float_value(*this, x);
-}
-
 bool binary_deserializer::value(long double &x) {
   std::string tmp;
   if (!value(tmp))
@@ -215,27 +293,17 @@ bool binary_deserializer::value(long double &x) {
   return false;
 }
 
-bool binary_deserializer::value(span<std::byte> x) noexcept {
-  if (!range_check(x.size())) {
-    emplace_error(error_code::end_of_stream);
-    return false;
-  }
-  memcpy(x.data(), current_, x.size());
-  current_ += x.size();
-  return true;
-}
-
 bool binary_deserializer::value(std::string &x) {
   x.clear();
   size_t str_size = 0;
   if (!begin_sequence(str_size))
     return false;
-  if (!range_check(str_size)) {
-    emplace_error(error_code::end_of_stream);
-    return false;
-  }
+  if (!range_check(str_size))
+    return end_of_stream();
   x.assign(reinterpret_cast<const char *>(current_), str_size);
   current_ += str_size;
+  if (checksum_due())
+    update_checksum();
   return end_sequence();
 }
 
@@ -244,10 +312,8 @@ bool binary_deserializer::value(std::u16string &x) {
   size_t str_size = 0;
   if (!begin_sequence(str_size))
     return false;
-  if (!range_check(str_size * sizeof(uint16_t))) {
-    emplace_error(error_code::end_of_stream);
-    return false;
-  }
+  if (!range_check(str_size * sizeof(uint16_t)))
+    return end_of_stream();
   for (size_t i = 0; i < str_size; ++i) {
     // The standard does not guarantee that char16_t is exactly 16 bits.
     uint16_t tmp;
@@ -262,10 +328,8 @@ bool binary_deserializer::value(std::u32string &x) {
   size_t str_size = 0;
   if (!begin_sequence(str_size))
     return false;
-  if (!range_check(str_size * sizeof(uint32_t))) {
-    emplace_error(error_code::end_of_stream);
-    return false;
-  }
+  if (!range_check(str_size * sizeof(uint32_t)))
+    return end_of_stream();
   for (size_t i = 0; i < str_size; ++i) {
     // The standard does not guarantee that char32_t is exactly 32 bits.
     uint32_t tmp;
@@ -1,29 +1,50 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <tuple>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include "crc32c.hpp"
+#include "ieee_754.hpp"
 #include "load_inspector_base.hpp"
 #include "my_error.hpp"
+#include "network_order.hpp"
 #include "span.hpp"
 #include "squashed_int.hpp"
 #include "type_def.h"
 #include "type_id.hpp"
 
-
-class binary_deserializer : public load_inspector_base<binary_deserializer> {
+class binary_deserializer final
+    : public load_inspector_base<binary_deserializer> {
 public:
-  binary_deserializer() : current_(nullptr), end_(nullptr) {}
+  binary_deserializer()
+      : current_(nullptr), end_(nullptr), checksum_pos_(nullptr),
+        checksum_limit_(nullptr), typed_stream_(false), depth_(0),
+        object_end_(nullptr), presence_bitmaps_(false),
+        nested_object_lengths_(false), indexed_maps_(false),
+        columnar_lists_(false),
+        field_mask_(all_fields), verifying_(false), truncated_(false) {}
   virtual ~binary_deserializer() {}
 
   using super = load_inspector_base<binary_deserializer>;
 
+  /// Field mask that selects all fields.
+  static constexpr uint64_t all_fields = ~uint64_t{0};
+
   template <class Container>
-  binary_deserializer(const Container &input) noexcept {
+  binary_deserializer(const Container &input) noexcept
+      : typed_stream_(false), presence_bitmaps_(false),
+        nested_object_lengths_(false), indexed_maps_(false),
+        columnar_lists_(false),
+        field_mask_(all_fields), verifying_(false), truncated_(false) {
     reset(as_bytes(make_span(input)));
   }
 
@@ -35,31 +56,290 @@ public:
     return static_cast<size_t>(end_ - current_);
   }
 
+  /// Returns whether a read since the last `reset` failed because the input
+  /// ended, i.e., whether more input may allow the read to succeed.
+  bool truncated() const noexcept { return truncated_; }
+
   span<const std::byte> remainder() const noexcept {
     return make_span(current_, end_);
   }
 
   void skip(size_t num_bytes);
 
-  void reset(span<const std::byte> bytes) noexcept;
+  /// Restarts reading from `bytes` at nesting level `depth`, e.g., to read a
+  /// value that was saved inside of `depth` objects.
+  void reset(span<const std::byte> bytes, size_t depth = 0) noexcept;
+
+  /// Returns the nesting level of objects at the read position.
+  size_t depth() const noexcept { return depth_; }
+
+  /// Returns to the top level and drops all open bitmaps, lengths and shared
+  /// objects, e.g., after stopping to read in the middle of an object. Keeps
+  /// the read position.
+  void abort_objects() noexcept;
+
+  /// Starts computing a CRC32C over all bytes read after this call. The
+  /// checksum gets updated block-wise while reading.
+  void begin_checksum() noexcept;
+
+  /// Reads the 4-byte trailer written by `binary_serializer::end_checksum`
+  /// and compares it to the CRC32C of all bytes read since `begin_checksum`.
+  bool verify_checksum() noexcept;
 
   const std::byte *current() const noexcept { return current_; }
 
+  /// Registers the shared object `ptr` of type `type` for the pointer at the
+  /// read position with `pos` remaining bytes.
+  void add_shared_object(size_t pos, const void *type,
+                         std::shared_ptr<void> ptr);
+
+  /// Returns the shared object of the pointer `distance` bytes before the
+  /// read position with `pos` remaining bytes or null if there is no such
+  /// pointer or if its object has a type other than `type`. Finds pointers in
+  /// the current top-level object and, outside of objects, since the last
+  /// call to `reset` or `clear_shared_objects`.
+  std::shared_ptr<void> shared_object(size_t pos, size_t distance,
+                                      const void *type) const;
+
+  /// Releases all shared objects.
+  void clear_shared_objects() noexcept { shared_.clear(); }
+
   const std::byte *end() const noexcept { return end_; }
 
   static constexpr bool has_human_readable_format() noexcept { return false; }
 
-  bool fetch_next_object_type(type_id_t &type) noexcept;
+  using super::apply;
+
+  /// Loads `x`. If loading a top-level value fails, resets the nesting level
+  /// and drops all open bitmaps, lengths and shared objects, so that reading
+  /// the next value starts at the top level again.
+  template <class T> [[nodiscard]] bool apply(T &x) {
+    if (depth_ > 0)
+      return super::apply(x);
+    if (super::apply(x))
+      return true;
+    abort_objects();
+    return false;
+  }
+
+  /// Enables or disables reading the typed stream mode of
+  /// `binary_serializer`.
+  void set_typed_stream(bool enabled) noexcept { typed_stream_ = enabled; }
+
+  bool typed_stream() const noexcept { return typed_stream_; }
+
+  /// Enables or disables reading the presence bitmaps of `binary_serializer`.
+  void set_presence_bitmaps(bool enabled) noexcept {
+    presence_bitmaps_ = enabled;
+  }
+
+  bool presence_bitmaps() const noexcept { return presence_bitmaps_; }
+
+  bool begin_presence_bitmap(size_t num_flags) {
+    if (!presence_bitmaps_)
+      return true;
+    auto num_bytes = (num_flags + 7) / 8;
+    if (!range_check(num_bytes))
+      return end_of_stream();
+    presence_.push_back(presence_frame{current_, num_flags, 0});
+    current_ += num_bytes;
+    if (checksum_due())
+      update_checksum();
+    return true;
+  }
 
-  constexpr bool begin_object(type_id_t, std::string_view) noexcept {
+  bool end_presence_bitmap() noexcept {
+    if (presence_bitmaps_)
+      presence_.pop_back();
     return true;
   }
 
-  constexpr bool end_object() noexcept { return true; }
+  /// Returns the type of the next top-level object without consuming any
+  /// input. Requires the typed stream mode.
+  bool fetch_next_object_type(type_id_t &type) noexcept;
+
+  /// Skips the next top-level object. Requires the typed stream mode.
+  bool skip_object() noexcept;
+
+  /// Enables or disables reading the nested object lengths of
+  /// `binary_serializer`. Allows skipping nested objects in a single step.
+  void set_nested_object_lengths(bool enabled) noexcept {
+    nested_object_lengths_ = enabled;
+  }
+
+  bool nested_object_lengths() const noexcept { return nested_object_lengths_; }
+
+  /// Enables or disables reading the indexed maps of `binary_serializer`.
+  /// Allows skipping maps in a single step.
+  void set_indexed_maps(bool enabled) noexcept { indexed_maps_ = enabled; }
+
+  bool indexed_maps() const noexcept { return indexed_maps_; }
+
+  /// Enables or disables reading the columnar lists of `binary_serializer`.
+  void set_columnar_lists(bool enabled) noexcept { columnar_lists_ = enabled; }
+
+  bool columnar_lists() const noexcept { return columnar_lists_; }
+
+  /// Selects the fields of top-level objects to load: bit `i` of `mask`
+  /// selects the field at index `i`. Fields after index 63 are always loaded.
+  /// Unselected fields get skipped without allocating memory and keep their
+  /// value. Skipping a field that contains objects requires the nested object
+  /// lengths mode to avoid loading the objects into temporaries.
+  void set_field_mask(uint64_t mask) noexcept { field_mask_ = mask; }
+
+  uint64_t field_mask() const noexcept { return field_mask_; }
+
+  /// Returns the mask for the fields of the current object.
+  uint64_t selected_fields() const noexcept {
+    return depth_ == 1 || verifying_ ? field_mask_ : all_fields;
+  }
+
+  /// Checks that the input starts with a valid encoding of a `T` without
+  /// constructing or allocating values: all sizes must fit into the input and
+  /// all bools, presence flags and variant indexes must be valid. Advances
+  /// the read position past the encoding on success. Walks the `inspect`
+  /// overloads on a shared prototype of each object type, so these overloads
+  /// must describe objects. Types with an `inspector_access` specialization
+  /// need a `skip` hook to avoid loading them into temporaries. Back-references
+  /// of shared pointers pass unchecked.
+  template <class T> bool verify() {
+    auto field_mask = field_mask_;
+    field_mask_ = 0;
+    verifying_ = true;
+    auto result = skip_value<T>();
+    field_mask_ = field_mask;
+    verifying_ = false;
+    return result;
+  }
+
+  /// Skips the encoding of a `T` without storing it. Advances the read
+  /// position by the size of fixed-size values, strings and sequences of
+  /// fixed-size values and, in the nested object lengths mode, objects.
+  template <class T> bool skip_value() {
+    using access_type = decltype(inspect_access_type<binary_deserializer, T>());
+    if constexpr (std::is_same<T, bool>::value) {
+      return verifying_ ? verify_bools(1) : skip_bytes(1);
+    } else if constexpr (encoded_size_v<T> > 0) {
+      return skip_bytes(encoded_size_v<T>);
+    } else if constexpr (std::is_same<T, std::string>::value ||
+                         std::is_same<T, long double>::value) {
+      return skip_sequence(1);
+    } else if constexpr (std::is_same<T, std::u16string>::value) {
+      return skip_sequence(sizeof(uint16_t));
+    } else if constexpr (std::is_same<T, std::u32string>::value) {
+      return skip_sequence(sizeof(uint32_t));
+    } else if constexpr (std::is_same<access_type,
+                                      inspector_access_type::inspect>::value ||
+                         std::is_same<access_type,
+                                      inspector_access_type::empty>::value) {
+      if (verifying_)
+        return apply(inspect_prototype<T>());
+      if (!nested_object_lengths_ || depth_ == 0) {
+        auto tmp = T{};
+        return apply(tmp);
+      }
+      auto size = uint32_t{0};
+      return value(size) && skip_bytes(size);
+    } else if constexpr (std::is_array<T>::value) {
+      using value_type = std::remove_extent_t<T>;
+      for (size_t i = 0; i < std::extent<T>::value; ++i)
+        if (!skip_value<value_type>())
+          return false;
+      return true;
+    } else if constexpr (std::is_same<access_type,
+                                      inspector_access_type::tuple>::value) {
+      using indexes = std::make_index_sequence<std::tuple_size<T>::value>;
+      return skip_tuple<T>(indexes{});
+    } else if constexpr (std::is_same<access_type,
+                                      inspector_access_type::map>::value) {
+      using key_type = typename T::key_type;
+      using mapped_type = typename T::mapped_type;
+      if (indexed_maps_ && !verifying_)
+        return skip_indexed_map();
+      size_t size = 0;
+      if (!begin_associative_array(size))
+        return false;
+      for (size_t i = 0; i < size; ++i)
+        if (!skip_value<key_type>() || !skip_value<mapped_type>())
+          return false;
+      return true;
+    } else if constexpr (std::is_same<access_type,
+                                      inspector_access_type::list>::value) {
+      using value_type = typename T::value_type;
+      if constexpr (is_columnar_list<binary_deserializer, T>()) {
+        if (columnar_lists_)
+          return skip_columnar_list<value_type>(*this);
+      }
+      if constexpr (std::is_same<value_type, bool>::value) {
+        size_t size = 0;
+        return begin_sequence(size) &&
+               (verifying_ ? verify_bools(size) : skip_bytes(size));
+      } else if constexpr (encoded_size_v<value_type> > 0) {
+        return skip_sequence(encoded_size_v<value_type>);
+      } else {
+        size_t size = 0;
+        if (!begin_sequence(size))
+          return false;
+        // Rejects sizes that cannot fit into the input before looping.
+        if (verifying_ && !std::is_empty<value_type>::value &&
+            size > remaining())
+          return end_of_stream();
+        for (size_t i = 0; i < size; ++i)
+          if (!skip_value<value_type>())
+            return false;
+        return true;
+      }
+    } else if constexpr (is_complete<optional_inspector_traits<T>> ||
+                         is_complete<variant_inspector_traits<T>>) {
+      // Optional and variant values are objects with a single field.
+      if (verifying_)
+        return apply(inspect_prototype<T>());
+      auto tmp = T{};
+      return apply(tmp);
+    } else {
+      // Types with an `inspector_access` specialization may use any encoding.
+      if constexpr (has_access_skip<binary_deserializer, T>::value) {
+        if (verifying_)
+          return inspector_access<T>::skip(*this);
+      }
+      auto tmp = T{};
+      return apply(tmp);
+    }
+  }
+
+  bool begin_object(type_id_t type, std::string_view) noexcept {
+    if (depth_++ == 0)
+      return !typed_stream_ || begin_typed_object(type);
+    return !nested_object_lengths_ || begin_nested_object();
+  }
+
+  bool end_object() noexcept {
+    if (--depth_ == 0) {
+      if (!shared_.empty())
+        clear_shared_objects();
+      return !typed_stream_ || end_typed_object();
+    }
+    return !nested_object_lengths_ || end_nested_object();
+  }
 
   constexpr bool begin_field(std::string_view) noexcept { return true; }
 
-  bool begin_field(std::string_view name, bool &is_present) noexcept;
+  bool begin_field(std::string_view, bool &is_present) noexcept {
+    if (!presence_.empty() && presence_.back().next < presence_.back().size) {
+      auto &frame = presence_.back();
+      auto bit = std::byte{0x80} >> (frame.next % 8);
+      is_present = (frame.pos[frame.next / 8] & bit) != std::byte{0};
+      ++frame.next;
+      return true;
+    }
+    auto tmp = uint8_t{0};
+    if (!value(tmp))
+      return false;
+    if (tmp > 1 && verifying_)
+      return invalid_bool();
+    is_present = static_cast<bool>(tmp);
+    return true;
+  }
 
   bool begin_field(std::string_view name, span<const type_id_t> types,
                    size_t &index) noexcept;
@@ -77,35 +357,77 @@ public:
 
   constexpr bool end_key_value_pair() noexcept { return true; }
 
-  bool begin_sequence(size_t &list_size) noexcept;
+  bool begin_sequence(size_t &list_size) noexcept {
+    // Use varbyte encoding to compress sequence size on the wire.
+    uint32_t x = 0;
+    uint8_t low7 = 0;
+    for (int n = 0;; ++n) {
+      if (!value(low7))
+        return false;
+      // The fifth byte holds the highest 4 bits of a 32-bit size.
+      if (n == 4 && (low7 & 0xF0) != 0)
+        return invalid_size();
+      x |= static_cast<uint32_t>((low7 & 0x7F)) << (7 * n);
+      if ((low7 & 0x80) == 0)
+        break;
+    }
+    list_size = x;
+    return true;
+  }
 
   constexpr bool end_sequence() noexcept { return true; }
 
   bool begin_associative_array(size_t &size) noexcept {
-    return begin_sequence(size);
+    if (!begin_sequence(size))
+      return false;
+    auto entries_size = uint32_t{0};
+    return !indexed_maps_ || skip_map_index(size, entries_size);
   }
 
   bool end_associative_array() noexcept { return end_sequence(); }
 
-  bool value(bool &x) noexcept;
+  // The primitive decoders are defined inline to allow the compiler to merge
+  // the range checks of a fully inlined `inspect` overload.
+  bool value(bool &x) noexcept {
+    int8_t tmp = 0;
+    if (!value(tmp))
+      return false;
+    x = tmp != 0;
+    return true;
+  }
 
-  bool value(std::byte &x) noexcept;
+  bool value(std::byte &x) noexcept {
+    if (!range_check(1))
+      return end_of_stream();
+    x = *current_++;
+    return true;
+  }
 
-  bool value(uint8_t &x) noexcept;
+  bool value(uint8_t &x) noexcept {
+    if (!range_check(1))
+      return end_of_stream();
+    x = static_cast<uint8_t>(*current_++);
+    return true;
+  }
 
-  bool value(int8_t &x) noexcept;
+  bool value(int8_t &x) noexcept {
+    if (!range_check(1))
+      return end_of_stream();
+    x = static_cast<int8_t>(*current_++);
+    return true;
+  }
 
-  bool value(int16_t &x) noexcept;
+  bool value(int16_t &x) noexcept { return int_value(x); }
 
-  bool value(uint16_t &x) noexcept;
+  bool value(uint16_t &x) noexcept { return int_value(x); }
 
-  bool value(int32_t &x) noexcept;
+  bool value(int32_t &x) noexcept { return int_value(x); }
 
-  bool value(uint32_t &x) noexcept;
+  bool value(uint32_t &x) noexcept { return int_value(x); }
 
-  bool value(int64_t &x) noexcept;
+  bool value(int64_t &x) noexcept { return int_value(x); }
 
-  bool value(uint64_t &x) noexcept;
+  bool value(uint64_t &x) noexcept { return int_value(x); }
 
   template <class T>
   std::enable_if_t<std::is_integral<T>::value, bool> value(T &x) noexcept {
@@ -118,9 +440,9 @@ public:
     }
   }
 
-  bool value(float &x) noexcept;
+  bool value(float &x) noexcept { return float_value(x); }
 
-  bool value(double &x) noexcept;
+  bool value(double &x) noexcept { return float_value(x); }
 
   bool value(long double &x);
 
@@ -130,14 +452,136 @@ public:
 
   bool value(std::u32string &x);
 
-  bool value(span<std::byte> x) noexcept;
+  bool value(span<std::byte> x) noexcept {
+    if (!range_check(x.size()))
+      return end_of_stream();
+    memcpy(x.data(), current_, x.size());
+    current_ += x.size();
+    if (checksum_due())
+      update_checksum();
+    return true;
+  }
 
   bool value(std::vector<bool> &x);
 
+  /// Reads `n` numbers of type `T` and passes them to `set(i, x)` for `i` in
+  /// `[0, n)`, e.g., a column of a columnar list.
+  template <class T, class Set> bool values(size_t n, Set &&set) {
+    if constexpr (std::is_floating_point<T>::value) {
+      using wire_type = typename ieee_754_trait<T>::packed_type;
+      return wire_values<wire_type>(
+          n, [&set](size_t i, wire_type x) { set(i, unpack754(x)); });
+    } else {
+      using wire_type = squashed_int_t<std::make_unsigned_t<T>>;
+      return wire_values<wire_type>(
+          n, [&set](size_t i, wire_type x) { set(i, static_cast<T>(x)); });
+    }
+  }
+
+  /// Size of the encoding of `T` if all values of `T` have the same size,
+  /// zero otherwise.
+  template <class T>
+  static constexpr size_t encoded_size_v =
+      std::is_same<T, std::byte>::value
+          ? 1
+          : (std::is_arithmetic<T>::value &&
+                     !std::is_same<T, long double>::value
+                 ? sizeof(T)
+                 : 0);
+
 private:
+  bool skip_bytes(size_t num_bytes) noexcept {
+    if (!range_check(num_bytes))
+      return end_of_stream();
+    current_ += num_bytes;
+    if (checksum_due())
+      update_checksum();
+    return true;
+  }
+  /// Skips a sequence of `element_size` bytes per element.
+  bool skip_sequence(size_t element_size) noexcept {
+    size_t size = 0;
+    return begin_sequence(size) && skip_bytes(size * element_size);
+  }
+  /// Checks that the next `num_bytes` bytes are 0 or 1 and skips them.
+  bool verify_bools(size_t num_bytes) noexcept;
+  bool invalid_bool() noexcept;
+  /// Reports a size that does not fit into 32 bits.
+  bool invalid_size() noexcept;
+  template <class T, size_t... Is>
+  bool skip_tuple(std::index_sequence<Is...>) {
+    return (skip_value<std::tuple_element_t<Is, T>>() && ...);
+  }
+  struct presence_frame {
+    const std::byte *pos; // start of the bitmap
+    size_t size;          // number of flags in the bitmap
+    size_t next;          // index of the next flag
+  };
   bool range_check(size_t read_size) const noexcept {
     return current_ + read_size <= end_;
   }
+  template <class T> bool int_value(T &x) noexcept {
+    auto tmp = std::make_unsigned_t<T>{};
+    if (!value(as_writable_bytes(make_span(&tmp, 1))))
+      return false;
+    x = static_cast<T>(from_network_order(tmp));
+    return true;
+  }
+  template <class T, class Set> bool wire_values(size_t n, Set &&set) {
+    if (n > remaining() / sizeof(T))
+      return end_of_stream();
+    for (size_t i = 0; i < n; ++i) {
+      auto x = T{};
+      memcpy(&x, current_ + i * sizeof(T), sizeof(T));
+      set(i, from_network_order(x));
+    }
+    return skip_bytes(n * sizeof(T));
+  }
+  template <class T> bool float_value(T &x) noexcept {
+    auto tmp = typename ieee_754_trait<T>::packed_type{};
+    if (!int_value(tmp))
+      return false;
+    x = unpack754(tmp);
+    return true;
+  }
+  /// Reports a read past the end of the input.
+  bool end_of_stream() noexcept;
+  /// Reads the type and size of a top-level object.
+  bool read_object_header(type_id_t &type, uint32_t &size) noexcept;
+  bool begin_typed_object(type_id_t type) noexcept;
+  bool end_typed_object() noexcept;
+  bool begin_nested_object() noexcept;
+  bool end_nested_object() noexcept;
+  /// Reads the size of all entries of an indexed map with `size` entries and
+  /// skips the entry offsets.
+  bool skip_map_index(size_t size, uint32_t &entries_size) noexcept;
+  /// Skips an indexed map after reading its size.
+  bool skip_indexed_map() noexcept;
+  void update_checksum() noexcept;
+  bool checksum_due() const noexcept {
+    return checksum_limit_ != nullptr && current_ >= checksum_limit_;
+  }
   const std::byte *current_;
   const std::byte *end_;
+  crc32c checksum_;
+  const std::byte *checksum_pos_;   // bytes before this are in `checksum_`
+  const std::byte *checksum_limit_; // update `checksum_` when reaching this
+  bool typed_stream_;
+  size_t depth_; // nesting level of objects
+  const std::byte *object_end_; // end of the current top-level object
+  bool presence_bitmaps_;
+  std::vector<presence_frame> presence_; // bitmaps of the open objects
+  bool nested_object_lengths_;
+  std::vector<const std::byte *> nested_; // ends of the open nested objects
+  bool indexed_maps_;
+  bool columnar_lists_;
+  uint64_t field_mask_; // applies to all objects in `verify`
+  bool verifying_; // skips all fields and checks all values in `verify`
+  bool truncated_; // a read ran past the end of the input
+  struct shared_entry {
+    const void *type;
+    std::shared_ptr<void> ptr;
+  };
+  // shared objects by the remaining bytes at their first pointer
+  std::unordered_map<size_t, shared_entry> shared_;
 };
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "binary_deserializer.hpp"
+#include "delta_packed.hpp"
+#include "load_inspector_base.hpp"
+#include "span.hpp"
+#include "type_id.hpp"
+
+/// Default handler for `binary_event_reader` that ignores all events.
+/// Handlers may derive from this class and hide the events they care about.
+class event_handler {
+public:
+  void on_begin_object(type_id_t, std::string_view) {}
+  void on_end_object() {}
+  void on_field(std::string_view) {}
+  void on_absent_field(std::string_view) {}
+  void on_begin_tuple(size_t) {}
+  void on_end_tuple() {}
+  void on_begin_sequence(size_t) {}
+  void on_end_sequence() {}
+  void on_begin_map(size_t) {}
+  void on_end_map() {}
+  void on_bool(bool) {}
+  void on_int64(int64_t) {}
+  void on_uint64(uint64_t) {}
+  void on_double(double) {}
+  void on_string(std::string_view) {}
+  void on_u16string(const std::u16string &) {}
+  void on_u32string(const std::u32string &) {}
+};
+
+/// Walks the encoding of a `T` in the input of a `binary_deserializer` and
+/// reports it to `Handler` as a stream of events instead of loading it. Uses
+/// the same `inspect` overloads as loading, but skips all fields of a shared
+/// prototype, so it constructs no values. Strings are reported as views into
+/// the input. Signed integers get reported via `on_int64`, unsigned integers
+/// and bytes via `on_uint64` and floating point numbers via `on_double`.
+/// Delta-packed lists get decoded into a temporary list and reported as a
+/// sequence of their elements. Columnar lists get reported column by column,
+/// i.e., the sequence holds the fields of all objects grouped by field and
+/// no object events. Errors in the input get stored in the
+/// `binary_deserializer`.
+template <class Handler>
+class binary_event_reader final
+    : public load_inspector_base<binary_event_reader<Handler>> {
+public:
+  binary_event_reader(binary_deserializer &source, Handler &handler) noexcept
+      : source_(source), handler_(handler) {}
+
+  static constexpr bool has_human_readable_format() noexcept { return false; }
+
+  /// Reads the next `T` from the input and reports it to the handler.
+  template <class T> bool read() { return skip_value<T>(); }
+
+  // -- inspector interface ----------------------------------------------------
+
+  static constexpr uint64_t selected_fields() noexcept { return 0; }
+
+  bool fetch_next_object_type(type_id_t &type) noexcept {
+    return source_.fetch_next_object_type(type);
+  }
+
+  bool begin_object(type_id_t type, std::string_view name) {
+    handler_.on_begin_object(type, name);
+    return source_.begin_object(type, name);
+  }
+
+  bool end_object() {
+    handler_.on_end_object();
+    return source_.end_object();
+  }
+
+  bool begin_presence_bitmap(size_t num_flags) {
+    return source_.begin_presence_bitmap(num_flags);
+  }
+
+  bool end_presence_bitmap() { return source_.end_presence_bitmap(); }
+
+  bool begin_field(std::string_view name) {
+    handler_.on_field(name);
+    return true;
+  }
+
+  bool begin_field(std::string_view name, bool &is_present) {
+    if (!source_.begin_field(name, is_present))
+      return false;
+    report_field(name, is_present);
+    return true;
+  }
+
+  bool begin_field(std::string_view name, span<const type_id_t> types,
+                   size_t &index) {
+    if (!source_.begin_field(name, types, index))
+      return false;
+    handler_.on_field(name);
+    return true;
+  }
+
+  bool begin_field(std::string_view name, bool &is_present,
+                   span<const type_id_t> types, size_t &index) {
+    if (!source_.begin_field(name, is_present, types, index))
+      return false;
+    report_field(name, is_present);
+    return true;
+  }
+
+  constexpr bool end_field() noexcept { return true; }
+
+  bool begin_tuple(size_t size) {
+    handler_.on_begin_tuple(size);
+    return true;
+  }
+
+  bool end_tuple() {
+    handler_.on_end_tuple();
+    return true;
+  }
+
+  constexpr bool begin_key_value_pair() noexcept { return true; }
+
+  constexpr bool end_key_value_pair() noexcept { return true; }
+
+  bool begin_sequence(size_t &size) {
+    if (!source_.begin_sequence(size))
+      return false;
+    handler_.on_begin_sequence(size);
+    return true;
+  }
+
+  bool end_sequence() {
+    handler_.on_end_sequence();
+    return true;
+  }
+
+  bool begin_associative_array(size_t &size) {
+    if (!source_.begin_associative_array(size))
+      return false;
+    handler_.on_begin_map(size);
+    return true;
+  }
+
+  bool end_associative_array() {
+    handler_.on_end_map();
+    return true;
+  }
+
+  // The value functions report values without storing them. Types with an
+  // `inspector_access` specialization load into temporaries through these.
+
+  template <class T>
+  std::enable_if_t<std::is_integral<T>::value, bool> value(T &) {
+    auto tmp = T{0};
+    if (!source_.value(tmp))
+      return false;
+    report_integer(tmp);
+    return true;
+  }
+
+  template <class T>
+  std::enable_if_t<std::is_floating_point<T>::value, bool> value(T &) {
+    auto tmp = T{0};
+    if (!source_.value(tmp))
+      return false;
+    handler_.on_double(static_cast<double>(tmp));
+    return true;
+  }
+
+  bool value(std::byte &) {
+    auto tmp = uint8_t{0};
+    if (!source_.value(tmp))
+      return false;
+    handler_.on_uint64(tmp);
+    return true;
+  }
+
+  bool value(std::string &) { return string_value(); }
+
+  bool value(std::u16string &) {
+    auto tmp = std::u16string{};
+    if (!source_.value(tmp))
+      return false;
+    handler_.on_u16string(tmp);
+    return true;
+  }
+
+  bool value(std::u32string &) {
+    auto tmp = std::u32string{};
+    if (!source_.value(tmp))
+      return false;
+    handler_.on_u32string(tmp);
+    return true;
+  }
+
+  /// Decodes a delta-packed `T` and reports its elements like a list of the
+  /// integers, durations or time points. Called by `skip_delta_packed`.
+  template <class T> bool skip_delta_packed() {
+    auto xs = T{};
+    if (!load_delta_packed(source_, xs))
+      return false;
+    handler_.on_begin_sequence(xs.size());
+    for (auto x : xs)
+      report_element(x);
+    return end_sequence();
+  }
+
+  /// Reports the encoding of a `T`. Called by the field types of the DSL for
+  /// each field of an object.
+  template <class T> bool skip_value() {
+    using access_type = decltype(inspect_access_type<binary_event_reader, T>());
+    if constexpr (std::is_arithmetic<T>::value ||
+                  std::is_same<T, std::byte>::value ||
+                  std::is_same<T, std::u16string>::value ||
+                  std::is_same<T, std::u32string>::value) {
+      auto tmp = T{};
+      return value(tmp);
+    } else if constexpr (std::is_same<T, std::string>::value) {
+      return string_value();
+    } else if constexpr (std::is_same<access_type,
+                                      inspector_access_type::inspect>::value ||
+                         std::is_same<access_type,
+                                      inspector_access_type::empty>::value ||
+                         is_complete<optional_inspector_traits<T>> ||
+                         is_complete<variant_inspector_traits<T>>) {
+      return this->apply(inspect_prototype<T>());
+    } else if constexpr (std::is_array<T>::value) {
+      using value_type = std::remove_extent_t<T>;
+      constexpr auto size = std::extent<T>::value;
+      if (!begin_tuple(size))
+        return false;
+      for (size_t i = 0; i < size; ++i)
+        if (!skip_value<value_type>())
+          return false;
+      return end_tuple();
+    } else if constexpr (std::is_same<access_type,
+                                      inspector_access_type::tuple>::value) {
+      using indexes = std::make_index_sequence<std::tuple_size<T>::value>;
+      return skip_tuple<T>(indexes{});
+    } else if constexpr (std::is_same<access_type,
+                                      inspector_access_type::map>::value) {
+      using key_type = typename T::key_type;
+      using mapped_type = typename T::mapped_type;
+      size_t size = 0;
+      if (!begin_associative_array(size))
+        return false;
+      for (size_t i = 0; i < size; ++i)
+        if (!skip_value<key_type>() || !skip_value<mapped_type>())
+          return false;
+      return end_associative_array();
+    } else if constexpr (std::is_same<access_type,
+                                      inspector_access_type::list>::value) {
+      using value_type = typename T::value_type;
+      if constexpr (is_columnar_list<binary_deserializer, T>()) {
+        if (source_.columnar_lists())
+          return skip_columnar_list<value_type>(*this);
+      }
+      size_t size = 0;
+      if (!begin_sequence(size))
+        return false;
+      for (size_t i = 0; i < size; ++i)
+        if (!skip_value<value_type>())
+          return false;
+      return end_sequence();
+    } else {
+      auto tmp = T{};
+      return this->apply(tmp);
+    }
+  }
+
+private:
+  template <class T> void report_integer(T x) {
+    if constexpr (std::is_same<T, bool>::value)
+      handler_.on_bool(x);
+    else if constexpr (std::is_signed<T>::value)
+      handler_.on_int64(static_cast<int64_t>(x));
+    else
+      handler_.on_uint64(static_cast<uint64_t>(x));
+  }
+
+  // Reports the elements of delta-packed lists like `inspector_access` saves
+  // them, i.e., durations and time points by their count.
+
+  template <class T> void report_element(T x) { report_integer(x); }
+
+  template <class Rep, class Period>
+  void report_element(std::chrono::duration<Rep, Period> x) {
+    report_integer(x.count());
+  }
+
+  template <class Clock, class Duration>
+  void report_element(std::chrono::time_point<Clock, Duration> x) {
+    report_integer(x.time_since_epoch().count());
+  }
+
+  void report_field(std::string_view name, bool is_present) {
+    if (is_present)
+      handler_.on_field(name);
+    else
+      handler_.on_absent_field(name);
+  }
+
+  bool string_value() {
+    size_t size = 0;
+    if (!source_.begin_sequence(size))
+      return false;
+    if (size > source_.remaining()) {
+      source_.emplace_error(error_code::end_of_stream);
+      return false;
+    }
+    auto str = reinterpret_cast<const char *>(source_.current());
+    source_.skip(size);
+    handler_.on_string(std::string_view{str, size});
+    return true;
+  }
+
+  template <class T, size_t... Is>
+  bool skip_tuple(std::index_sequence<Is...>) {
+    return begin_tuple(sizeof...(Is)) &&
+           (skip_value<std::tuple_element_t<Is, T>>() && ...) && end_tuple();
+  }
+
+  binary_deserializer &source_;
+  Handler &handler_;
+};
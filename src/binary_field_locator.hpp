@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+#include "binary_deserializer.hpp"
+#include "field_location.hpp"
+#include "load_inspector_base.hpp"
+#include "span.hpp"
+#include "type_id.hpp"
+
+/// Resolves a path of field names to the position of a fixed-size field in
+/// the encoding of a `T` at the read position of a `binary_deserializer`,
+/// e.g., `"header.hops"`. Skips all other fields with a single pass over the
+/// input and stops at the field. Together with
+/// `binary_serializer::overwrite_value`, this allows updating a field of a
+/// serialized object with a single store. Errors in the input get stored in
+/// the `binary_deserializer`.
+class binary_field_locator final
+    : public load_inspector_base<binary_field_locator> {
+public:
+  explicit binary_field_locator(binary_deserializer &source) noexcept
+      : source_(source), start_(nullptr), depth_(0), path_depth_(0),
+        pending_(false), descend_(false), fixed_(false), result_(nullptr) {}
+
+  static constexpr bool has_human_readable_format() noexcept { return false; }
+
+  /// Locates the field at `path` in the next `T` of the input, where `T` is
+  /// an object with an `inspect` overload. Returns `false` if the input has
+  /// no such field, if the field is absent or if it has no fixed size. Leaves
+  /// the read position of the deserializer in the encoding of the `T` and
+  /// returns the deserializer to the top level.
+  template <class T> bool locate(std::string_view path, field_location &loc) {
+    start_ = source_.current();
+    path_ = path;
+    next_segment();
+    depth_ = 0;
+    path_depth_ = 1;
+    pending_ = false;
+    descend_ = false;
+    fixed_ = true;
+    result_ = &loc;
+    auto found = !this->apply(inspect_prototype<T>()) && result_ == nullptr;
+    result_ = nullptr;
+    // Stopping the walk leaves the objects on the way to the field open.
+    source_.abort_objects();
+    return found;
+  }
+
+  // -- inspector interface ----------------------------------------------------
+
+  static constexpr uint64_t selected_fields() noexcept { return 0; }
+
+  bool begin_object(type_id_t type, std::string_view name) {
+    ++depth_;
+    return source_.begin_object(type, name);
+  }
+
+  bool end_object() {
+    --depth_;
+    return source_.end_object();
+  }
+
+  bool begin_presence_bitmap(size_t num_flags) {
+    return source_.begin_presence_bitmap(num_flags);
+  }
+
+  bool end_presence_bitmap() { return source_.end_presence_bitmap(); }
+
+  bool begin_field(std::string_view name) {
+    match(name);
+    return true;
+  }
+
+  bool begin_field(std::string_view name, bool &is_present) {
+    // The presence of the field may differ between encodings.
+    fixed_ = false;
+    if (!source_.begin_field(name, is_present))
+      return false;
+    return !is_present || (match(name), true);
+  }
+
+  bool begin_field(std::string_view name, span<const type_id_t> types,
+                   size_t &index) {
+    // The size of variant values may differ between encodings.
+    fixed_ = false;
+    return !on_path(name) && source_.begin_field(name, types, index);
+  }
+
+  bool begin_field(std::string_view name, bool &is_present,
+                   span<const type_id_t> types, size_t &index) {
+    fixed_ = false;
+    return !on_path(name) &&
+           source_.begin_field(name, is_present, types, index);
+  }
+
+  constexpr bool end_field() noexcept { return true; }
+
+  /// Reads the size of a sequence in a field with its own encoding, e.g., a
+  /// `delta_packed` field. Such fields have no fixed size, so the walk stops
+  /// if the path leads into one.
+  bool begin_sequence(size_t &size) {
+    fixed_ = false;
+    if (pending_ || descend_) {
+      pending_ = false;
+      descend_ = false;
+      return false;
+    }
+    return source_.begin_sequence(size);
+  }
+
+  constexpr bool end_sequence() noexcept { return true; }
+
+  template <class T> bool value(T &x) { return source_.value(x); }
+
+  /// Skips the encoding of a `T` unless it is the field at the path or an
+  /// object on the way to it. Walks other objects field by field to keep
+  /// track of whether they have a fixed size. Called by the field types of
+  /// the DSL for each field of an object.
+  template <class T> bool skip_value() {
+    using access_type =
+        decltype(inspect_access_type<binary_field_locator, T>());
+    constexpr auto size = binary_deserializer::encoded_size_v<T>;
+    if (pending_) {
+      pending_ = false;
+      if constexpr (size > 0) {
+        result_->offset = static_cast<size_t>(source_.current() - start_);
+        result_->size = size;
+        result_->fixed = fixed_;
+        result_ = nullptr;
+      }
+      // Stops the walk.
+      return false;
+    }
+    constexpr auto is_object =
+        std::is_same<access_type, inspector_access_type::inspect>::value;
+    if (descend_) {
+      descend_ = false;
+      if constexpr (is_object) {
+        next_segment();
+        ++path_depth_;
+        static_cast<void>(this->apply(inspect_prototype<T>()));
+      }
+      // Stops the walk, the rest of the path is in this value or nowhere.
+      return false;
+    }
+    if constexpr (is_object) {
+      return this->apply(inspect_prototype<T>());
+    } else {
+      if constexpr (size == 0)
+        fixed_ = false;
+      return source_.skip_value<T>();
+    }
+  }
+
+private:
+  void next_segment() noexcept {
+    auto pos = path_.find('.');
+    segment_ = path_.substr(0, pos);
+    path_ = pos == std::string_view::npos ? std::string_view{}
+                                          : path_.substr(pos + 1);
+  }
+
+  bool on_path(std::string_view name) const noexcept {
+    return depth_ == path_depth_ && name == segment_;
+  }
+
+  void match(std::string_view name) noexcept {
+    if (!on_path(name))
+      return;
+    if (path_.empty())
+      pending_ = true;
+    else
+      descend_ = true;
+  }
+
+  binary_deserializer &source_;
+  const std::byte *start_;   // read position at the start of `locate`
+  size_t depth_;             // nesting level of objects
+  size_t path_depth_;        // nesting level of the fields in `segment_`
+  std::string_view path_;    // remaining path after `segment_`
+  std::string_view segment_; // name of the next field on the path
+  bool pending_;             // the next value is the field at the path
+  bool descend_;             // the next value is an object on the path
+  bool fixed_;               // all values so far had a fixed size
+  field_location *result_;   // null after locating the field
+};
@@ -1,21 +1,13 @@
 
 #include "binary_serializer.hpp"
-#include "ieee_754.hpp"
-#include "network_order.hpp"
 
+#include <algorithm>
 #include <assert.h>
 #include <iomanip>
 #include <limits>
 #include <sstream>
 #include <string.h>
 
-// change int value to bytes array/ bool/int8/int16/int32/int64
-template <class T> auto int_value(binary_serializer &sink, T x) {
-  using unsigned_type = squashed_int_t<std::make_unsigned_t<T>>;
-  auto y = to_network_order(static_cast<unsigned_type>(x));
-  return sink.value(as_bytes(make_span(&y, 1)));
-}
-
 template <class T>
 constexpr size_t max_value = static_cast<size_t>(std::numeric_limits<T>::max());
 
@@ -25,28 +17,147 @@ template <class T> T compress_index(bool is_present, size_t value) {
   return val;
 }
 
-void binary_serializer::skip(size_t num_bytes) {
-  auto remaining = buf_.size() - write_pos_;
-  if (remaining < num_bytes)
-    buf_.insert(buf_.end(), num_bytes - remaining, std::byte{0});
-  write_pos_ += num_bytes;
+// number of bytes to collect before updating the checksum
+constexpr size_t checksum_block_size = 4096;
+
+void binary_serializer::begin_checksum() noexcept {
+  checksum_.reset();
+  checksum_pos_ = write_pos_;
+  checksum_limit_ = write_pos_ + checksum_block_size;
+}
+
+bool binary_serializer::end_checksum() {
+  if (checksum_limit_ == no_checksum) {
+    emplace_error(error_code::runtime_error, "no checksum in progress");
+    return false;
+  }
+  update_checksum();
+  checksum_limit_ = no_checksum;
+  return value(checksum_.value());
+}
+
+void binary_serializer::update_checksum() noexcept {
+  assert(checksum_pos_ <= write_pos_);
+  // The sizes and the presence bitmaps of open objects get written later.
+  auto end = std::min(write_pos_, length_pos_);
+  if (!presence_.empty())
+    end = std::min(end, presence_.front().pos);
+  if (!nested_.empty())
+    end = std::min(end, nested_.front());
+  if (!maps_.empty())
+    end = std::min(end, maps_.front().pos);
+  end = std::max(checksum_pos_, end);
+  checksum_.update(make_span(buf_.data() + checksum_pos_, buf_.data() + end));
+  checksum_pos_ = end;
+  checksum_limit_ = write_pos_ + checksum_block_size;
+}
+
+bool binary_serializer::begin_typed_object(type_id_t type) {
+  if (!value(type))
+    return false;
+  length_pos_ = write_pos_;
+  return value(uint32_t{0});
+}
+
+bool binary_serializer::end_typed_object() {
+  auto pos = length_pos_;
+  length_pos_ = no_length;
+  return write_object_size(pos);
+}
+
+bool binary_serializer::begin_nested_object() {
+  nested_.push_back(write_pos_);
+  return value(uint32_t{0});
+}
+
+bool binary_serializer::end_nested_object() {
+  auto pos = nested_.back();
+  nested_.pop_back();
+  return write_object_size(pos);
+}
+
+bool binary_serializer::begin_indexed_map(size_t size) {
+  if (!begin_sequence(size))
+    return false;
+  maps_.push_back(map_frame{write_pos_, size, 0});
+  // Reserve the size of all entries and the offset table.
+  skip(sizeof(uint32_t) * (size + 1));
+  return true;
+}
+
+bool binary_serializer::begin_map_entry() {
+  auto &frame = maps_.back();
+  if (frame.next == frame.size) {
+    emplace_error(error_code::runtime_error, "too many map entries");
+    return false;
+  }
+  auto entries_pos = frame.pos + sizeof(uint32_t) * (frame.size + 1);
+  auto offset_pos = frame.pos + sizeof(uint32_t) * (frame.next + 1);
+  ++frame.next;
+  return write_size(offset_pos, write_pos_ - entries_pos);
+}
+
+bool binary_serializer::end_indexed_map() {
+  auto frame = maps_.back();
+  maps_.pop_back();
+  if (frame.next != frame.size) {
+    emplace_error(error_code::runtime_error, "missing map entries");
+    return false;
+  }
+  auto entries_pos = frame.pos + sizeof(uint32_t) * (frame.size + 1);
+  return write_size(frame.pos, write_pos_ - entries_pos);
+}
+
+bool binary_serializer::write_object_size(size_t pos) {
+  return write_size(pos, write_pos_ - pos - sizeof(uint32_t));
+}
+
+bool binary_serializer::write_size(size_t pos, size_t size) {
+  if (size > std::numeric_limits<uint32_t>::max()) {
+    emplace_error(error_code::runtime_error, "object too large");
+    return false;
+  }
+  auto tmp = to_network_order(static_cast<uint32_t>(size));
+  memcpy(buf_.data() + pos, &tmp, sizeof(tmp));
+  return true;
+}
+
+size_t binary_serializer::shared_key_hash::operator()(
+    const shared_key &x) const noexcept {
+  auto h = std::hash<const void *>{}(x.type);
+  return h ^ (std::hash<const void *>{}(x.ptr) + 0x9e3779b97f4a7c15ull +
+              (h << 6) + (h >> 2));
+}
+
+void binary_serializer::abort_objects() noexcept {
+  depth_ = 0;
+  length_pos_ = no_length;
+  presence_.clear();
+  nested_.clear();
+  maps_.clear();
+  shared_.clear();
 }
 
-bool binary_serializer::begin_sequence(size_t list_size) {
-  uint8_t buf[16];
-  auto i = buf;
-  auto x = static_cast<uint32_t>(list_size);
-  while (x > 0x7f) {
-    *i++ = (static_cast<uint8_t>(x) & 0x7f) | 0x80;
-    x >>= 7;
+size_t binary_serializer::add_shared_object(size_t pos, const void *type,
+                                            std::shared_ptr<const void> ptr) {
+  auto k = shared_key{type, ptr.get()};
+  auto [i, added] = shared_.emplace(k, shared_entry{pos, nullptr});
+  if (!added) {
+    if (i->second.pos >= back_reference_limit_)
+      return pos - i->second.pos;
+    // Later pointers refer to this one instead.
+    i->second.pos = pos;
+    return 0;
   }
-  *i++ = static_cast<uint8_t>(x) & 0x7f;
-  return value(as_bytes(make_span(buf, static_cast<size_t>(i - buf))));
+  i->second.owner = std::move(ptr);
+  return 0;
 }
 
-bool binary_serializer::begin_field(std::string_view, bool is_present) {
-  auto val = static_cast<uint8_t>(is_present);
-  return value(val);
+void binary_serializer::skip(size_t num_bytes) {
+  auto remaining = buf_.size() - write_pos_;
+  if (remaining < num_bytes)
+    buf_.insert(buf_.end(), num_bytes - remaining, std::byte{0});
+  write_pos_ += num_bytes;
 }
 
 bool binary_serializer::begin_field(std::string_view,
@@ -77,13 +188,10 @@ bool binary_serializer::begin_field(std::string_view, bool is_present,
   }
 }
 
-// all the serialize entry
-bool binary_serializer::value(span<const std::byte> x) {
-  assert(write_pos_ <= buf_.size());
+bool binary_serializer::overwrite(span<const std::byte> x) {
+  assert(write_pos_ < buf_.size());
   auto buf_size = buf_.size();
-  if (write_pos_ == buf_size) {
-    buf_.insert(buf_.end(), x.begin(), x.end());
-  } else if (write_pos_ + x.size() <= buf_size) {
+  if (write_pos_ + x.size() <= buf_size) {
     memcpy(buf_.data() + write_pos_, x.data(), x.size());
   } else {
     auto remaining = buf_size - write_pos_;
@@ -96,45 +204,11 @@ bool binary_serializer::value(span<const std::byte> x) {
   }
   write_pos_ += x.size();
   assert(write_pos_ <= buf_.size());
+  if (write_pos_ >= checksum_limit_)
+    update_checksum();
   return true;
 }
 
-// all the serialize entry
-bool binary_serializer::value(std::byte x) {
-  if (write_pos_ == buf_.size())
-    buf_.emplace_back(x);
-  else
-    buf_[write_pos_] = x;
-  ++write_pos_;
-  return true;
-}
-
-bool binary_serializer::value(bool x) { return value(static_cast<uint8_t>(x)); }
-
-bool binary_serializer::value(int8_t x) {
-  return value(static_cast<std::byte>(x));
-}
-
-bool binary_serializer::value(uint8_t x) {
-  return value(static_cast<std::byte>(x));
-}
-
-bool binary_serializer::value(int16_t x) { return int_value(*this, x); }
-
-bool binary_serializer::value(uint16_t x) { return int_value(*this, x); }
-
-bool binary_serializer::value(int32_t x) { return int_value(*this, x); }
-
-bool binary_serializer::value(uint32_t x) { return int_value(*this, x); }
-
-bool binary_serializer::value(int64_t x) { return int_value(*this, x); }
-
-bool binary_serializer::value(uint64_t x) { return int_value(*this, x); }
-
-bool binary_serializer::value(float x) { return int_value(*this, pack754(x)); }
-
-bool binary_serializer::value(double x) { return int_value(*this, pack754(x)); }
-
 bool binary_serializer::value(long double x) {
   std::ostringstream oss;
   oss << std::setprecision(std::numeric_limits<long double>::digits) << x;
@@ -142,19 +216,12 @@ bool binary_serializer::value(long double x) {
   return value(tmp);
 }
 
-bool binary_serializer::value(std::string_view x) {
-  if (!begin_sequence(x.size()))
-    return false;
-  value(as_bytes(make_span(x)));
-  return end_sequence();
-}
-
 bool binary_serializer::value(const std::u16string &x) {
   auto str_size = x.size();
   if (!begin_sequence(str_size))
     return false;
   for (auto c : x)
-    int_value(*this, static_cast<uint16_t>(c));
+    int_value(static_cast<uint16_t>(c));
   return end_sequence();
 }
 
@@ -163,7 +230,7 @@ bool binary_serializer::value(const std::u32string &x) {
   if (!begin_sequence(str_size))
     return false;
   for (auto c : x)
-    int_value(*this, static_cast<uint32_t>(c));
+    int_value(static_cast<uint32_t>(c));
   return end_sequence();
 }
 
@@ -1,10 +1,19 @@
 #pragma once
 
 #include <cstddef>
+#include <cstring>
+#include <limits>
+#include <memory>
 #include <string>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "crc32c.hpp"
+#include "field_location.hpp"
+#include "ieee_754.hpp"
+#include "network_order.hpp"
 #include "save_inspector_base.hpp"
 #include "span.hpp"
 #include "squashed_int.hpp"
@@ -13,13 +22,19 @@
 
 using byte_buffer = std::vector<std::byte>;
 
-class binary_serializer : public save_inspector_base<binary_serializer> {
+class serialization_cache;
+
+class binary_serializer final : public save_inspector_base<binary_serializer> {
 public:
   // using super = save_inspector_base<binary_serializer>;
   using container_type = byte_buffer;
   using value_type = std::byte;
   binary_serializer(byte_buffer &buf) noexcept
-      : buf_(buf), write_pos_(buf.size()) {}
+      : buf_(buf), write_pos_(buf.size()), checksum_pos_(0),
+        checksum_limit_(no_checksum), typed_stream_(false), depth_(0),
+        length_pos_(no_length), presence_bitmaps_(false),
+        nested_object_lengths_(false), indexed_maps_(false),
+        columnar_lists_(false), cache_(nullptr), back_reference_limit_(0) {}
   virtual ~binary_serializer() {}
   DISABLE_COPY(binary_serializer)
   DISABLE_MOVE(binary_serializer)
@@ -27,50 +42,339 @@ public:
   const byte_buffer &buf() const noexcept { return buf_; }
   size_t write_pos() const noexcept { return write_pos_; }
   static constexpr bool has_human_readable_format() noexcept { return false; }
-  void seek(size_t offset) noexcept { write_pos_ = offset; }
+  using save_inspector_base<binary_serializer>::apply;
+  /// Saves `x`. If saving a top-level value fails, e.g., because an `on_save`
+  /// callback returns `false`, resets the nesting level and drops all open
+  /// bitmaps, lengths, maps and shared objects, so that the next value starts
+  /// at the top level again.
+  template <class T> [[nodiscard]] bool apply(const T &x) {
+    if (depth_ > 0)
+      return save_inspector_base<binary_serializer>::apply(x);
+    if (save_inspector_base<binary_serializer>::apply(x))
+      return true;
+    abort_objects();
+    return false;
+  }
+  /// Moves the write position to `offset`. Pointers after seeking never
+  /// refer to shared objects before seeking.
+  void seek(size_t offset) noexcept {
+    write_pos_ = offset;
+    if (!shared_.empty())
+      clear_shared_objects();
+  }
+  /// Overwrites the field at `loc` in the object that starts at `object_pos`
+  /// with `x` and restores the write position, e.g., to update a field found
+  /// by `binary_field_locator` without encoding the object again. Locations
+  /// that are not `fixed` are only valid for the buffer that they were found
+  /// in. Requires a `T` with the size of the field. Checksums over the
+  /// overwritten bytes are not updated.
+  template <class T>
+  bool overwrite_value(const field_location &loc, T x, size_t object_pos = 0) {
+    static_assert(std::is_arithmetic<T>::value &&
+                      !std::is_same<T, long double>::value,
+                  "overwrite_value requires a fixed-size type");
+    if (loc.size != sizeof(T)) {
+      emplace_error(error_code::invalid_argument, "invalid field location");
+      return false;
+    }
+    auto offset = object_pos + loc.offset;
+    if (offset > buf_.size() || buf_.size() - offset < sizeof(T)) {
+      emplace_error(error_code::runtime_error, "offset out of range");
+      return false;
+    }
+    // Sets the write position directly, since `seek` drops shared objects.
+    auto pos = write_pos_;
+    write_pos_ = offset;
+    auto result = value(x);
+    write_pos_ = pos;
+    return result;
+  }
   void skip(size_t num_bytes);
-  constexpr bool begin_object(type_id_t, std::string_view) noexcept {
+  /// Starts computing a CRC32C over all bytes written after this call. The
+  /// checksum gets updated block-wise while writing, i.e., while the bytes are
+  /// still in cache. Seeking back into the checksummed range is unsupported.
+  void begin_checksum() noexcept;
+  /// Appends the CRC32C of all bytes written since `begin_checksum` as a
+  /// 4-byte trailer.
+  bool end_checksum();
+  /// Enables or disables the typed stream mode. In this mode, each top-level
+  /// object starts with its `type_id_t` and the size of its encoding as
+  /// `uint32_t`. This allows `binary_deserializer::fetch_next_object_type` to
+  /// report the type of the next object and readers to skip unknown objects.
+  void set_typed_stream(bool enabled) noexcept { typed_stream_ = enabled; }
+  bool typed_stream() const noexcept { return typed_stream_; }
+  /// Enables or disables presence bitmaps. In this mode, each object starts
+  /// with one bit per optional field instead of storing one byte per field.
+  /// Optional variants keep encoding absence in their type index.
+  void set_presence_bitmaps(bool enabled) noexcept {
+    presence_bitmaps_ = enabled;
+  }
+  bool presence_bitmaps() const noexcept { return presence_bitmaps_; }
+  /// Reserves a bitmap for the next `num_flags` calls to `begin_field(name,
+  /// bool)` of the current object.
+  bool begin_presence_bitmap(size_t num_flags) {
+    if (!presence_bitmaps_)
+      return true;
+    presence_.push_back(presence_frame{write_pos_, num_flags, 0});
+    for (size_t i = 0; i < (num_flags + 7) / 8; ++i)
+      if (!value(std::byte{0}))
+        return false;
+    return true;
+  }
+  bool end_presence_bitmap() {
+    if (presence_bitmaps_)
+      presence_.pop_back();
     return true;
   }
-  constexpr bool end_object() { return true; }
+  /// Enables or disables nested object lengths. In this mode, each object
+  /// below the top level starts with the size of its encoding as `uint32_t`.
+  /// This allows `binary_deserializer` to skip nested objects of unselected
+  /// fields without decoding them.
+  void set_nested_object_lengths(bool enabled) noexcept {
+    nested_object_lengths_ = enabled;
+  }
+  bool nested_object_lengths() const noexcept { return nested_object_lengths_; }
+  /// Enables or disables indexed maps. In this mode, maps store their entries
+  /// sorted by key. The size of the map is followed by the size of all
+  /// entries and the offset of each entry relative to the first entry, all as
+  /// `uint32_t`. This allows `map_view` to look up keys without decoding the
+  /// map.
+  void set_indexed_maps(bool enabled) noexcept { indexed_maps_ = enabled; }
+  bool indexed_maps() const noexcept { return indexed_maps_; }
+  /// Enables or disables columnar lists. In this mode, a `std::vector` of
+  /// objects stores one column per field after its size, each holding the
+  /// values of the field for all objects. Numeric columns get converted to
+  /// network byte order in a single pass, and similar values next to each
+  /// other compress better.
+  void set_columnar_lists(bool enabled) noexcept { columnar_lists_ = enabled; }
+  bool columnar_lists() const noexcept { return columnar_lists_; }
+  /// Sets the cache for the encodings of `cacheable` values or disables
+  /// caching if `cache` is null. On a hit, the serializer copies the cached
+  /// bytes instead of inspecting the value.
+  void set_cache(serialization_cache *cache) noexcept { cache_ = cache; }
+  serialization_cache *cache() const noexcept { return cache_; }
+  size_t depth() const noexcept { return depth_; }
+  /// Registers the shared object `ptr` of type `type` for a pointer at `pos`.
+  /// Returns 0 for new objects, otherwise the distance in bytes to the first
+  /// pointer to the object. Back-references reach back to the start of the
+  /// current top-level object. Outside of objects, they reach back to the
+  /// last call to `seek` or `clear_shared_objects`. Keeps `ptr` alive until
+  /// then, so that no other object can reuse its address.
+  size_t add_shared_object(size_t pos, const void *type,
+                           std::shared_ptr<const void> ptr);
+  /// Prevents back-references to pointers before `pos`, e.g., for encodings
+  /// that get copied into other messages. Returns the previous limit.
+  size_t limit_back_references(size_t pos) noexcept {
+    return std::exchange(back_reference_limit_, pos);
+  }
+  /// Forgets all shared objects, i.e., the next pointer to any object writes
+  /// a copy instead of a back-reference.
+  void clear_shared_objects() noexcept { shared_.clear(); }
+  /// Returns a bitmask of the settings that change the encoding of a value
+  /// at the current nesting level.
+  uint8_t layout() const noexcept {
+    return static_cast<uint8_t>(
+        (typed_stream_ ? 0x01 : 0) | (presence_bitmaps_ ? 0x02 : 0) |
+        (nested_object_lengths_ ? 0x04 : 0) | (indexed_maps_ ? 0x08 : 0) |
+        (depth_ == 0 ? 0x10 : 0) | (columnar_lists_ ? 0x20 : 0));
+  }
+  bool begin_object(type_id_t type, std::string_view) {
+    if (depth_++ == 0)
+      return !typed_stream_ || begin_typed_object(type);
+    return !nested_object_lengths_ || begin_nested_object();
+  }
+  bool end_object() {
+    if (--depth_ == 0) {
+      if (!shared_.empty())
+        clear_shared_objects();
+      return !typed_stream_ || end_typed_object();
+    }
+    return !nested_object_lengths_ || end_nested_object();
+  }
   constexpr bool begin_field(std::string_view) noexcept { return true; }
-  bool begin_field(std::string_view, bool is_present);
+  bool begin_field(std::string_view, bool is_present) {
+    if (presence_.empty() || presence_.back().next == presence_.back().size)
+      return value(static_cast<uint8_t>(is_present));
+    auto &frame = presence_.back();
+    if (is_present)
+      buf_[frame.pos + frame.next / 8] |= std::byte{0x80} >> (frame.next % 8);
+    ++frame.next;
+    return true;
+  }
   bool begin_field(std::string_view, span<const type_id_t> types, size_t index);
   bool begin_field(std::string_view, bool is_present,
                    span<const type_id_t> types, size_t index);
   constexpr bool end_field() { return true; }
   constexpr bool begin_tuple(size_t) { return true; }
   constexpr bool end_tuple() { return true; }
-  constexpr bool begin_key_value_pair() { return true; }
+  bool begin_key_value_pair() {
+    if (!indexed_maps_)
+      return true;
+    return begin_map_entry();
+  }
   constexpr bool end_key_value_pair() { return true; }
-  bool begin_sequence(size_t list_size);
+  bool begin_sequence(size_t list_size) {
+    uint8_t buf[16];
+    auto i = buf;
+    auto x = static_cast<uint32_t>(list_size);
+    while (x > 0x7f) {
+      *i++ = (static_cast<uint8_t>(x) & 0x7f) | 0x80;
+      x >>= 7;
+    }
+    *i++ = static_cast<uint8_t>(x) & 0x7f;
+    return value(as_bytes(make_span(buf, static_cast<size_t>(i - buf))));
+  }
   constexpr bool end_sequence() { return true; }
-  bool begin_associative_array(size_t size) { return begin_sequence(size); }
-  bool end_associative_array() { return end_sequence(); }
-  bool value(std::byte x);
-  bool value(bool x);
-  bool value(int8_t x);
-  bool value(uint8_t x);
-  bool value(int16_t x);
-  bool value(uint16_t x);
-  bool value(int32_t x);
-  bool value(uint32_t x);
-  bool value(int64_t x);
-  bool value(uint64_t x);
+  bool begin_associative_array(size_t size) {
+    if (!indexed_maps_)
+      return begin_sequence(size);
+    return begin_indexed_map(size);
+  }
+  bool end_associative_array() {
+    if (!indexed_maps_)
+      return end_sequence();
+    return end_indexed_map();
+  }
+  // The primitive encoders are defined inline to allow the compiler to merge
+  // consecutive writes of a fully inlined `inspect` overload.
+  bool value(std::byte x) {
+    if (write_pos_ == buf_.size())
+      buf_.emplace_back(x);
+    else
+      buf_[write_pos_] = x;
+    ++write_pos_;
+    if (write_pos_ >= checksum_limit_)
+      update_checksum();
+    return true;
+  }
+  bool value(bool x) { return value(static_cast<uint8_t>(x)); }
+  bool value(int8_t x) { return value(static_cast<std::byte>(x)); }
+  bool value(uint8_t x) { return value(static_cast<std::byte>(x)); }
+  bool value(int16_t x) { return int_value(x); }
+  bool value(uint16_t x) { return int_value(x); }
+  bool value(int32_t x) { return int_value(x); }
+  bool value(uint32_t x) { return int_value(x); }
+  bool value(int64_t x) { return int_value(x); }
+  bool value(uint64_t x) { return int_value(x); }
   template <class T>
   std::enable_if_t<std::is_integral<T>::value, bool> value(T x) {
     return value(static_cast<squashed_int_t<T>>(x));
   }
-  bool value(float x);
-  bool value(double x);
+  bool value(float x) { return int_value(pack754(x)); }
+  bool value(double x) { return int_value(pack754(x)); }
   bool value(long double x);
-  bool value(std::string_view x);
+  bool value(std::string_view x) {
+    return begin_sequence(x.size()) && value(as_bytes(make_span(x)));
+  }
   bool value(const std::u16string &x);
   bool value(const std::u32string &x);
-  bool value(span<const std::byte> x);
+  bool value(span<const std::byte> x) {
+    if (write_pos_ != buf_.size())
+      return overwrite(x);
+    // Growing the buffer and copying afterwards lets the compiler turn the
+    // copy of a fixed-size value into a single store.
+    buf_.resize(write_pos_ + x.size());
+    memcpy(buf_.data() + write_pos_, x.data(), x.size());
+    write_pos_ += x.size();
+    if (write_pos_ >= checksum_limit_)
+      update_checksum();
+    return true;
+  }
   bool value(const std::vector<bool> &x);
+  /// Writes the `n` numbers `get(0)` to `get(n - 1)` of type `T`, e.g., a
+  /// column of a columnar list.
+  template <class T, class Get> bool values(size_t n, Get &&get) {
+    using wire_type = decltype(wire_value(T{}));
+    if (write_pos_ != buf_.size()) {
+      for (size_t i = 0; i < n; ++i)
+        if (!value(static_cast<T>(get(i))))
+          return false;
+      return true;
+    }
+    buf_.resize(write_pos_ + n * sizeof(wire_type));
+    auto out = buf_.data() + write_pos_;
+    for (size_t i = 0; i < n; ++i) {
+      auto x = wire_value(static_cast<T>(get(i)));
+      memcpy(out + i * sizeof(wire_type), &x, sizeof(wire_type));
+    }
+    write_pos_ += n * sizeof(wire_type);
+    if (write_pos_ >= checksum_limit_)
+      update_checksum();
+    return true;
+  }
 
 private:
+  static constexpr size_t no_checksum = std::numeric_limits<size_t>::max();
+  static constexpr size_t no_length = std::numeric_limits<size_t>::max();
+  struct map_frame {
+    size_t pos;  // offset of the size of all entries
+    size_t size; // number of entries
+    size_t next; // index of the next entry
+  };
+  struct shared_key {
+    const void *type;
+    const void *ptr;
+    bool operator==(const shared_key &other) const noexcept {
+      return type == other.type && ptr == other.ptr;
+    }
+  };
+  struct shared_key_hash {
+    size_t operator()(const shared_key &x) const noexcept;
+  };
+  struct shared_entry {
+    size_t pos; // offset of the first pointer to the object
+    std::shared_ptr<const void> owner;
+  };
+  struct presence_frame {
+    size_t pos;  // offset of the bitmap
+    size_t size; // number of flags in the bitmap
+    size_t next; // index of the next flag
+  };
+  /// Converts a number to the bytes of its encoding.
+  template <class T> static auto wire_value(T x) noexcept {
+    if constexpr (std::is_floating_point<T>::value)
+      return to_network_order(pack754(x));
+    else
+      return to_network_order(
+          static_cast<squashed_int_t<std::make_unsigned_t<T>>>(x));
+  }
+  template <class T> bool int_value(T x) {
+    using unsigned_type = squashed_int_t<std::make_unsigned_t<T>>;
+    auto y = to_network_order(static_cast<unsigned_type>(x));
+    return value(as_bytes(make_span(&y, 1)));
+  }
+  /// Returns to the top level after a failed `apply`.
+  void abort_objects() noexcept;
+  /// Writes `x` at a position before the end of the buffer.
+  bool overwrite(span<const std::byte> x);
+  void update_checksum() noexcept;
+  bool begin_typed_object(type_id_t type);
+  bool end_typed_object();
+  bool begin_nested_object();
+  bool end_nested_object();
+  bool begin_indexed_map(size_t size);
+  bool begin_map_entry();
+  bool end_indexed_map();
+  /// Writes the size of the object encoded after the `uint32_t` at `pos`.
+  bool write_object_size(size_t pos);
+  bool write_size(size_t pos, size_t size);
   byte_buffer &buf_;
   size_t write_pos_;
+  crc32c checksum_;
+  size_t checksum_pos_;   // bytes before this offset are in `checksum_`
+  size_t checksum_limit_; // update `checksum_` when reaching this offset
+  bool typed_stream_;
+  size_t depth_;      // nesting level of objects
+  size_t length_pos_; // offset of the size of the open top-level object
+  bool presence_bitmaps_;
+  std::vector<presence_frame> presence_; // bitmaps of the open objects
+  bool nested_object_lengths_;
+  std::vector<size_t> nested_; // offsets of the sizes of open nested objects
+  bool indexed_maps_;
+  std::vector<map_frame> maps_; // open indexed maps
+  bool columnar_lists_;
+  serialization_cache *cache_;
+  // shared objects of the current top-level object
+  std::unordered_map<shared_key, shared_entry, shared_key_hash> shared_;
+  size_t back_reference_limit_; // offset of the first pointer to refer to
 };
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "def_traits.hpp"
+#include "inspector_access.hpp"
+#include "load_inspector.hpp"
+#include "my_error.hpp"
+#include "save_inspector.hpp"
+
+template <class Inspector, class = void>
+struct has_columnar_lists : std::false_type {};
+
+template <class Inspector>
+struct has_columnar_lists<
+    Inspector,
+    std::void_t<decltype(std::declval<Inspector &>().columnar_lists())>>
+    : std::true_type {};
+
+template <class T> struct is_std_vector : std::false_type {};
+
+template <class T, class Allocator>
+struct is_std_vector<std::vector<T, Allocator>> : std::true_type {};
+
+/// Checks whether `Inspector` may store a `T` in the columnar layout, i.e.,
+/// whether `T` is a `std::vector` of objects with an `inspect` overload.
+template <class Inspector, class T> constexpr bool is_columnar_list() {
+  if constexpr (has_columnar_lists<Inspector>::value &&
+                is_std_vector<T>::value) {
+    using access_type =
+        decltype(inspect_access_type<Inspector, typename T::value_type>());
+    return std::is_same<access_type, inspector_access_type::inspect>::value;
+  } else {
+    return false;
+  }
+}
+
+/// Callback of records without `on_save` or `on_load`.
+struct no_record_callback {
+  constexpr bool operator()() const noexcept { return true; }
+};
+
+/// Walks the DSL of an `inspect` overload and passes the callback and the
+/// fields of the record to `Callback` instead of loading or saving them.
+/// `Base` is either `save_inspector` or `load_inspector` and selects the
+/// field types of the DSL.
+template <class Base, class Callback>
+class record_field_collector final : public Base {
+public:
+  static constexpr bool has_human_readable_format() noexcept { return false; }
+
+  explicit record_field_collector(Callback &callback) noexcept
+      : callback_(callback) {}
+
+  template <class RecordCallback> struct object_t {
+    Callback *callback;
+    RecordCallback record_callback;
+
+    template <class... Fields> bool fields(Fields &&... fs) {
+      return (*callback)(record_callback, fs...);
+    }
+
+    object_t &&pretty_name(std::string_view) && { return std::move(*this); }
+
+    template <class F> auto on_save(F fun) && {
+      if constexpr (Base::is_loading)
+        return std::move(*this);
+      else
+        return object_t<F>{callback, std::move(fun)};
+    }
+
+    template <class F> auto on_load(F fun) && {
+      if constexpr (Base::is_loading)
+        return object_t<F>{callback, std::move(fun)};
+      else
+        return std::move(*this);
+    }
+  };
+
+  template <class T> auto object(T &) noexcept {
+    return object_t<no_record_callback>{std::addressof(callback_), {}};
+  }
+
+private:
+  Callback &callback_;
+};
+
+/// Runs the `on_save` or `on_load` callback of a record.
+template <class Inspector, class F>
+bool run_record_callback(Inspector &f, F &callback, error_code code) {
+  using result_type = decltype(callback());
+  if constexpr (std::is_same<result_type, bool>::value) {
+    if (!callback()) {
+      f.set_error(code);
+      return false;
+    }
+  } else {
+    if (auto err = callback()) {
+      f.set_error(std::move(err));
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Calls `fun(callback, fs...)` with the callback and the fields of `x`.
+template <class Base, class T, class F> bool with_record_fields(T &x, F fun) {
+  record_field_collector<Base, F> collector{fun};
+  return inspect(collector, x);
+}
+
+/// Checks whether the field type `Field` of the DSL stores a fixed-size
+/// number that inspectors may write as a block.
+template <class Field> struct is_number_field : std::false_type {};
+
+template <class T>
+struct is_number_field<save_inspector::field_t<T>>
+    : std::bool_constant<(std::is_integral<T>::value &&
+                          !std::is_same<T, bool>::value && sizeof(T) > 1) ||
+                         std::is_same<T, float>::value ||
+                         std::is_same<T, double>::value> {
+  using value_type = T;
+};
+
+template <class T>
+struct is_number_field<load_inspector::field_t<T>>
+    : is_number_field<save_inspector::field_t<T>> {};
+
+// -- saving -------------------------------------------------------------------
+
+/// Saves field `I` of all records in `xs`.
+template <size_t I, class Field, class Inspector, class T>
+bool save_column(Inspector &f, const std::vector<T> &xs) {
+  if constexpr (is_number_field<Field>::value) {
+    using value_type = typename is_number_field<Field>::value_type;
+    auto get = [&xs](size_t i) {
+      const value_type *ptr = nullptr;
+      auto find = [&ptr](auto &, auto &... fs) {
+        ptr = std::get<I>(std::forward_as_tuple(fs...)).val;
+        return true;
+      };
+      static_cast<void>(
+          with_record_fields<save_inspector>(as_mutable_ref(xs[i]), find));
+      return *ptr;
+    };
+    return f.template values<value_type>(xs.size(), get);
+  } else {
+    auto save_field = [&f](auto &, auto &... fs) {
+      return std::get<I>(std::forward_as_tuple(fs...))(f);
+    };
+    for (auto &x : xs)
+      if (!with_record_fields<save_inspector>(as_mutable_ref(x), save_field))
+        return false;
+    return true;
+  }
+}
+
+template <class Inspector, class T, class... Fields, size_t... Is>
+bool save_columns(Inspector &f, const std::vector<T> &xs,
+                  std::index_sequence<Is...>) {
+  return (save_column<Is, Fields>(f, xs) && ...);
+}
+
+/// Saves a list of records in the columnar layout: the size of the list
+/// followed by one column per field, each holding the values of the field
+/// for all records. Runs the `on_save` callbacks of all records first.
+template <class Inspector, class T>
+bool save_columnar_list(Inspector &f, const std::vector<T> &xs) {
+  if (!f.begin_sequence(xs.size()))
+    return false;
+  if (xs.empty())
+    return f.end_sequence();
+  auto save_all = [&f, &xs](auto &callback, auto &... fs) {
+    using callback_type = std::decay_t<decltype(callback)>;
+    if constexpr (!std::is_same<callback_type, no_record_callback>::value) {
+      auto run = [&f](auto &record_callback, auto &...) {
+        return run_record_callback(f, record_callback,
+                                   error_code::save_callback_failed);
+      };
+      for (auto &x : xs)
+        if (!with_record_fields<save_inspector>(as_mutable_ref(x), run))
+          return false;
+    }
+    return save_columns<Inspector, T, std::decay_t<decltype(fs)>...>(
+        f, xs, std::index_sequence_for<decltype(fs)...>{});
+  };
+  // Optional fields store their presence in one byte per value.
+  return f.begin_presence_bitmap(0) &&
+         with_record_fields<save_inspector>(as_mutable_ref(xs.front()),
+                                            save_all) &&
+         f.end_presence_bitmap() && f.end_sequence();
+}
+
+// -- loading ------------------------------------------------------------------
+
+/// Loads field `I` of all records in `xs`.
+template <size_t I, class Field, class Inspector, class T>
+bool load_column(Inspector &f, std::vector<T> &xs) {
+  if constexpr (is_number_field<Field>::value) {
+    using value_type = typename is_number_field<Field>::value_type;
+    auto set = [&xs](size_t i, value_type val) {
+      auto assign = [val](auto &, auto &... fs) {
+        *std::get<I>(std::forward_as_tuple(fs...)).val = val;
+        return true;
+      };
+      static_cast<void>(with_record_fields<load_inspector>(xs[i], assign));
+    };
+    return f.template values<value_type>(xs.size(), set);
+  } else {
+    auto load_field = [&f](auto &, auto &... fs) {
+      return std::get<I>(std::forward_as_tuple(fs...))(f);
+    };
+    for (auto &x : xs)
+      if (!with_record_fields<load_inspector>(x, load_field))
+        return false;
+    return true;
+  }
+}
+
+template <class Inspector, class T, class... Fields, size_t... Is>
+bool load_columns(Inspector &f, std::vector<T> &xs,
+                  std::index_sequence<Is...>) {
+  return (load_column<Is, Fields>(f, xs) && ...);
+}
+
+/// Loads a list of records in the columnar layout. Runs the `on_load`
+/// callbacks of all records after loading all columns.
+template <class Inspector, class T>
+bool load_columnar_list(Inspector &f, std::vector<T> &xs) {
+  xs.clear();
+  size_t size = 0;
+  if (!f.begin_sequence(size))
+    return false;
+  if (size == 0)
+    return f.end_sequence();
+  // Rejects sizes that cannot fit into the input before allocating.
+  if (!std::is_empty<T>::value && size > f.remaining()) {
+    f.emplace_error(error_code::end_of_stream);
+    return false;
+  }
+  xs.resize(size);
+  auto load_all = [&f, &xs](auto &callback, auto &... fs) {
+    using callback_type = std::decay_t<decltype(callback)>;
+    if (!load_columns<Inspector, T, std::decay_t<decltype(fs)>...>(
+            f, xs, std::index_sequence_for<decltype(fs)...>{}))
+      return false;
+    if constexpr (!std::is_same<callback_type, no_record_callback>::value) {
+      auto run = [&f](auto &record_callback, auto &...) {
+        return run_record_callback(f, record_callback,
+                                   error_code::load_callback_failed);
+      };
+      for (auto &x : xs)
+        if (!with_record_fields<load_inspector>(x, run))
+          return false;
+    }
+    return true;
+  };
+  return f.begin_presence_bitmap(0) &&
+         with_record_fields<load_inspector>(xs.front(), load_all) &&
+         f.end_presence_bitmap() && f.end_sequence();
+}
+
+/// Skips a list of `T` records in the columnar layout.
+template <class T, class Inspector> bool skip_columnar_list(Inspector &f) {
+  size_t size = 0;
+  if (!f.begin_sequence(size))
+    return false;
+  if (size == 0)
+    return f.end_sequence();
+  auto skip_all = [&f, size](auto &, auto &... fs) {
+    auto skip_column = [&f, size](auto &field) {
+      for (size_t i = 0; i < size; ++i)
+        if (!field.skip(f))
+          return false;
+      return true;
+    };
+    return (skip_column(fs) && ...);
+  };
+  return f.begin_presence_bitmap(0) &&
+         with_record_fields<load_inspector>(inspect_prototype<T>(),
+                                            skip_all) &&
+         f.end_presence_bitmap() && f.end_sequence();
+}
@@ -0,0 +1,63 @@
+#include <array>
+#include <cstring>
+
+#include "crc32c.hpp"
+
+constexpr uint32_t crc32c_polynomial = 0x82F63B78; // reversed 0x1EDC6F41
+
+constexpr std::array<uint32_t, 256> make_crc32c_table() {
+  std::array<uint32_t, 256> result{};
+  for (uint32_t i = 0; i < 256; ++i) {
+    auto crc = i;
+    for (int bit = 0; bit < 8; ++bit)
+      crc = (crc >> 1) ^ ((crc & 1) ? crc32c_polynomial : 0);
+    result[i] = crc;
+  }
+  return result;
+}
+
+constexpr auto crc32c_table = make_crc32c_table();
+
+static uint32_t crc32c_sw(uint32_t state, const std::byte *data, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    auto index = (state ^ static_cast<uint8_t>(data[i])) & 0xFF;
+    state = (state >> 8) ^ crc32c_table[index];
+  }
+  return state;
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+
+__attribute__((target("sse4.2"))) static uint32_t
+crc32c_hw(uint32_t state, const std::byte *data, size_t size) {
+  uint64_t state64 = state;
+  for (; size >= 8; size -= 8, data += 8) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    state64 = __builtin_ia32_crc32di(state64, word);
+  }
+  auto state32 = static_cast<uint32_t>(state64);
+  for (; size > 0; --size, ++data)
+    state32 = __builtin_ia32_crc32qi(state32, static_cast<uint8_t>(*data));
+  return state32;
+}
+
+using crc32c_fn = uint32_t (*)(uint32_t, const std::byte *, size_t);
+
+static crc32c_fn select_crc32c() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2") ? crc32c_hw : crc32c_sw;
+}
+
+void crc32c::update(span<const std::byte> bytes) noexcept {
+  static const auto impl = select_crc32c();
+  state_ = impl(state_, bytes.data(), bytes.size());
+}
+
+#else
+
+void crc32c::update(span<const std::byte> bytes) noexcept {
+  state_ = crc32c_sw(state_, bytes.data(), bytes.size());
+}
+
+#endif
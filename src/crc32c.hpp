@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "span.hpp"
+
+/// Incrementally computes a CRC32C (Castagnoli polynomial) checksum. Uses the
+/// SSE4.2 `crc32` instruction when the CPU supports it and falls back to a
+/// table-driven implementation otherwise.
+class crc32c {
+public:
+  crc32c() noexcept : state_(~uint32_t{0}) {}
+
+  /// Adds `bytes` to the checksum.
+  void update(span<const std::byte> bytes) noexcept;
+
+  /// Returns the checksum of all bytes added so far.
+  uint32_t value() const noexcept { return ~state_; }
+
+  void reset() noexcept { state_ = ~uint32_t{0}; }
+
+  /// Computes the checksum of `bytes` in one go.
+  static uint32_t compute(span<const std::byte> bytes) noexcept {
+    crc32c result;
+    result.update(bytes);
+    return result.value();
+  }
+
+private:
+  uint32_t state_;
+};
@@ -0,0 +1,74 @@
+#include <array>
+#include <cstring>
+#include <utility>
+
+#include "delta_packed.hpp"
+
+// The kernels below have one instantiation per bit width. With a constant
+// width, the shifts and word offsets of each value only depend on its index,
+// so compilers unroll the loops and vectorize them without intrinsics.
+
+template <size_t Width>
+static void pack_kernel(const uint64_t *in, size_t count, uint64_t *out) {
+  if constexpr (Width > 0) {
+    memset(out, 0, delta_packed_words(count, Width) * sizeof(uint64_t));
+    for (size_t i = 0; i < count; ++i) {
+      auto bit = i * Width;
+      auto shift = bit % 64;
+      out[bit / 64] |= in[i] << shift;
+      if (shift + Width > 64)
+        out[bit / 64 + 1] |= in[i] >> (64 - shift);
+    }
+  }
+}
+
+template <size_t Width>
+static void unpack_kernel(const uint64_t *in, size_t count, uint64_t *out) {
+  if constexpr (Width == 0) {
+    memset(out, 0, count * sizeof(uint64_t));
+  } else {
+    constexpr auto mask = Width == 64 ? ~uint64_t{0}
+                                      : (uint64_t{1} << Width) - 1;
+    for (size_t i = 0; i < count; ++i) {
+      auto bit = i * Width;
+      auto shift = bit % 64;
+      auto x = in[bit / 64] >> shift;
+      if (shift + Width > 64)
+        x |= in[bit / 64 + 1] << (64 - shift);
+      out[i] = x & mask;
+    }
+  }
+}
+
+using pack_fn = void (*)(const uint64_t *, size_t, uint64_t *);
+
+template <size_t... Widths>
+constexpr std::array<pack_fn, sizeof...(Widths)>
+make_pack_table(std::index_sequence<Widths...>) {
+  return {{pack_kernel<Widths>...}};
+}
+
+template <size_t... Widths>
+constexpr std::array<pack_fn, sizeof...(Widths)>
+make_unpack_table(std::index_sequence<Widths...>) {
+  return {{unpack_kernel<Widths>...}};
+}
+
+constexpr auto pack_table = make_pack_table(std::make_index_sequence<65>{});
+
+constexpr auto unpack_table =
+    make_unpack_table(std::make_index_sequence<65>{});
+
+size_t delta_bit_width(uint64_t x) noexcept {
+  return x == 0 ? 0 : 64 - static_cast<size_t>(__builtin_clzll(x));
+}
+
+void pack_bits(const uint64_t *in, size_t count, size_t width,
+               uint64_t *out) noexcept {
+  pack_table[width](in, count, out);
+}
+
+void unpack_bits(const uint64_t *in, size_t count, size_t width,
+                 uint64_t *out) noexcept {
+  unpack_table[width](in, count, out);
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "my_error.hpp"
+
+/// Number of values per block of a delta-packed list.
+constexpr size_t delta_block_size = 128;
+
+/// Maximum number of 64-bit words of the residuals of one block.
+constexpr size_t delta_block_words = delta_block_size - 1;
+
+/// Returns the number of bits for storing `x`, i.e., 0 for 0 and 64 for
+/// values with the highest bit set.
+size_t delta_bit_width(uint64_t x) noexcept;
+
+/// Returns the number of 64-bit words for `count` values of `width` bits.
+constexpr size_t delta_packed_words(size_t count, size_t width) noexcept {
+  return (count * width + 63) / 64;
+}
+
+/// Packs the lowest `width` bits of `count` values into `out`, starting at
+/// the lowest bit of `out[0]`. Requires `count < delta_block_size`, `width <=
+/// 64` and space for `delta_packed_words(count, width)` words in `out`.
+void pack_bits(const uint64_t *in, size_t count, size_t width,
+               uint64_t *out) noexcept;
+
+/// Reverses `pack_bits`.
+void unpack_bits(const uint64_t *in, size_t count, size_t width,
+                 uint64_t *out) noexcept;
+
+/// Converts the elements of delta-packed lists to 64-bit integers and back.
+/// Arithmetic on the integers wraps around, so signed values and unsorted
+/// lists survive a round trip as well.
+template <class T, class = void> struct delta_packed_traits;
+
+template <class T>
+struct delta_packed_traits<
+    T, std::enable_if_t<std::is_integral<T>::value &&
+                        !std::is_same<T, bool>::value>> {
+  static uint64_t to_bits(T x) noexcept { return static_cast<uint64_t>(x); }
+
+  static T from_bits(uint64_t x) noexcept { return static_cast<T>(x); }
+};
+
+template <class Rep, class Period>
+struct delta_packed_traits<std::chrono::duration<Rep, Period>> {
+  using value_type = std::chrono::duration<Rep, Period>;
+
+  static_assert(std::is_integral<Rep>::value,
+                "delta-packed durations require an integral representation");
+
+  static uint64_t to_bits(value_type x) noexcept {
+    return static_cast<uint64_t>(x.count());
+  }
+
+  static value_type from_bits(uint64_t x) noexcept {
+    return value_type{static_cast<Rep>(x)};
+  }
+};
+
+template <class Clock, class Duration>
+struct delta_packed_traits<std::chrono::time_point<Clock, Duration>> {
+  using value_type = std::chrono::time_point<Clock, Duration>;
+
+  using duration_traits = delta_packed_traits<Duration>;
+
+  static uint64_t to_bits(value_type x) noexcept {
+    return duration_traits::to_bits(x.time_since_epoch());
+  }
+
+  static value_type from_bits(uint64_t x) noexcept {
+    return value_type{duration_traits::from_bits(x)};
+  }
+};
+
+/// Checks whether `T` is a list that supports `delta_packed` fields.
+template <class T> struct is_delta_packed_list : std::false_type {};
+
+template <class T, class Allocator>
+struct is_delta_packed_list<std::vector<T, Allocator>>
+    : std::bool_constant<std::is_integral<T>::value &&
+                         !std::is_same<T, bool>::value> {};
+
+template <class Rep, class Period, class Allocator>
+struct is_delta_packed_list<
+    std::vector<std::chrono::duration<Rep, Period>, Allocator>>
+    : std::true_type {};
+
+template <class Clock, class Duration, class Allocator>
+struct is_delta_packed_list<
+    std::vector<std::chrono::time_point<Clock, Duration>, Allocator>>
+    : std::true_type {};
+
+template <class Inspector, class = void>
+struct has_bulk_values : std::false_type {};
+
+template <class Inspector>
+struct has_bulk_values<Inspector,
+                       std::void_t<decltype(std::declval<Inspector &>()
+                                                .template values<uint64_t>(
+                                                    size_t{0}, nullptr))>>
+    : std::true_type {};
+
+// -- saving -------------------------------------------------------------------
+
+/// Writes the words of a block, in a single pass if the inspector supports
+/// writing numbers in bulk.
+template <class Inspector>
+bool save_delta_words(Inspector &f, const uint64_t *words, size_t n) {
+  if constexpr (has_bulk_values<Inspector>::value) {
+    return f.template values<uint64_t>(n, [words](size_t i) {
+      return words[i];
+    });
+  } else {
+    for (size_t i = 0; i < n; ++i)
+      if (!f.value(words[i]))
+        return false;
+    return true;
+  }
+}
+
+/// Saves a list of integers, durations or time points as delta-packed
+/// blocks. After the size of the list, each block of up to
+/// `delta_block_size` values stores:
+/// - the number of bits per residual as `uint8_t`;
+/// - the first value of the block as `uint64_t`;
+/// - the smallest difference between two neighbors in the block as
+///   `uint64_t`;
+/// - one residual per remaining value, i.e., the difference to the previous
+///   value minus the smallest difference, bit-packed into `uint64_t` words.
+/// Sorted IDs or timestamps with small gaps need only a few bits per value,
+/// and timestamps with a fixed interval need none.
+template <class Inspector, class T>
+bool save_delta_packed(Inspector &f, const T &xs) {
+  static_assert(is_delta_packed_list<T>::value,
+                "delta_packed requires a std::vector of integers, durations "
+                "or time points");
+  using traits = delta_packed_traits<typename T::value_type>;
+  if (!f.begin_sequence(xs.size()))
+    return false;
+  uint64_t residuals[delta_block_size - 1];
+  uint64_t words[delta_block_words];
+  for (size_t first = 0; first < xs.size(); first += delta_block_size) {
+    auto count = std::min(delta_block_size, xs.size() - first) - 1;
+    auto base = traits::to_bits(xs[first]);
+    auto prev = base;
+    auto step = count > 0 ? std::numeric_limits<uint64_t>::max() : 0;
+    for (size_t i = 0; i < count; ++i) {
+      auto x = traits::to_bits(xs[first + i + 1]);
+      residuals[i] = x - prev;
+      step = std::min(step, residuals[i]);
+      prev = x;
+    }
+    auto bits = uint64_t{0};
+    for (size_t i = 0; i < count; ++i) {
+      residuals[i] -= step;
+      bits |= residuals[i];
+    }
+    auto width = delta_bit_width(bits);
+    auto num_words = delta_packed_words(count, width);
+    pack_bits(residuals, count, width, words);
+    if (!f.value(static_cast<uint8_t>(width)) || !f.value(base) ||
+        !f.value(step) || !save_delta_words(f, words, num_words))
+      return false;
+  }
+  return f.end_sequence();
+}
+
+// -- loading ------------------------------------------------------------------
+
+/// Reads the words of a block, in a single pass if the inspector supports
+/// reading numbers in bulk.
+template <class Inspector>
+bool load_delta_words(Inspector &f, uint64_t *words, size_t n) {
+  if constexpr (has_bulk_values<Inspector>::value) {
+    return f.template values<uint64_t>(n, [words](size_t i, uint64_t x) {
+      words[i] = x;
+    });
+  } else {
+    for (size_t i = 0; i < n; ++i)
+      if (!f.value(words[i]))
+        return false;
+    return true;
+  }
+}
+
+/// Loads a list that `save_delta_packed` wrote. Grows the list block by
+/// block, so a corrupted size cannot allocate more memory than the input
+/// holds.
+template <class Inspector, class T>
+bool load_delta_packed(Inspector &f, T &xs) {
+  static_assert(is_delta_packed_list<T>::value,
+                "delta_packed requires a std::vector of integers, durations "
+                "or time points");
+  using traits = delta_packed_traits<typename T::value_type>;
+  xs.clear();
+  size_t size = 0;
+  if (!f.begin_sequence(size))
+    return false;
+  uint64_t residuals[delta_block_size - 1];
+  uint64_t words[delta_block_words];
+  for (size_t first = 0; first < size; first += delta_block_size) {
+    auto count = std::min(delta_block_size, size - first) - 1;
+    auto width = uint8_t{0};
+    auto base = uint64_t{0};
+    auto step = uint64_t{0};
+    if (!f.value(width) || !f.value(base) || !f.value(step))
+      return false;
+    if (width > 64) {
+      f.emplace_error(error_code::invalid_argument);
+      return false;
+    }
+    if (!load_delta_words(f, words, delta_packed_words(count, width)))
+      return false;
+    unpack_bits(words, count, width, residuals);
+    xs.resize(first + count + 1);
+    auto x = base;
+    xs[first] = traits::from_bits(x);
+    for (size_t i = 0; i < count; ++i) {
+      x += residuals[i] + step;
+      xs[first + i + 1] = traits::from_bits(x);
+    }
+  }
+  return f.end_sequence();
+}
+
+/// Checks whether `Inspector` handles skipping delta-packed lists itself,
+/// e.g., to report the decoded elements instead of the blocks.
+template <class Inspector, class T, class = void>
+struct has_delta_packed_skip : std::false_type {};
+
+template <class Inspector, class T>
+struct has_delta_packed_skip<
+    Inspector, T,
+    std::void_t<decltype(std::declval<Inspector &>()
+                             .template skip_delta_packed<T>())>>
+    : std::true_type {};
+
+/// Skips a delta-packed `T` without decoding it. Reads the header of each
+/// block and skips its words with `f.skip_value`, unless the inspector
+/// provides `f.skip_delta_packed<T>()`.
+template <class T, class Inspector> bool skip_delta_packed(Inspector &f) {
+  static_assert(is_delta_packed_list<T>::value,
+                "delta_packed requires a std::vector of integers, durations "
+                "or time points");
+  if constexpr (has_delta_packed_skip<Inspector, T>::value)
+    return f.template skip_delta_packed<T>();
+  size_t size = 0;
+  if (!f.begin_sequence(size))
+    return false;
+  for (size_t first = 0; first < size; first += delta_block_size) {
+    auto count = std::min(delta_block_size, size - first) - 1;
+    auto width = uint8_t{0};
+    if (!f.value(width) || !f.template skip_value<uint64_t>() ||
+        !f.template skip_value<uint64_t>())
+      return false;
+    if (width > 64) {
+      f.emplace_error(error_code::invalid_argument);
+      return false;
+    }
+    for (size_t i = delta_packed_words(count, width); i > 0; --i)
+      if (!f.template skip_value<uint64_t>())
+        return false;
+  }
+  return f.end_sequence();
+}
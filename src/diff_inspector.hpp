@@ -0,0 +1,359 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "binary_serializer.hpp"
+#include "inspector_access.hpp"
+#include "save_inspector.hpp"
+#include "save_inspector_base.hpp"
+#include "span.hpp"
+#include "type_id.hpp"
+
+/// Checks whether `T` has an `operator==`.
+template <class T, class = void>
+struct is_equality_comparable : std::false_type {};
+
+template <class T>
+struct is_equality_comparable<
+    T, std::void_t<decltype(std::declval<const T &>() ==
+                            std::declval<const T &>())>> : std::true_type {};
+
+/// Walks the DSL of an `inspect` overload and passes the fields of the
+/// object to a callback instead of saving them.
+template <class Callback> class field_collector final : public save_inspector {
+public:
+  static constexpr bool has_human_readable_format() noexcept { return false; }
+
+  explicit field_collector(Callback &callback) noexcept
+      : callback_(callback) {}
+
+  struct object_t {
+    Callback *callback;
+
+    template <class... Fields> bool fields(Fields &&... fs) {
+      return (*callback)(fs...);
+    }
+
+    object_t &&pretty_name(std::string_view) && { return std::move(*this); }
+
+    template <class F> object_t &&on_save(F &&) && { return std::move(*this); }
+
+    template <class F> object_t &&on_load(F &&) && { return std::move(*this); }
+  };
+
+  template <class T> object_t object(T &) noexcept {
+    return object_t{std::addressof(callback_)};
+  }
+
+private:
+  Callback &callback_;
+};
+
+/// Writes a patch that turns one instance of `T` into another. The patch of
+/// an object starts with a bitmap of the changed fields, stored as varbyte
+/// encoded `mask + 1` that always has the size of the largest mask of the
+/// object, followed by the new values of the changed fields in
+/// the format of `binary_serializer`. Fields that are objects store a patch
+/// of their own and lists that keep their size store the positions and
+/// patches of the changed elements. All other values get replaced as a
+/// whole, with a 0 in place of the bitmap for each object in the value.
+/// Hence, the size of a patch depends on the size of the change rather than
+/// the size of the object.
+/// `patch_loader` applies patches.
+class diff_inspector final : public save_inspector_base<diff_inspector> {
+public:
+  explicit diff_inspector(byte_buffer &buf)
+      : buf_(buf), sink_(buf), old_(nullptr), changed_(false) {}
+
+  static constexpr bool has_human_readable_format() noexcept { return false; }
+
+  /// Appends the patch from `old_value` to `new_value`, where `T` is an
+  /// object with an `inspect` overload.
+  template <class T> bool diff(const T &old_value, const T &new_value) {
+    old_ = std::addressof(old_value);
+    return apply(new_value);
+  }
+
+  /// Returns whether the last call to `diff` found any difference.
+  bool changed() const noexcept { return changed_; }
+
+  // -- DSL --------------------------------------------------------------------
+
+  template <class T, class SaveCallback> struct object_t {
+    diff_inspector *f;
+    T *x;
+    SaveCallback save_callback;
+
+    template <class... Fields> bool fields(Fields &&... fs) {
+      return f->object_fields(*x, std::index_sequence_for<Fields...>{},
+                              fs...) &&
+             f->run_callback(save_callback);
+    }
+
+    object_t &&pretty_name(std::string_view) && { return std::move(*this); }
+
+    template <class F> object_t &&on_load(F &&) && { return std::move(*this); }
+
+    template <class F> auto on_save(F fun) && {
+      return object_t<T, F>{f, x, std::move(fun)};
+    }
+  };
+
+  template <class T> auto object(T &x) noexcept {
+    auto no_callback = [] { return true; };
+    return object_t<T, decltype(no_callback)>{this, std::addressof(x),
+                                              no_callback};
+  }
+
+  // -- inspector interface ----------------------------------------------------
+
+  bool begin_field(std::string_view name) { return sink_.begin_field(name); }
+
+  bool begin_field(std::string_view name, bool is_present) {
+    return sink_.begin_field(name, is_present);
+  }
+
+  bool begin_field(std::string_view name, span<const type_id_t> types,
+                   size_t index) {
+    return sink_.begin_field(name, types, index);
+  }
+
+  bool begin_field(std::string_view name, bool is_present,
+                   span<const type_id_t> types, size_t index) {
+    return sink_.begin_field(name, is_present, types, index);
+  }
+
+  bool end_field() { return sink_.end_field(); }
+
+  bool begin_tuple(size_t size) { return sink_.begin_tuple(size); }
+
+  bool end_tuple() { return sink_.end_tuple(); }
+
+  bool begin_key_value_pair() { return sink_.begin_key_value_pair(); }
+
+  bool end_key_value_pair() { return sink_.end_key_value_pair(); }
+
+  bool begin_sequence(size_t size) { return sink_.begin_sequence(size); }
+
+  bool end_sequence() { return sink_.end_sequence(); }
+
+  bool begin_associative_array(size_t size) {
+    return sink_.begin_associative_array(size);
+  }
+
+  bool end_associative_array() { return sink_.end_associative_array(); }
+
+  template <class T> bool value(const T &x) { return sink_.value(x); }
+
+private:
+  template <class F> bool run_callback(F &callback) {
+    using result_type = decltype(callback());
+    if constexpr (std::is_same<result_type, bool>::value) {
+      if (!callback()) {
+        set_error(error_code::save_callback_failed);
+        return false;
+      }
+    } else {
+      if (auto err = callback()) {
+        set_error(std::move(err));
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <class T, class... Fields, size_t... Is>
+  bool object_fields(T &, std::index_sequence<Is...>, Fields &... fs) {
+    auto old = static_cast<const T *>(std::exchange(old_, nullptr));
+    if (old == nullptr) {
+      // Saves all fields of new objects.
+      changed_ = true;
+      return sink_.value(uint8_t{0}) && (fs(*this) && ...);
+    }
+    // Reserves the bitmap with its final size, so writing it moves no bytes.
+    constexpr auto mask_size = patch_mask_size(sizeof...(Fields));
+    auto pos = buf_.size();
+    sink_.skip(mask_size);
+    auto mask = uint64_t{0};
+    auto news = std::forward_as_tuple(fs...);
+    auto diff_all = [&](auto &... old_fields) {
+      static_assert(sizeof...(old_fields) == sizeof...(Fields));
+      return (diff_field<Is>(mask, std::get<Is>(news), old_fields) && ...);
+    };
+    field_collector<decltype(diff_all)> collector{diff_all};
+    if (!inspect(collector, as_mutable_ref(*old)))
+      return false;
+    write_mask(pos, mask, mask_size);
+    changed_ = mask != 0;
+    return true;
+  }
+
+  template <size_t I, class NewField, class OldField>
+  bool diff_field(uint64_t &mask, NewField &x, OldField &y) {
+    constexpr auto always = I >= patch_mask_bits;
+    if constexpr (is_plain_field<NewField>::value) {
+      using value_type = typename is_plain_field<NewField>::value_type;
+      using access_type =
+          decltype(inspect_access_type<diff_inspector, value_type>());
+      if constexpr (std::is_same<access_type,
+                                 inspector_access_type::inspect>::value) {
+        auto pos = buf_.size();
+        old_ = y.val;
+        if (!x(*this))
+          return false;
+        return keep_if_changed<I>(mask, pos, always);
+      } else if constexpr (is_patchable_list<diff_inspector, value_type>()) {
+        auto pos = buf_.size();
+        if (!diff_list(*x.val, *y.val))
+          return false;
+        return keep_if_changed<I>(mask, pos, always);
+      } else {
+        if (!always && equal(*x.val, *y.val))
+          return true;
+        mask |= field_bit<I>();
+        return x(*this);
+      }
+    } else {
+      // Virtual fields and fields with a fallback.
+      if (!always && same_encoding(x, y))
+        return true;
+      mask |= field_bit<I>();
+      return x(*this);
+    }
+  }
+
+  template <class T> bool diff_list(const T &xs, const T &ys) {
+    using value_type = typename T::value_type;
+    using access_type =
+        decltype(inspect_access_type<diff_inspector, value_type>());
+    constexpr auto is_object =
+        std::is_same<access_type, inspector_access_type::inspect>::value;
+    if (!begin_sequence(xs.size()))
+      return false;
+    if (xs.size() != ys.size()) {
+      changed_ = true;
+      return list_elements(xs) && end_sequence();
+    }
+    // Each changed element follows the number of unchanged elements before
+    // it plus one. A 0 terminates the list.
+    auto changed = false;
+    auto y = ys.begin();
+    size_t gap = 0;
+    for (auto &&x : xs) {
+      auto pos = buf_.size();
+      if (!sink_.begin_sequence(gap + 1))
+        return false;
+      if constexpr (is_object) {
+        old_ = std::addressof(*y);
+        if (!save(*this, x))
+          return false;
+      } else {
+        // Binds the elements of lists such as `std::vector<bool>` as well.
+        const value_type &x_ref = x;
+        const value_type &y_ref = *y;
+        changed_ = !equal(x_ref, y_ref);
+        if (changed_ && !save(*this, x_ref))
+          return false;
+      }
+      if (changed_) {
+        changed = true;
+        gap = 0;
+      } else {
+        truncate(pos);
+        ++gap;
+      }
+      ++y;
+    }
+    changed_ = changed;
+    return sink_.begin_sequence(0) && end_sequence();
+  }
+
+  template <class T> bool list_elements(const T &xs) {
+    using value_type = typename T::value_type;
+    for (auto &&x : xs) {
+      const value_type &x_ref = x;
+      if (!save(*this, x_ref))
+        return false;
+    }
+    return true;
+  }
+
+  template <size_t I>
+  bool keep_if_changed(uint64_t &mask, size_t pos, bool always) {
+    if (changed_ || always)
+      mask |= field_bit<I>();
+    else
+      truncate(pos);
+    return true;
+  }
+
+  template <size_t I> static constexpr uint64_t field_bit() noexcept {
+    if constexpr (I < patch_mask_bits)
+      return uint64_t{1} << I;
+    else
+      return 0;
+  }
+
+  template <class T> bool equal(const T &x, const T &y) {
+    if constexpr (is_equality_comparable<T>::value) {
+      return x == y;
+    } else {
+      auto f = [&x](auto &sink) { return sink.apply(x); };
+      auto g = [&y](auto &sink) { return sink.apply(y); };
+      return same_encoding(f, g);
+    }
+  }
+
+  /// Compares the encodings that `f` and `g` produce for a
+  /// `binary_serializer`.
+  template <class F, class G> bool same_encoding(F &f, G &g) {
+    scratch_[0].clear();
+    scratch_[1].clear();
+    binary_serializer sink0{scratch_[0]};
+    binary_serializer sink1{scratch_[1]};
+    return f(sink0) && g(sink1) && scratch_[0] == scratch_[1];
+  }
+
+  void truncate(size_t pos) {
+    buf_.resize(pos);
+    sink_.seek(pos);
+  }
+
+  /// Writes the varbyte encoding of `mask + 1` with exactly `size` bytes to
+  /// `pos`, padding it with continuation bytes.
+  void write_mask(size_t pos, uint64_t mask, size_t size) {
+    auto x = mask + 1;
+    for (size_t i = 0; i + 1 < size; ++i) {
+      buf_[pos + i] = static_cast<std::byte>((x & 0x7F) | 0x80);
+      x >>= 7;
+    }
+    buf_[pos + size - 1] = static_cast<std::byte>(x);
+  }
+
+  template <class Field> struct is_plain_field : std::false_type {};
+
+  template <class T>
+  struct is_plain_field<save_inspector::field_t<T>> : std::true_type {
+    using value_type = T;
+  };
+
+  /// Returns the size of the varbyte encoding of `mask + 1` for the largest
+  /// mask of an object with `num_fields` fields.
+  static constexpr size_t patch_mask_size(size_t num_fields) noexcept {
+    auto bits = std::min(num_fields, patch_mask_bits) + 1;
+    return (bits + 6) / 7;
+  }
+
+  byte_buffer &buf_;
+  binary_serializer sink_;
+  const void *old_; // previous version of the next object, if any
+  bool changed_;    // whether the last object or list had any changes
+  byte_buffer scratch_[2];
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+
+/// Position of a fixed-size field in the encoding of an object.
+struct field_location {
+  /// Offset of the field relative to the start of the object.
+  size_t offset = 0;
+
+  /// Size of the encoding of the field.
+  size_t size = 0;
+
+  /// Whether all fields before this field have a fixed size, i.e., whether
+  /// `offset` is the same for all encodings of the object with the same
+  /// settings. Callers may reuse such locations for other buffers.
+  bool fixed = false;
+};
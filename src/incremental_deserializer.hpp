@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include "binary_deserializer.hpp"
+#include "binary_serializer.hpp"
+#include "my_error.hpp"
+#include "network_order.hpp"
+#include "resumable_loader.hpp"
+#include "span.hpp"
+#include "type_def.h"
+#include "type_id.hpp"
+
+/// Result of feeding input to an `incremental_deserializer`.
+enum class decode_status {
+  /// The input ends before the current message is complete.
+  need_more,
+  /// A message has been decoded and is available via `value()`.
+  done,
+  /// The input is malformed. The error is available via `get_error()`.
+  failed,
+};
+
+/// Default limit for the size of a message in `incremental_deserializer`.
+constexpr size_t default_max_message_size = 64 * 1024 * 1024;
+
+/// Push-based decoder for messages that arrive in pieces, e.g., from
+/// consecutive TCP reads. `feed` decodes as much of the current message as
+/// the input allows and keeps the partially decoded message for the next
+/// piece, so decoding overlaps with receiving. Only the bytes of values that
+/// `resumable_loader` loads as a whole, e.g., a string that the input cuts
+/// in half, stay buffered between the pieces. Input following a decoded
+/// message is kept for the next one.
+///
+/// Supports the default encoding and the typed stream mode. Messages larger
+/// than the limit fail, including messages whose typed stream header
+/// announces a larger size.
+template <class T> class incremental_deserializer {
+public:
+  /// Function for configuring the deserializer, e.g., to enable typed
+  /// streams.
+  using configure_fn = std::function<void(binary_deserializer &)>;
+
+  explicit incremental_deserializer(
+      configure_fn configure = nullptr,
+      size_t max_size = default_max_message_size)
+      : pos_(0), max_size_(max_size), framed_(false), started_(false),
+        bound_(0), err_(0) {
+    binary_deserializer settings;
+    if (configure)
+      configure(settings);
+    if (settings.presence_bitmaps() || settings.nested_object_lengths() ||
+        settings.indexed_maps() || settings.columnar_lists() ||
+        settings.field_mask() != binary_deserializer::all_fields) {
+      err_ = error_code::unsupported_operation;
+      return;
+    }
+    // The typed stream mode only adds a header to top-level objects.
+    using access_type = decltype(inspect_access_type<resumable_loader, T>());
+    framed_ =
+        settings.typed_stream() &&
+        (std::is_same<access_type, inspector_access_type::inspect>::value ||
+         std::is_same<access_type, inspector_access_type::empty>::value);
+  }
+
+  DISABLE_COPY(incremental_deserializer)
+
+  /// Appends `bytes` to the input and continues decoding the current
+  /// message. Passing an empty span only checks whether the already buffered
+  /// input contains another message.
+  decode_status feed(span<const std::byte> bytes) {
+    if (err_ != error_code::success)
+      return decode_status::failed;
+    // A suspended walk only continues with new input.
+    if (started_ && bytes.empty())
+      return decode_status::need_more;
+    // Drops consumed bytes once they make up half of the buffer, which keeps
+    // the cost of moving the rest linear in the size of the input.
+    if (pos_ > 0 && pos_ * 2 >= buf_.size()) {
+      buf_.erase(buf_.begin(), buf_.begin() + static_cast<ptrdiff_t>(pos_));
+      pos_ = 0;
+    }
+    buf_.insert(buf_.end(), bytes.begin(), bytes.end());
+    if (buffered() == 0)
+      return decode_status::need_more;
+    if (!started_) {
+      if (framed_) {
+        if (buffered() < header_size)
+          return decode_status::need_more;
+        if (!read_header())
+          return decode_status::failed;
+      } else {
+        bound_ = max_size_;
+      }
+      loader_.start(bound_);
+      started_ = true;
+    }
+    auto left = bound_ - loader_.offset();
+    auto size = std::min(buffered(), left);
+    auto input = make_span(buf_.data() + pos_, size);
+    auto last = size == left;
+    auto done = loader_.resume(value_, input, last);
+    pos_ += loader_.consumed();
+    if (done) {
+      started_ = false;
+      if (framed_ && loader_.offset() != bound_)
+        return failed(error_code::invalid_argument);
+      return decode_status::done;
+    }
+    if (loader_.suspended())
+      return decode_status::need_more;
+    // Running out of space before the end of the message exceeds the limit.
+    if (!framed_ && last)
+      return failed(error_code::invalid_argument);
+    return failed(loader_.get_error());
+  }
+
+  /// Returns the most recently decoded message. Between the pieces of a
+  /// message, returns the partially decoded message.
+  T &value() noexcept { return value_; }
+
+  /// Returns the number of bytes waiting for the next decode attempt.
+  size_t buffered() const noexcept { return buf_.size() - pos_; }
+
+  const error &get_error() const noexcept { return err_; }
+
+private:
+  /// Size of the type and the size of a message in the typed stream mode.
+  static constexpr size_t header_size = sizeof(type_id_t) + sizeof(uint32_t);
+
+  /// Reads the type and size of a message in the typed stream mode.
+  bool read_header() {
+    auto type = type_id_t{0};
+    auto size = uint32_t{0};
+    memcpy(&type, buf_.data() + pos_, sizeof(type));
+    memcpy(&size, buf_.data() + pos_ + sizeof(type), sizeof(size));
+    if (from_network_order(type) != type_id_or_invalid<T>()) {
+      failed(error_code::invalid_field_type);
+      return false;
+    }
+    bound_ = from_network_order(size);
+    if (bound_ > max_size_) {
+      failed(error_code::invalid_argument);
+      return false;
+    }
+    pos_ += header_size;
+    return true;
+  }
+
+  decode_status failed(error err) {
+    err_ = err;
+    if (err_ == error_code::success)
+      err_ = error_code::runtime_error;
+    return decode_status::failed;
+  }
+
+  resumable_loader loader_;
+  byte_buffer buf_;
+  size_t pos_;       // first byte in `buf_` that the loader has not consumed
+  size_t max_size_;  // limit for the size of a message
+  bool framed_;      // whether messages start with a typed stream header
+  bool started_;     // whether the loader holds a partially decoded message
+  size_t bound_;     // size of the current message or the limit
+  T value_;
+  error err_;
+};
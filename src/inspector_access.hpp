@@ -3,6 +3,8 @@
 #include <cassert>
 #include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <memory>
 #include <optional>
 #include <string_view>
@@ -26,8 +28,6 @@ struct always_true_t {
 
 constexpr auto always_true = always_true_t{};
 
-template <class> constexpr bool assertion_failed_v = false;
-
 // Converts a setter that returns void, error or bool to a sync function object
 // taking no arguments that always returns a bool.
 // inspector has a function called set error, and set a is function
@@ -282,7 +282,7 @@ template <class T> struct optional_inspector_access {
                          container_type &x) {
     auto is_present = [&x] { return static_cast<bool>(x); };
     auto get = [&x]() -> decltype(auto) { return traits::deref_save(x); };
-    return save_field(f, field_name, is_present, get);
+    return ::save_field(f, field_name, is_present, get);
   }
 
   template <class Inspector, class IsPresent, class Get>
@@ -297,8 +297,8 @@ template <class T> struct optional_inspector_access {
                          SyncValue &sync_value) {
     traits::emplace(x);
     auto reset = [&x] { x.reset(); };
-    return load_field(f, field_name, traits::deref_load(x), is_valid,
-                      sync_value, reset);
+    return ::load_field(f, field_name, traits::deref_load(x), is_valid,
+                        sync_value, reset);
   }
 
   template <class Inspector, class IsValid, class SyncValue, class SetFallback>
@@ -306,8 +306,8 @@ template <class T> struct optional_inspector_access {
                          container_type &x, IsValid &is_valid,
                          SyncValue &sync_value, SetFallback &set_fallback) {
     traits::emplace(x);
-    return load_field(f, field_name, traits::deref_load(x), is_valid,
-                      sync_value, set_fallback);
+    return ::load_field(f, field_name, traits::deref_load(x), is_valid,
+                        sync_value, set_fallback);
   }
 };
 
@@ -329,6 +329,172 @@ struct optional_inspector_traits<std::optional<T>>
   }
 };
 
+// -- skipping values without loading them ------------------------------------
+
+/// Checks whether `inspector_access<T>` provides a static `skip(f)` that
+/// skips the encoding of a `T` with `f.skip_value` instead of loading it into
+/// a temporary.
+template <class Inspector, class T, class = void>
+struct has_access_skip : std::false_type {};
+
+template <class Inspector, class T>
+struct has_access_skip<Inspector, T,
+                       std::void_t<decltype(inspector_access<T>::skip(
+                           std::declval<Inspector &>()))>> : std::true_type {};
+
+// -- inspection support for std::shared_ptr<T> and std::unique_ptr<T> --------
+
+/// Returns a unique address for each type.
+template <class T> const void *type_tag() noexcept {
+  static constexpr char tag = 0;
+  return &tag;
+}
+
+template <class Inspector, class = void>
+struct has_shared_objects : std::false_type {};
+
+template <class Inspector>
+struct has_shared_objects<
+    Inspector,
+    std::void_t<decltype(std::declval<Inspector &>().clear_shared_objects())>>
+    : std::true_type {};
+
+/// Encodes pointers as a sequence with the tag `null_pointer_tag` and no
+/// elements, with the tag `new_pointer_tag` and the value or, for shared
+/// objects that the same top-level object already contains, with the distance
+/// in bytes to the first pointer to the object plus 1 and no elements.
+/// Readers that skip nested objects by their length cannot resolve
+/// back-references to pointers in them.
+/// Loading a back-reference restores the sharing. Inspectors that do not
+/// track shared objects write a copy of the value for each pointer and reject
+/// back-references. Pointers to a base class only save the base class.
+constexpr size_t null_pointer_tag = 0;
+
+constexpr size_t new_pointer_tag = 1;
+
+template <class T>
+struct inspector_access<std::shared_ptr<T>>
+    : inspector_access_base<std::shared_ptr<T>> {
+  using value_type = std::remove_const_t<T>;
+
+  template <class Inspector>
+  static bool apply(Inspector &f, std::shared_ptr<T> &x) {
+    if constexpr (Inspector::is_loading)
+      return load_pointer(f, x);
+    else
+      return save_pointer(f, x);
+  }
+
+  /// Skips a pointer. Accepts back-references without checking their target,
+  /// since that requires tracking the positions of all skipped pointers.
+  template <class Inspector> static bool skip(Inspector &f) {
+    size_t tag = 0;
+    if (!f.begin_sequence(tag))
+      return false;
+    if (tag == new_pointer_tag && !f.template skip_value<value_type>())
+      return false;
+    return f.end_sequence();
+  }
+
+private:
+  template <class Inspector>
+  static bool load_pointer(Inspector &f, std::shared_ptr<T> &x) {
+    // Identifies the position of the pointer by the number of bytes after it,
+    // which works for contiguous and segmented input alike.
+    size_t pos = 0;
+    if constexpr (has_shared_objects<Inspector>::value)
+      pos = f.remaining();
+    size_t tag = 0;
+    if (!f.begin_sequence(tag))
+      return false;
+    if (tag == null_pointer_tag) {
+      x.reset();
+      return f.end_sequence();
+    }
+    if (tag == new_pointer_tag) {
+      auto ptr = std::make_shared<value_type>();
+      // Registers the object first to restore cycles.
+      if constexpr (has_shared_objects<Inspector>::value)
+        f.add_shared_object(pos, type_tag<value_type>(), ptr);
+      if (!f.apply(*ptr))
+        return false;
+      x = std::move(ptr);
+      return f.end_sequence();
+    }
+    if constexpr (has_shared_objects<Inspector>::value) {
+      if (auto ptr = f.shared_object(pos, tag - 1, type_tag<value_type>())) {
+        x = std::static_pointer_cast<value_type>(std::move(ptr));
+        return f.end_sequence();
+      }
+    }
+    f.emplace_error(error_code::invalid_argument, "invalid back-reference");
+    return false;
+  }
+
+  template <class Inspector>
+  static bool save_pointer(Inspector &f, std::shared_ptr<T> &x) {
+    if (!x)
+      return f.begin_sequence(null_pointer_tag) && f.end_sequence();
+    if constexpr (has_shared_objects<Inspector>::value) {
+      auto distance =
+          f.add_shared_object(f.write_pos(), type_tag<value_type>(), x);
+      if (distance > 0)
+        return f.begin_sequence(distance + 1) && f.end_sequence();
+    }
+    return f.begin_sequence(new_pointer_tag) && f.apply(*x) &&
+           f.end_sequence();
+  }
+};
+
+template <class T>
+struct inspector_access<std::unique_ptr<T>>
+    : inspector_access_base<std::unique_ptr<T>> {
+  using value_type = std::remove_const_t<T>;
+
+  template <class Inspector>
+  static bool apply(Inspector &f, std::unique_ptr<T> &x) {
+    // Unique pointers never share their object, so they never use
+    // back-references.
+    if constexpr (Inspector::is_loading) {
+      size_t tag = 0;
+      if (!f.begin_sequence(tag))
+        return false;
+      if (tag == null_pointer_tag) {
+        x.reset();
+        return f.end_sequence();
+      }
+      if (tag != new_pointer_tag) {
+        f.emplace_error(error_code::invalid_argument, "invalid back-reference");
+        return false;
+      }
+      auto ptr = std::make_unique<value_type>();
+      if (!f.apply(*ptr))
+        return false;
+      x = std::move(ptr);
+      return f.end_sequence();
+    } else {
+      if (!x)
+        return f.begin_sequence(null_pointer_tag) && f.end_sequence();
+      return f.begin_sequence(new_pointer_tag) && f.apply(*x) &&
+             f.end_sequence();
+    }
+  }
+
+  template <class Inspector> static bool skip(Inspector &f) {
+    size_t tag = 0;
+    if (!f.begin_sequence(tag))
+      return false;
+    if (tag == new_pointer_tag) {
+      if (!f.template skip_value<value_type>())
+        return false;
+    } else if (tag != null_pointer_tag) {
+      f.emplace_error(error_code::invalid_argument, "invalid back-reference");
+      return false;
+    }
+    return f.end_sequence();
+  }
+};
+
 // -- inspection support for std::byte -----------------------------------------
 
 template <>
@@ -346,6 +512,17 @@ struct inspector_access<std::byte> : inspector_access_base<std::byte> {
 
 template <class T> struct variant_inspector_traits;
 
+/// Checks whether `Inspector` loads every alternative of a variant field, as
+/// opposed to only the one at the index it reads, by providing a static
+/// `visits_all_alternatives()` that returns `true`.
+template <class Inspector, class = void>
+struct visits_all_alternatives : std::false_type {};
+
+template <class Inspector>
+struct visits_all_alternatives<
+    Inspector, std::enable_if_t<Inspector::visits_all_alternatives()>>
+    : std::true_type {};
+
 template <class T> struct variant_inspector_access {
   using value_type = T;
 
@@ -384,14 +561,23 @@ template <class T> struct variant_inspector_access {
 
   template <class Inspector>
   static bool load_variant_value(Inspector &f, std::string_view field_name,
-                                 value_type &x, type_id_t runtime_type) {
+                                 value_type &x, size_t type_index) {
+    if constexpr (visits_all_alternatives<Inspector>::value) {
+      // Loads all other alternatives first, so `x` ends up holding the one
+      // at `type_index`.
+      for (size_t i = 0; i < std::size(traits::allowed_types); ++i)
+        if (i != type_index && !load_one_alternative(f, field_name, x, i))
+          return false;
+    }
+    return load_one_alternative(f, field_name, x, type_index);
+  }
+
+  template <class Inspector>
+  static bool load_one_alternative(Inspector &f, std::string_view field_name,
+                                   value_type &x, size_t type_index) {
     auto res = false;
-    auto type_found = traits::load(runtime_type, [&](auto &tmp) {
-      if (!load(f, tmp))
-        return;
-      traits::assign(x, std::move(tmp));
-      res = true;
-      return;
+    auto type_found = traits::load(type_index, x, [&](auto &y) {
+      res = load(f, y);
     });
     if (!type_found)
       f.emplace_error(error_code::invalid_field_type, std::string{field_name});
@@ -410,8 +596,7 @@ template <class T> struct variant_inspector_access {
       f.emplace_error(error_code::invalid_field_type, std::string{field_name});
       return false;
     }
-    auto runtime_type = allowed_types[type_index];
-    if (!load_variant_value(f, field_name, x, runtime_type))
+    if (!load_variant_value(f, field_name, x, type_index))
       return false;
     if (!is_valid(x)) {
       f.emplace_error(error_code::field_invariant_check_failed,
@@ -442,8 +627,7 @@ template <class T> struct variant_inspector_access {
                         std::string{field_name});
         return false;
       }
-      auto runtime_type = allowed_types[type_index];
-      if (!load_variant_value(f, field_name, x, runtime_type))
+      if (!load_variant_value(f, field_name, x, type_index))
         return false;
       if (!is_valid(x)) {
         f.emplace_error(error_code::field_invariant_check_failed,
@@ -482,22 +666,41 @@ template <class... Ts> struct variant_inspector_traits<std::variant<Ts...>> {
     x = std::forward<U>(value);
   }
 
-  template <class F> static bool load(type_id_t, F &, type_list<>) {
-    return false;
+  template <size_t I, class F>
+  static void load_alternative(value_type &x, F &continuation) {
+    continuation(x.template emplace<I>());
   }
 
-  template <class F, class U, class... Us>
-  static bool load(type_id_t type, F &continuation, type_list<U, Us...>) {
-    if (type_id_v<U> == type) {
-      auto tmp = U{};
-      continuation(tmp);
-      return true;
-    }
-    return load(type, continuation, type_list<Us...>{});
+  template <class F, size_t... Is>
+  static bool load(size_t index, value_type &x, F &continuation,
+                   std::index_sequence<Is...>) {
+    using loader = void (*)(value_type &, F &);
+    static constexpr loader table[] = {&load_alternative<Is, F>...};
+    if (index >= sizeof...(Ts))
+      return false;
+    table[index](x, continuation);
+    return true;
+  }
+
+  /// Default-constructs the alternative at `index` in place and passes it to
+  /// `continuation`. Dispatches via a table indexed by `index` instead of
+  /// comparing type IDs. Returns `false` if `index` is out of range.
+  template <class F>
+  static bool load(size_t index, value_type &x, F continuation) {
+    return load(index, x, continuation, std::index_sequence_for<Ts...>{});
+  }
+
+  template <class Inspector, class U>
+  static bool skip_alternative(Inspector &f) {
+    return f.template skip_value<U>();
   }
 
-  template <class F> static bool load(type_id_t type, F continuation) {
-    return load(type, continuation, type_list<Ts...>{});
+  /// Skips the alternative at `index` with `f.skip_value`. Returns `false` if
+  /// `index` is out of range or skipping fails.
+  template <class Inspector> static bool skip(Inspector &f, size_t index) {
+    using skipper = bool (*)(Inspector &);
+    static constexpr skipper table[] = {&skip_alternative<Inspector, Ts>...};
+    return index < sizeof...(Ts) && table[index](f);
   }
 };
 
@@ -507,6 +710,172 @@ struct inspector_access<std::variant<Ts...>>
   // nop
 };
 
+// -- presence flags of object fields -----------------------------------------
+
+/// Returns how many flags a field of type `T` passes to `begin_field(name,
+/// bool)`. Optional values pass one, unless they hold a variant, which encodes
+/// absence in its type index.
+template <class T> constexpr size_t optional_field_presence_flags() {
+  return is_complete<variant_inspector_traits<T>> ? 0 : 1;
+}
+
+/// Returns how many flags a mandatory field of type `T` passes to
+/// `begin_field(name, bool)`.
+template <class T> constexpr size_t field_presence_flags() {
+  if constexpr (is_complete<optional_inspector_traits<T>>)
+    return optional_field_presence_flags<
+        typename optional_inspector_traits<T>::value_type>();
+  else
+    return 0;
+}
+
+template <class Inspector, class = void>
+struct has_presence_bitmap : std::false_type {};
+
+template <class Inspector>
+struct has_presence_bitmap<Inspector,
+                           std::void_t<decltype(std::declval<Inspector &>()
+                                                    .begin_presence_bitmap(
+                                                        size_t{0}))>>
+    : std::true_type {};
+
+/// Starts an object with the given fields. Announces the number of presence
+/// flags of all fields to inspectors that pack them into a bitmap.
+template <class... Fields, class Inspector>
+bool begin_object_fields(Inspector &f, type_id_t type, std::string_view name) {
+  if constexpr (has_presence_bitmap<Inspector>::value)
+    return f.begin_object(type, name) &&
+           f.begin_presence_bitmap(
+               (size_t{0} + ... + std::decay_t<Fields>::presence_flags));
+  else
+    return f.begin_object(type, name);
+}
+
+template <class Inspector> bool end_object_fields(Inspector &f) {
+  if constexpr (has_presence_bitmap<Inspector>::value)
+    return f.end_presence_bitmap() && f.end_object();
+  else
+    return f.end_object();
+}
+
+// -- skipping of object fields -----------------------------------------------
+
+template <class Inspector, class = void>
+struct has_field_projection : std::false_type {};
+
+template <class Inspector>
+struct has_field_projection<
+    Inspector,
+    std::void_t<decltype(std::declval<Inspector &>().selected_fields())>>
+    : std::true_type {};
+
+/// Returns a shared instance of `T` for walking its `inspect` overload with
+/// an inspector that skips all fields. The instance never changes.
+template <class T> T &inspect_prototype() {
+  static T instance{};
+  return instance;
+}
+
+/// Returns whether `f` loads any field of the current object.
+template <class Inspector> bool loads_fields(Inspector &f) {
+  if constexpr (has_field_projection<Inspector>::value)
+    return f.selected_fields() != 0;
+  else
+    return true;
+}
+
+/// Skips the value of a variant field after reading its type index.
+template <class T, class Inspector>
+bool skip_variant_value(Inspector &f, std::string_view field_name,
+                        size_t type_index) {
+  using traits = variant_inspector_traits<T>;
+  if (type_index >= std::size(traits::allowed_types)) {
+    f.emplace_error(error_code::invalid_field_type, std::string{field_name});
+    return false;
+  }
+  return traits::skip(f, type_index);
+}
+
+/// Skips an optional field of type `T` without loading its value.
+template <class T, class Inspector>
+bool skip_optional_field(Inspector &f, std::string_view field_name) {
+  bool is_present = false;
+  if constexpr (is_complete<variant_inspector_traits<T>>) {
+    auto allowed_types = make_span(variant_inspector_traits<T>::allowed_types);
+    size_t type_index = std::numeric_limits<size_t>::max();
+    return f.begin_field(field_name, is_present, allowed_types, type_index) &&
+           (!is_present ||
+            skip_variant_value<T>(f, field_name, type_index)) &&
+           f.end_field();
+  } else {
+    return f.begin_field(field_name, is_present) &&
+           (!is_present || f.template skip_value<T>()) && f.end_field();
+  }
+}
+
+/// Skips a field of type `T` without loading its value.
+template <class T, class Inspector>
+bool skip_field(Inspector &f, std::string_view field_name) {
+  if constexpr (is_complete<optional_inspector_traits<T>>) {
+    using value_type = typename optional_inspector_traits<T>::value_type;
+    return skip_optional_field<value_type>(f, field_name);
+  } else if constexpr (is_complete<variant_inspector_traits<T>>) {
+    auto allowed_types = make_span(variant_inspector_traits<T>::allowed_types);
+    size_t type_index = std::numeric_limits<size_t>::max();
+    return f.begin_field(field_name, allowed_types, type_index) &&
+           skip_variant_value<T>(f, field_name, type_index) && f.end_field();
+  } else {
+    return f.begin_field(field_name) && f.template skip_value<T>() &&
+           f.end_field();
+  }
+}
+
+template <size_t I> constexpr bool is_selected_field(uint64_t mask) noexcept {
+  if constexpr (I < 64)
+    return ((mask >> I) & 1) != 0;
+  else
+    return true;
+}
+
+template <class Inspector, class... Fields, size_t... Is>
+bool load_object_fields(Inspector &f, std::index_sequence<Is...>,
+                        Fields &... fs) {
+  // Reading the mask once keeps it in a register while loading the fields.
+  auto mask = f.selected_fields();
+  if (mask == ~uint64_t{0})
+    return (fs(f) && ...);
+  return ((is_selected_field<Is>(mask) ? fs(f) : fs.skip(f)) && ...);
+}
+
+/// Loads the fields of an object in order. Inspectors that select fields by
+/// index get to skip the other fields.
+template <class Inspector, class... Fields>
+bool load_object_fields(Inspector &f, Fields &... fs) {
+  if constexpr (has_field_projection<Inspector>::value)
+    return load_object_fields(f, std::index_sequence_for<Fields...>{}, fs...);
+  else
+    return (fs(f) && ...);
+}
+
+// -- patching of objects ------------------------------------------------------
+
+/// Number of fields per object that patches of `diff_inspector` track
+/// individually. Patches always include the fields after the first
+/// `patch_mask_bits` fields of an object.
+constexpr size_t patch_mask_bits = 63;
+
+/// Checks whether patches update the elements of a `T` in place, i.e.,
+/// whether `T` is a list with mutable elements.
+template <class Inspector, class T> constexpr bool is_patchable_list() {
+  using access_type = decltype(inspect_access_type<Inspector, T>());
+  if constexpr (std::is_same<access_type, inspector_access_type::list>::value) {
+    using reference = decltype(*std::declval<T &>().begin());
+    return !std::is_const<std::remove_reference_t<reference>>::value;
+  } else {
+    return false;
+  }
+}
+
 // -- inspection support for std::chrono types ---------------------------------
 
 template <class Rep, class Period>
@@ -515,7 +884,7 @@ struct inspector_access<std::chrono::duration<Rep, Period>>
   using value_type = std::chrono::duration<Rep, Period>;
 
   template <class Inspector> static bool apply(Inspector &f, value_type &x) {
-    if (f.has_human_readable_format()) {
+    if constexpr (Inspector::has_human_readable_format()) {
       auto get = [&x] {
         std::string str;
         print(str, x);
@@ -532,6 +901,10 @@ struct inspector_access<std::chrono::duration<Rep, Period>>
       return f.apply(get, set);
     }
   }
+
+  template <class Inspector> static bool skip(Inspector &f) {
+    return f.template skip_value<Rep>();
+  }
 };
 
 template <class Duration>
@@ -543,7 +916,7 @@ struct inspector_access<
       std::chrono::time_point<std::chrono::system_clock, Duration>;
 
   template <class Inspector> static bool apply(Inspector &f, value_type &x) {
-    if (f.has_human_readable_format()) {
+    if constexpr (Inspector::has_human_readable_format()) {
       auto get = [&x] {
         std::string str;
         print(str, x);
@@ -561,6 +934,10 @@ struct inspector_access<
       return f.apply(get, set);
     }
   }
+
+  template <class Inspector> static bool skip(Inspector &f) {
+    return f.template skip_value<typename Duration::rep>();
+  }
 };
 
 // print functions
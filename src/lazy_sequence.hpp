@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include "binary_deserializer.hpp"
+
+/// Input range over the elements of a sequence in the input of a
+/// `binary_deserializer`, e.g., a serialized `std::vector<T>`. Reads the size
+/// of the sequence on construction and loads one element per increment into
+/// the same `T`, so only one element is alive at a time. The deserializer
+/// must outlive the range and may not be used otherwise until the range
+/// reaches its end. Iteration stops early if loading an element fails, in
+/// which case `ok()` returns `false` and the deserializer holds the error.
+/// Columnar lists have no elements to load one at a time, so the range
+/// fails on construction if they are enabled for lists of `T`.
+template <class T> class lazy_sequence {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T *;
+    using reference = T &;
+
+    iterator() noexcept : seq_(nullptr) {}
+
+    explicit iterator(lazy_sequence *seq) noexcept : seq_(seq) {}
+
+    T &operator*() const noexcept { return seq_->current_; }
+
+    T *operator->() const noexcept { return &seq_->current_; }
+
+    iterator &operator++() {
+      if (!seq_->advance())
+        seq_ = nullptr;
+      return *this;
+    }
+
+    /// Post-increment for input iterators, the old value is not available.
+    void operator++(int) { ++*this; }
+
+    friend bool operator==(const iterator &x, const iterator &y) noexcept {
+      return x.seq_ == y.seq_;
+    }
+
+    friend bool operator!=(const iterator &x, const iterator &y) noexcept {
+      return x.seq_ != y.seq_;
+    }
+
+  private:
+    lazy_sequence *seq_; // null at the end
+  };
+
+  explicit lazy_sequence(binary_deserializer &source)
+      : source_(source), size_(0), next_(0), ok_(false), started_(false),
+        current_() {
+    if constexpr (is_columnar_list<binary_deserializer, std::vector<T>>()) {
+      if (source_.columnar_lists()) {
+        source_.emplace_error(error_code::invalid_argument,
+                              "lazy_sequence cannot read columnar lists");
+        return;
+      }
+    }
+    ok_ = source_.begin_sequence(size_) &&
+          (size_ > 0 || source_.end_sequence());
+  }
+
+  lazy_sequence(const lazy_sequence &) = delete;
+
+  lazy_sequence &operator=(const lazy_sequence &) = delete;
+
+  /// Returns the number of elements in the sequence.
+  size_t size() const noexcept { return size_; }
+
+  /// Returns how many elements have not been loaded yet.
+  size_t remaining() const noexcept { return size_ - next_; }
+
+  /// Returns whether all elements so far loaded without errors.
+  bool ok() const noexcept { return ok_; }
+
+  /// Loads the first element. A range can only be traversed once.
+  iterator begin() {
+    if (started_)
+      return end();
+    started_ = true;
+    return advance() ? iterator{this} : end();
+  }
+
+  iterator end() noexcept { return iterator{}; }
+
+  /// Loads the next element into `x`. Returns `false` after the last element
+  /// or on error.
+  bool next(T &x) {
+    started_ = true;
+    if (!ok_ || next_ == size_)
+      return false;
+    ++next_;
+    if (!source_.apply(x)) {
+      ok_ = false;
+      return false;
+    }
+    if (next_ == size_)
+      ok_ = source_.end_sequence();
+    return true;
+  }
+
+private:
+  bool advance() { return next(current_); }
+
+  binary_deserializer &source_;
+  size_t size_;
+  size_t next_; // index of the next element to load
+  bool ok_;
+  bool started_;
+  T current_;
+};
@@ -4,6 +4,7 @@
 #include <type_traits>
 #include <utility>
 
+#include "delta_packed.hpp"
 #include "inspector_access.hpp"
 #include "my_error.hpp"
 
@@ -42,6 +43,12 @@ public:
     U fallback;
     Predicate predicate;
 
+    static constexpr size_t presence_flags = optional_field_presence_flags<T>();
+
+    template <class Inspector> bool skip(Inspector &f) {
+      return skip_optional_field<T>(f, field_name);
+    }
+
     template <class Inspector> bool operator()(Inspector &f) {
       auto reset = [this] { *val = std::move(fallback); };
       return load_field(f, field_name, *val, predicate, always_true, reset);
@@ -53,6 +60,12 @@ public:
     T *val;
     U fallback;
 
+    static constexpr size_t presence_flags = optional_field_presence_flags<T>();
+
+    template <class Inspector> bool skip(Inspector &f) {
+      return skip_optional_field<T>(f, field_name);
+    }
+
     template <class Inspector> bool operator()(Inspector &f) {
       auto reset = [this] { *val = std::move(fallback); };
       return load_field(f, field_name, *val, always_true, always_true, reset);
@@ -73,6 +86,12 @@ public:
     T *val;
     Predicate predicate;
 
+    static constexpr size_t presence_flags = field_presence_flags<T>();
+
+    template <class Inspector> bool skip(Inspector &f) {
+      return skip_field<T>(f, field_name);
+    }
+
     template <class Inspector> bool operator()(Inspector &f) {
       return load_field(f, field_name, *val, predicate, always_true);
     }
@@ -87,10 +106,33 @@ public:
     }
   };
 
+  template <class T> struct delta_packed_field_t {
+    std::string_view field_name;
+    T *val;
+
+    static constexpr size_t presence_flags = 0;
+
+    template <class Inspector> bool skip(Inspector &f) {
+      return f.begin_field(field_name) && skip_delta_packed<T>(f) &&
+             f.end_field();
+    }
+
+    template <class Inspector> bool operator()(Inspector &f) {
+      return f.begin_field(field_name) && load_delta_packed(f, *val) &&
+             f.end_field();
+    }
+  };
+
   template <class T> struct field_t {
     std::string_view field_name;
     T *val;
 
+    static constexpr size_t presence_flags = field_presence_flags<T>();
+
+    template <class Inspector> bool skip(Inspector &f) {
+      return skip_field<T>(f, field_name);
+    }
+
     template <class Inspector> bool operator()(Inspector &f) {
       return load_field(f, field_name, *val, always_true, always_true);
     }
@@ -106,6 +148,15 @@ public:
           std::move(predicate),
       };
     }
+
+    /// Loads a `std::vector` that `save_inspector::field_t::delta_packed`
+    /// stored.
+    auto delta_packed() && {
+      static_assert(is_delta_packed_list<T>::value,
+                    "delta_packed requires a std::vector of integers, "
+                    "durations or time points");
+      return delta_packed_field_t<T>{field_name, val};
+    }
   };
 
   // -- DSL types for virtual fields (getter and setter access) ----------------
@@ -117,6 +168,12 @@ public:
     U fallback;
     Predicate predicate;
 
+    static constexpr size_t presence_flags = optional_field_presence_flags<T>();
+
+    template <class Inspector> bool skip(Inspector &f) {
+      return skip_optional_field<T>(f, field_name);
+    }
+
     template <class Inspector> bool operator()(Inspector &f) {
       auto tmp = T{};
       auto sync = bind_setter(f, set, tmp);
@@ -130,6 +187,12 @@ public:
     Set set;
     U fallback;
 
+    static constexpr size_t presence_flags = optional_field_presence_flags<T>();
+
+    template <class Inspector> bool skip(Inspector &f) {
+      return skip_optional_field<T>(f, field_name);
+    }
+
     template <class Inspector> bool operator()(Inspector &f) {
       auto tmp = T{};
       auto sync = bind_setter(f, set, tmp);
@@ -153,6 +216,12 @@ public:
     Set set;
     Predicate predicate;
 
+    static constexpr size_t presence_flags = field_presence_flags<T>();
+
+    template <class Inspector> bool skip(Inspector &f) {
+      return skip_field<T>(f, field_name);
+    }
+
     template <class Inspector> bool operator()(Inspector &f) {
       auto tmp = T{};
       auto sync = bind_setter(f, set, tmp);
@@ -173,6 +242,12 @@ public:
     std::string_view field_name;
     Set set;
 
+    static constexpr size_t presence_flags = field_presence_flags<T>();
+
+    template <class Inspector> bool skip(Inspector &f) {
+      return skip_field<T>(f, field_name);
+    }
+
     template <class Inspector> bool operator()(Inspector &f) {
       auto tmp = T{};
       auto sync = bind_setter(f, set, tmp);
@@ -201,6 +276,12 @@ public:
     Reset reset;
     Set set;
 
+    static constexpr size_t presence_flags = optional_field_presence_flags<T>();
+
+    template <class Inspector> bool skip(Inspector &f) {
+      return skip_optional_field<T>(f, field_name);
+    }
+
     template <class Inspector> bool operator()(Inspector &f) {
       auto tmp = T{};
       auto sync = bind_setter(f, set, tmp);
@@ -219,8 +300,12 @@ public:
 
     template <class... Fields> bool fields(Fields &&... fs) {
       using load_callback_result = decltype(load_callback());
-      if (!(f->begin_object(object_type, object_name) && (fs(*f) && ...)))
+      if (!(begin_object_fields<Fields...>(*f, object_type, object_name) &&
+            load_object_fields(*f, fs...)))
         return false;
+      // Skipping all fields leaves nothing for the callback to check.
+      if (!loads_fields(*f))
+        return end_object_fields(*f);
       if constexpr (std::is_same<load_callback_result, bool>::value) {
         if (!load_callback()) {
           f->set_error(load_callback_failed);
@@ -232,7 +317,7 @@ public:
           return false;
         }
       }
-      return f->end_object();
+      return end_object_fields(*f);
     }
 
     auto pretty_name(std::string_view name) && {
@@ -250,9 +335,9 @@ public:
     Inspector *f;
 
     template <class... Fields> bool fields(Fields &&... fs) {
-      return f->begin_object(object_type, object_name) //
-             && (fs(*f) && ...)                        //
-             && f->end_object();
+      return begin_object_fields<Fields...>(*f, object_type, object_name) //
+             && load_object_fields(*f, fs...)                            //
+             && end_object_fields(*f);
     }
 
     auto pretty_name(std::string_view name) && {
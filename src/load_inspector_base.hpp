@@ -4,6 +4,7 @@
 #include <tuple>
 #include <utility>
 
+#include "columnar_lists.hpp"
 #include "inspector_access.hpp"
 #include "load_inspector.hpp"
 #include "type_id.hpp"
@@ -26,6 +27,10 @@ public:
   }
 
   template <class T> bool list(T &xs) {
+    if constexpr (is_columnar_list<Subtype, T>()) {
+      if (dref().columnar_lists())
+        return load_columnar_list(dref(), xs);
+    }
     xs.clear();
     auto size = size_t{0};
     if (!dref().begin_sequence(size))
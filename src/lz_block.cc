@@ -0,0 +1,462 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "lz_block.hpp"
+
+// Each sequence consists of a token (4 bits literal length, 4 bits match
+// length), optional length extension bytes, the literals and a 2-byte little
+// endian match offset. The last sequence only carries literals.
+
+constexpr size_t lz_min_match = 4;
+
+constexpr size_t lz_max_offset = 65535;
+
+// The last bytes of the input are always stored as literals.
+constexpr size_t lz_last_literals = 5;
+
+// Matches never start in the last bytes of the input.
+constexpr size_t lz_match_limit = 12;
+
+// Upper bound for the hash table of the input.
+constexpr int lz_hash_log = 12;
+
+// Hash table size of dictionaries, which may span the full offset range.
+constexpr int lz_dict_hash_log = 14;
+
+static uint32_t read32(const uint8_t *ptr) {
+  uint32_t result;
+  memcpy(&result, ptr, sizeof(result));
+  return result;
+}
+
+static uint64_t read64(const uint8_t *ptr) {
+  uint64_t result;
+  memcpy(&result, ptr, sizeof(result));
+  return result;
+}
+
+// Returns the length of the common prefix of `lhs` and `rhs`, reading no
+// further than `limit` bytes.
+static size_t common_prefix(const uint8_t *lhs, const uint8_t *rhs,
+                            size_t limit) {
+  size_t len = 0;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  for (; len + 8 <= limit; len += 8) {
+    if (auto diff = read64(lhs + len) ^ read64(rhs + len))
+      return len + (__builtin_ctzll(diff) >> 3);
+  }
+#endif
+  while (len < limit && lhs[len] == rhs[len])
+    ++len;
+  return len;
+}
+
+static uint32_t lz_hash(uint32_t sequence, int hash_log) {
+  return (sequence * 2654435761u) >> (32 - hash_log);
+}
+
+static uint8_t *write_length(uint8_t *op, size_t len) {
+  for (; len >= 255; len -= 255)
+    *op++ = 255;
+  *op++ = static_cast<uint8_t>(len);
+  return op;
+}
+
+static uint8_t *write_sequence(uint8_t *op, const uint8_t *literals,
+                               size_t literal_len, size_t offset,
+                               size_t match_len) {
+  auto *token = op++;
+  *token = static_cast<uint8_t>((literal_len < 15 ? literal_len : 15) << 4);
+  if (literal_len >= 15)
+    op = write_length(op, literal_len - 15);
+  if (literal_len > 0)
+    memcpy(op, literals, literal_len);
+  op += literal_len;
+  if (match_len == 0)
+    return op;
+  *op++ = static_cast<uint8_t>(offset);
+  *op++ = static_cast<uint8_t>(offset >> 8);
+  auto len = match_len - lz_min_match;
+  *token |= static_cast<uint8_t>(len < 15 ? len : 15);
+  if (len >= 15)
+    op = write_length(op, len - 15);
+  return op;
+}
+
+static size_t compress_impl(span<const std::byte> input, byte_buffer &out,
+                            const lz_dictionary *dict) {
+  auto start = out.size();
+  out.resize(start + lz_compress_bound(input.size()));
+  auto *src = reinterpret_cast<const uint8_t *>(input.data());
+  auto *op = reinterpret_cast<uint8_t *>(out.data() + start);
+  auto n = input.size();
+  size_t anchor = 0;
+  if (n > lz_match_limit) {
+    // Small inputs only clear a small part of the table.
+    auto hash_log = 8;
+    while (hash_log < lz_hash_log && (size_t{1} << hash_log) < n)
+      ++hash_log;
+    uint32_t table[1 << lz_hash_log];
+    memset(table, 0, sizeof(uint32_t) << hash_log);
+    const uint8_t *dict_src = nullptr;
+    size_t dict_size = 0;
+    if (dict != nullptr) {
+      dict_src = reinterpret_cast<const uint8_t *>(dict->content().data());
+      dict_size = dict->content().size();
+    }
+    auto match_end = n - lz_last_literals;
+    size_t pos = 1;
+    while (pos + lz_match_limit <= n) {
+      auto sequence = read32(src + pos);
+      auto &slot = table[lz_hash(sequence, hash_log)];
+      size_t ref = slot;
+      slot = static_cast<uint32_t>(pos);
+      size_t offset = 0;
+      size_t len = 0;
+      if (ref < pos && pos - ref <= lz_max_offset &&
+          read32(src + ref) == sequence) {
+        while (pos > anchor && ref > 0 && src[pos - 1] == src[ref - 1]) {
+          --pos;
+          --ref;
+        }
+        offset = pos - ref;
+        len = lz_min_match + common_prefix(src + pos + lz_min_match,
+                                           src + ref + lz_min_match,
+                                           match_end - pos - lz_min_match);
+      } else if (dict_size >= lz_min_match) {
+        // Matches in the dictionary end at its last byte.
+        auto dict_ref = dict->find(sequence);
+        if (dict_ref + lz_min_match <= dict_size &&
+            dict_size - dict_ref + pos <= lz_max_offset &&
+            read32(dict_src + dict_ref) == sequence) {
+          offset = dict_size - dict_ref + pos;
+          auto limit = std::min(match_end - pos, dict_size - dict_ref);
+          len = lz_min_match + common_prefix(src + pos + lz_min_match,
+                                             dict_src + dict_ref +
+                                                 lz_min_match,
+                                             limit - lz_min_match);
+        }
+      }
+      if (len == 0) {
+        // Skip faster through input that does not compress.
+        pos += 1 + ((pos - anchor) >> 6);
+        continue;
+      }
+      op = write_sequence(op, src + anchor, pos - anchor, offset, len);
+      pos += len;
+      anchor = pos;
+      if (pos + lz_min_match <= n)
+        table[lz_hash(read32(src + pos - 2), hash_log)] =
+            static_cast<uint32_t>(pos - 2);
+    }
+  }
+  op = write_sequence(op, src + anchor, n - anchor, 0, 0);
+  auto *base = reinterpret_cast<uint8_t *>(out.data());
+  out.resize(static_cast<size_t>(op - base));
+  return out.size() - start;
+}
+
+size_t lz_compress(span<const std::byte> input, byte_buffer &out) {
+  return compress_impl(input, out, nullptr);
+}
+
+size_t lz_compress(span<const std::byte> input, byte_buffer &out,
+                   const lz_dictionary &dict) {
+  return compress_impl(input, out, &dict);
+}
+
+static bool read_length(const uint8_t *&ip, const uint8_t *iend, size_t &len) {
+  uint8_t byte = 0;
+  do {
+    if (ip == iend)
+      return false;
+    byte = *ip++;
+    len += byte;
+  } while (byte == 255);
+  return true;
+}
+
+static bool decompress_impl(span<const std::byte> input, span<std::byte> out,
+                            span<const std::byte> dict) noexcept {
+  auto *dict_end = reinterpret_cast<const uint8_t *>(dict.end());
+  auto *ip = reinterpret_cast<const uint8_t *>(input.data());
+  auto *iend = ip + input.size();
+  auto *obegin = reinterpret_cast<uint8_t *>(out.data());
+  auto *op = obegin;
+  auto *oend = op + out.size();
+  while (ip < iend) {
+    auto token = *ip++;
+    size_t literal_len = token >> 4;
+    if (literal_len == 15 && !read_length(ip, iend, literal_len))
+      return false;
+    if (literal_len > static_cast<size_t>(iend - ip) ||
+        literal_len > static_cast<size_t>(oend - op))
+      return false;
+    if (literal_len <= 16 && iend - ip >= 16 && oend - op >= 16)
+      memcpy(op, ip, 16); // copying a fixed size is faster for short runs
+    else if (literal_len > 0)
+      memcpy(op, ip, literal_len);
+    ip += literal_len;
+    op += literal_len;
+    if (ip == iend)
+      break;
+    if (iend - ip < 2)
+      return false;
+    size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+    ip += 2;
+    size_t match_len = token & 0x0F;
+    if (match_len == 15 && !read_length(ip, iend, match_len))
+      return false;
+    match_len += lz_min_match;
+    auto produced = static_cast<size_t>(op - obegin);
+    if (offset == 0 || offset > produced + dict.size() ||
+        match_len > static_cast<size_t>(oend - op))
+      return false;
+    if (offset > produced) {
+      // The match starts in the dictionary and may continue in the output.
+      auto *match = dict_end - (offset - produced);
+      auto from_dict = std::min(match_len, offset - produced);
+      memcpy(op, match, from_dict);
+      op += from_dict;
+      for (size_t i = from_dict; i < match_len; ++i, ++op)
+        *op = op[-static_cast<ptrdiff_t>(offset)];
+      continue;
+    }
+    auto *match = op - offset;
+    if (offset >= 8 && static_cast<size_t>(oend - op) >= match_len + 8) {
+      // Copy in 8-byte steps and allow writing past the match, which the
+      // following sequences overwrite.
+      for (size_t i = 0; i < match_len; i += 8)
+        memcpy(op + i, match + i, 8);
+      op += match_len;
+    } else if (offset >= match_len) {
+      memcpy(op, match, match_len);
+      op += match_len;
+    } else {
+      // Overlapping copy, e.g., for runs of a single byte.
+      for (size_t i = 0; i < match_len; ++i)
+        *op++ = *match++;
+    }
+  }
+  return op == oend;
+}
+
+bool lz_decompress(span<const std::byte> input,
+                   span<std::byte> out) noexcept {
+  return decompress_impl(input, out, span<const std::byte>{});
+}
+
+bool lz_decompress(span<const std::byte> input, span<std::byte> out,
+                   const lz_dictionary &dict) noexcept {
+  return decompress_impl(input, out, dict.content());
+}
+
+static void write_varbyte(byte_buffer &out, size_t x) {
+  while (x > 0x7f) {
+    out.emplace_back(static_cast<std::byte>((x & 0x7f) | 0x80));
+    x >>= 7;
+  }
+  out.emplace_back(static_cast<std::byte>(x));
+}
+
+static bool read_varbyte(span<const std::byte> &input, size_t &x) {
+  x = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (input.empty())
+      return false;
+    auto byte = static_cast<uint8_t>(input[0]);
+    input = input.subspan(1);
+    x |= static_cast<size_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+static void write_frame_impl(span<const std::byte> payload, byte_buffer &out,
+                             const lz_dictionary *dict,
+                             const frame_options &opts) {
+  auto start = out.size();
+  if (payload.size() >= opts.min_compress_size) {
+    auto method = dict != nullptr ? frame_method::lz_dict : frame_method::lz;
+    out.emplace_back(static_cast<std::byte>(method));
+    write_varbyte(out, payload.size());
+    byte_buffer compressed;
+    compressed.reserve(lz_compress_bound(payload.size()));
+    auto stored = compress_impl(payload, compressed, dict);
+    auto limit = payload.size();
+    if (opts.min_savings_divisor > 0)
+      limit -= payload.size() / opts.min_savings_divisor;
+    if (stored < limit) {
+      write_varbyte(out, stored);
+      out.insert(out.end(), compressed.begin(), compressed.end());
+      return;
+    }
+    out.resize(start);
+  }
+  out.emplace_back(static_cast<std::byte>(frame_method::raw));
+  write_varbyte(out, payload.size());
+  write_varbyte(out, payload.size());
+  out.insert(out.end(), payload.begin(), payload.end());
+}
+
+void write_frame(span<const std::byte> payload, byte_buffer &out,
+                 const frame_options &opts) {
+  write_frame_impl(payload, out, nullptr, opts);
+}
+
+void write_frame(span<const std::byte> payload, byte_buffer &out,
+                 const lz_dictionary &dict, const frame_options &opts) {
+  write_frame_impl(payload, out, &dict, opts);
+}
+
+static bool read_frame_impl(span<const std::byte> &input, byte_buffer &scratch,
+                            span<const std::byte> &payload,
+                            const lz_dictionary *dict) {
+  if (input.empty())
+    return false;
+  auto method = static_cast<frame_method>(input[0]);
+  auto rest = input.subspan(1);
+  size_t payload_size = 0;
+  size_t stored_size = 0;
+  if (!read_varbyte(rest, payload_size) || !read_varbyte(rest, stored_size) ||
+      stored_size > rest.size())
+    return false;
+  // Rejects sizes that no input of this size decompresses to before
+  // allocating the output.
+  if (method != frame_method::raw &&
+      payload_size > lz_decompress_bound(stored_size))
+    return false;
+  auto stored = rest.first(stored_size);
+  switch (method) {
+  case frame_method::raw:
+    if (stored_size != payload_size)
+      return false;
+    payload = stored;
+    break;
+  case frame_method::lz:
+    scratch.resize(payload_size);
+    if (!lz_decompress(stored, make_span(scratch)))
+      return false;
+    payload = make_span(scratch.data(), scratch.size());
+    break;
+  case frame_method::lz_dict:
+    if (dict == nullptr)
+      return false;
+    scratch.resize(payload_size);
+    if (!lz_decompress(stored, make_span(scratch), *dict))
+      return false;
+    payload = make_span(scratch.data(), scratch.size());
+    break;
+  default:
+    return false;
+  }
+  input = rest.subspan(stored_size);
+  return true;
+}
+
+bool read_frame(span<const std::byte> &input, byte_buffer &scratch,
+                span<const std::byte> &payload) {
+  return read_frame_impl(input, scratch, payload, nullptr);
+}
+
+bool read_frame(span<const std::byte> &input, byte_buffer &scratch,
+                span<const std::byte> &payload, const lz_dictionary &dict) {
+  return read_frame_impl(input, scratch, payload, &dict);
+}
+
+// -- dictionaries -------------------------------------------------------------
+
+lz_dictionary::lz_dictionary(byte_buffer content)
+    : content_(std::move(content)), table_(size_t{1} << lz_dict_hash_log) {
+  assert(content_.size() <= lz_max_dictionary_size);
+  auto *src = reinterpret_cast<const uint8_t *>(content_.data());
+  // Later positions overwrite earlier ones, since they need shorter offsets.
+  for (size_t pos = 0; pos + lz_min_match <= content_.size(); ++pos)
+    table_[lz_hash(read32(src + pos), lz_dict_hash_log)] =
+        static_cast<uint32_t>(pos);
+}
+
+size_t lz_dictionary::find(uint32_t sequence) const noexcept {
+  return table_[lz_hash(sequence, lz_dict_hash_log)];
+}
+
+// Length of the substrings counted by `train`.
+constexpr size_t lz_train_kmer = 6;
+
+// Length of the candidate segments picked by `train`.
+constexpr size_t lz_train_segment = 32;
+
+static uint64_t read_kmer(const std::byte *ptr) {
+  uint64_t result = 0;
+  memcpy(&result, ptr, lz_train_kmer);
+  return result;
+}
+
+lz_dictionary lz_dictionary::train(span<const span<const std::byte>> samples,
+                                   size_t capacity) {
+  capacity = std::min(capacity, lz_max_dictionary_size);
+  // Count in how many samples each substring occurs.
+  std::unordered_map<uint64_t, uint32_t> frequency;
+  std::unordered_set<uint64_t> seen;
+  for (auto sample : samples) {
+    seen.clear();
+    for (size_t pos = 0; pos + lz_train_kmer <= sample.size(); ++pos) {
+      auto kmer = read_kmer(sample.data() + pos);
+      if (seen.insert(kmer).second)
+        ++frequency[kmer];
+    }
+  }
+  // Score overlapping segments by the substrings they share with others.
+  struct candidate {
+    size_t score;
+    span<const std::byte> bytes;
+  };
+  auto score = [&](span<const std::byte> bytes, auto &&predicate) {
+    size_t result = 0;
+    for (size_t pos = 0; pos + lz_train_kmer <= bytes.size(); ++pos) {
+      auto kmer = read_kmer(bytes.data() + pos);
+      if (auto i = frequency.find(kmer); i->second > 1 && predicate(kmer))
+        result += i->second;
+    }
+    return result;
+  };
+  auto any = [](uint64_t) { return true; };
+  std::vector<candidate> candidates;
+  for (auto sample : samples) {
+    for (size_t pos = 0; pos < sample.size(); pos += lz_train_segment / 2) {
+      auto len = std::min(lz_train_segment, sample.size() - pos);
+      auto bytes = sample.subspan(pos, len);
+      if (auto value = score(bytes, any); value > 0)
+        candidates.push_back(candidate{value, bytes});
+    }
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](auto &x, auto &y) { return x.score > y.score; });
+  // Pick the best segments, skipping the ones that mostly repeat substrings
+  // of segments picked earlier.
+  std::unordered_set<uint64_t> covered;
+  auto uncovered = [&](uint64_t kmer) { return covered.count(kmer) == 0; };
+  std::vector<span<const std::byte>> picked;
+  size_t total = 0;
+  for (auto &c : candidates) {
+    if (total + c.bytes.size() > capacity)
+      continue;
+    if (score(c.bytes, uncovered) * 2 < c.score)
+      continue;
+    for (size_t pos = 0; pos + lz_train_kmer <= c.bytes.size(); ++pos)
+      covered.insert(read_kmer(c.bytes.data() + pos));
+    picked.push_back(c.bytes);
+    total += c.bytes.size();
+  }
+  // Put the most valuable segments last, i.e., closest to the input.
+  byte_buffer content;
+  content.reserve(total);
+  for (auto i = picked.rbegin(); i != picked.rend(); ++i)
+    content.insert(content.end(), i->begin(), i->end());
+  return lz_dictionary{std::move(content)};
+}
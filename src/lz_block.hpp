@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "span.hpp"
+
+using byte_buffer = std::vector<std::byte>;
+
+/// Upper bound for the size of an `lz_dictionary`, given by the maximum match
+/// offset.
+constexpr size_t lz_max_dictionary_size = 32 * 1024;
+
+/// Shared dictionary for compressing small messages. Matches may refer to the
+/// dictionary as if it preceded the input, so content that repeats across
+/// messages (field names, enum strings, id prefixes) compresses even when it
+/// occurs only once per message. Both ends must use the same dictionary,
+/// typically trained offline and loaded at startup.
+class lz_dictionary {
+public:
+  explicit lz_dictionary(byte_buffer content);
+
+  /// Builds a dictionary of at most `capacity` bytes from segments that occur
+  /// frequently across `samples`.
+  static lz_dictionary train(span<const span<const std::byte>> samples,
+                             size_t capacity = lz_max_dictionary_size);
+
+  span<const std::byte> content() const noexcept {
+    return make_span(content_.data(), content_.size());
+  }
+
+  /// Returns a candidate position for a match starting with `sequence`.
+  size_t find(uint32_t sequence) const noexcept;
+
+private:
+  byte_buffer content_;
+  std::vector<uint32_t> table_;
+};
+
+/// Returns the maximum size of compressing `input_size` bytes.
+constexpr size_t lz_compress_bound(size_t input_size) {
+  return input_size + input_size / 255 + 16;
+}
+
+/// Returns the maximum size of decompressing `input_size` bytes. Each byte of
+/// a length extension adds at most 255 bytes to the output.
+constexpr size_t lz_decompress_bound(size_t input_size) {
+  return input_size * 255 + 16;
+}
+
+/// Compresses `input` with a dependency-free LZ77 compressor using the LZ4
+/// block layout and appends the result to `out`. Returns the number of
+/// appended bytes.
+size_t lz_compress(span<const std::byte> input, byte_buffer &out);
+
+/// Compresses `input` against `dict` and appends the result to `out`.
+size_t lz_compress(span<const std::byte> input, byte_buffer &out,
+                   const lz_dictionary &dict);
+
+/// Decompresses `input` into `out`, which must have exactly the size of the
+/// original data. Returns `false` if `input` is malformed.
+bool lz_decompress(span<const std::byte> input, span<std::byte> out) noexcept;
+
+/// Decompresses `input` that was compressed against `dict`.
+bool lz_decompress(span<const std::byte> input, span<std::byte> out,
+                   const lz_dictionary &dict) noexcept;
+
+/// Selects how `write_frame` stores its payload.
+enum class frame_method : uint8_t {
+  raw = 0,
+  lz = 1,
+  lz_dict = 2,
+};
+
+/// Configures `write_frame`.
+struct frame_options {
+  /// Payloads below this size are stored raw without trying to compress them.
+  size_t min_compress_size = 128;
+  /// Compressed payloads must save at least 1/`min_savings_divisor` of the
+  /// original size. Otherwise, e.g., for high-entropy data, the frame stores
+  /// the payload raw. A divisor of 0 stores the compressed payload whenever
+  /// it is smaller than the original.
+  size_t min_savings_divisor = 8;
+};
+
+/// Appends a frame holding `payload` to `out`. A frame starts with the
+/// `frame_method`, followed by the payload size and the stored size as
+/// varbyte integers and the stored bytes.
+void write_frame(span<const std::byte> payload, byte_buffer &out,
+                 const frame_options &opts = frame_options{});
+
+/// Appends a frame holding `payload` compressed against `dict`.
+void write_frame(span<const std::byte> payload, byte_buffer &out,
+                 const lz_dictionary &dict,
+                 const frame_options &opts = frame_options{});
+
+/// Reads the next frame from `input` and advances `input` past it. On success,
+/// `payload` points to the original bytes: into `input` for raw frames and
+/// into `scratch` for compressed frames, which get decompressed directly into
+/// the buffer that a `binary_deserializer` reads from.
+/// Rejects frames with a payload size above `lz_decompress_bound` of the
+/// stored size before allocating any memory.
+bool read_frame(span<const std::byte> &input, byte_buffer &scratch,
+                span<const std::byte> &payload);
+
+/// Reads the next frame from `input`, which may have been compressed against
+/// `dict`.
+bool read_frame(span<const std::byte> &input, byte_buffer &scratch,
+                span<const std::byte> &payload, const lz_dictionary &dict);
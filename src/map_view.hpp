@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "binary_deserializer.hpp"
+#include "network_order.hpp"
+#include "span.hpp"
+
+/// Read-only view of a map that `binary_serializer` saved in the indexed maps
+/// mode, e.g., a `std::map<K, V>` or a `std::unordered_map<K, V>`. Looks up
+/// keys with a binary search over the entry offsets and only decodes the keys
+/// it compares and the value it finds. Compares `std::string` keys in place
+/// without allocating. The input must outlive the view.
+template <class K, class V> class map_view {
+public:
+  /// Type for passing keys to `find`.
+  using key_arg = std::conditional_t<std::is_same<K, std::string>::value,
+                                     std::string_view, const K &>;
+
+  /// Reads the index of the map at the read position of `source` and skips
+  /// the map. Reads values with the settings and the nesting level of
+  /// `source`.
+  explicit map_view(binary_deserializer &source)
+      : offsets_(nullptr), entries_(nullptr), size_(0), entries_size_(0),
+        ok_(false), depth_(source.depth()),
+        presence_bitmaps_(source.presence_bitmaps()),
+        nested_object_lengths_(source.nested_object_lengths()),
+        indexed_maps_(source.indexed_maps()),
+        columnar_lists_(source.columnar_lists()) {
+    init(source);
+  }
+
+  /// Reads the index of the map at the start of `bytes`, which must contain a
+  /// top-level map saved with the default settings.
+  explicit map_view(span<const std::byte> bytes)
+      : offsets_(nullptr), entries_(nullptr), size_(0), entries_size_(0),
+        ok_(false), depth_(0), presence_bitmaps_(false),
+        nested_object_lengths_(false), indexed_maps_(true),
+        columnar_lists_(false) {
+    binary_deserializer source{bytes};
+    init(source);
+  }
+
+  /// Returns whether the index of the map is valid.
+  bool ok() const noexcept { return ok_; }
+
+  /// Returns the number of entries in the map.
+  size_t size() const noexcept { return size_; }
+
+  /// Loads the value for `key` into `value`. Returns `false` if the map has
+  /// no entry for `key` or if an entry on the way is malformed.
+  bool find(key_arg key, V &value) const {
+    binary_deserializer reader;
+    configure(reader);
+    if (!lookup(reader, key))
+      return false;
+    return reader.apply(value);
+  }
+
+  /// Checks whether the map has an entry for `key`.
+  bool contains(key_arg key) const {
+    binary_deserializer reader;
+    configure(reader);
+    return lookup(reader, key);
+  }
+
+private:
+  void init(binary_deserializer &source) {
+    auto entries_size = uint32_t{0};
+    if (!source.begin_sequence(size_) || !source.value(entries_size))
+      return;
+    if (size_ > source.remaining() / sizeof(uint32_t) ||
+        entries_size > source.remaining() - size_ * sizeof(uint32_t)) {
+      source.emplace_error(error_code::end_of_stream);
+      return;
+    }
+    offsets_ = source.current();
+    entries_ = offsets_ + size_ * sizeof(uint32_t);
+    entries_size_ = entries_size;
+    source.skip(size_ * sizeof(uint32_t) + entries_size_);
+    ok_ = true;
+  }
+
+  void configure(binary_deserializer &reader) const noexcept {
+    reader.set_presence_bitmaps(presence_bitmaps_);
+    reader.set_nested_object_lengths(nested_object_lengths_);
+    reader.set_indexed_maps(indexed_maps_);
+    reader.set_columnar_lists(columnar_lists_);
+  }
+
+  /// Positions `reader` at the value for `key`.
+  bool lookup(binary_deserializer &reader, key_arg key) const {
+    if (!ok_)
+      return false;
+    size_t first = 0;
+    size_t last = size_;
+    while (first < last) {
+      auto mid = first + (last - first) / 2;
+      int order = 0;
+      if (!seek(reader, mid) || !compare_key(reader, key, order))
+        return false;
+      if (order < 0)
+        first = mid + 1;
+      else if (order > 0)
+        last = mid;
+      else
+        return true;
+    }
+    return false;
+  }
+
+  /// Positions `reader` at the entry with index `i`.
+  bool seek(binary_deserializer &reader, size_t i) const noexcept {
+    auto offset = uint32_t{0};
+    memcpy(&offset, offsets_ + i * sizeof(uint32_t), sizeof(offset));
+    offset = from_network_order(offset);
+    if (offset >= entries_size_)
+      return false;
+    reader.reset(make_span(entries_ + offset, entries_ + entries_size_),
+                 depth_);
+    return true;
+  }
+
+  /// Reads the key at the read position of `reader` and sets `order` to a
+  /// negative value if it is less than `key`, to a positive value if it is
+  /// greater than `key` and to 0 otherwise.
+  static bool compare_key(binary_deserializer &reader, key_arg key,
+                          int &order) {
+    if constexpr (std::is_same<K, std::string>::value) {
+      size_t size = 0;
+      if (!reader.begin_sequence(size) || size > reader.remaining())
+        return false;
+      auto str = reinterpret_cast<const char *>(reader.current());
+      reader.skip(size);
+      order = std::string_view{str, size}.compare(key);
+      return true;
+    } else {
+      auto tmp = K{};
+      if (!reader.apply(tmp))
+        return false;
+      std::less<> less;
+      order = less(tmp, key) ? -1 : (less(key, tmp) ? 1 : 0);
+      return true;
+    }
+  }
+
+  const std::byte *offsets_; // `size_` entry offsets in network byte order
+  const std::byte *entries_; // start of the first entry
+  size_t size_;
+  size_t entries_size_;
+  bool ok_;
+  size_t depth_; // nesting level of the map
+  bool presence_bitmaps_;
+  bool nested_object_lengths_;
+  bool indexed_maps_;
+  bool columnar_lists_;
+};
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <vector>
+
+#include "message.hpp"
+#include "my_error.hpp"
+
+static size_t align_to(size_t pos, size_t alignment) noexcept {
+  return (pos + alignment - 1) / alignment * alignment;
+}
+
+std::byte *message::allocate(span<const meta_object *const> metas) {
+  auto count = metas.size();
+  // The arrays after the header only need the alignment of their element
+  // types, which all divide alignof(header).
+  auto pos = sizeof(header) + count * (sizeof(const meta_object *) +
+                                       sizeof(size_t) + sizeof(type_id_t));
+  auto alignment = alignof(header);
+  for (auto meta : metas) {
+    pos = align_to(pos, meta->alignment) + meta->size;
+    alignment = std::max(alignment, meta->alignment);
+  }
+  auto total = align_to(pos, alignment);
+  auto data = static_cast<std::byte *>(
+      ::operator new(total, std::align_val_t{alignment}));
+  new (data) header{count, alignment, total, 0};
+  auto meta_arr = reinterpret_cast<const meta_object **>(data + sizeof(header));
+  auto offset_arr = reinterpret_cast<size_t *>(meta_arr + count);
+  auto type_arr = reinterpret_cast<type_id_t *>(offset_arr + count);
+  pos = reinterpret_cast<std::byte *>(type_arr + count) - data;
+  for (size_t index = 0; index < count; ++index) {
+    auto meta = metas[index];
+    pos = align_to(pos, meta->alignment);
+    meta_arr[index] = meta;
+    offset_arr[index] = pos;
+    type_arr[index] = meta->type;
+    pos += meta->size;
+  }
+  return data;
+}
+
+message::message(const message &other) : data_(nullptr) {
+  if (other.data_ == nullptr)
+    return;
+  auto count = other.size();
+  // Builds the copy in a temporary that cleans up if a copy throws, since
+  // the destructor of this message does not run in that case.
+  message tmp;
+  tmp.data_ = allocate(make_span(other.metas(), count));
+  for (size_t index = 0; index < count; ++index) {
+    tmp.metas()[index]->copy_construct(tmp.get_mutable(index),
+                                       other.get(index));
+    ++tmp.hdr().constructed;
+  }
+  swap(tmp);
+}
+
+message::~message() {
+  if (data_ == nullptr)
+    return;
+  for (auto index = hdr().constructed; index > 0; --index)
+    metas()[index - 1]->destroy(get_mutable(index - 1));
+  ::operator delete(data_, std::align_val_t{hdr().alignment});
+}
+
+bool message::save(binary_serializer &sink) const {
+  auto count = size();
+  if (!sink.begin_sequence(count))
+    return false;
+  for (size_t index = 0; index < count; ++index)
+    if (!sink.value(type_ids()[index]))
+      return false;
+  for (size_t index = 0; index < count; ++index)
+    if (!metas()[index]->save(sink, get(index)))
+      return false;
+  return sink.end_sequence();
+}
+
+bool message::load(binary_deserializer &source) {
+  size_t count = 0;
+  if (!source.begin_sequence(count))
+    return false;
+  if (count > source.remaining() / sizeof(type_id_t)) {
+    source.emplace_error(error_code::end_of_stream);
+    return false;
+  }
+  message result;
+  if (count > 0) {
+    std::vector<const meta_object *> metas;
+    metas.reserve(count);
+    for (size_t index = 0; index < count; ++index) {
+      auto type = type_id_t{0};
+      if (!source.value(type))
+        return false;
+      auto meta = global_meta_object(type);
+      if (meta == nullptr) {
+        source.emplace_error(error_code::unknown_type);
+        return false;
+      }
+      metas.emplace_back(meta);
+    }
+    result.data_ = allocate(make_span(metas));
+    // Construct all elements up front so that destroying `result` on error
+    // stays simple.
+    for (size_t index = 0; index < count; ++index) {
+      metas[index]->default_construct(result.get_mutable(index));
+      ++result.hdr().constructed;
+    }
+    for (size_t index = 0; index < count; ++index)
+      if (!metas[index]->load(source, result.get_mutable(index)))
+        return false;
+  }
+  swap(result);
+  return source.end_sequence();
+}
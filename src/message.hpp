@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "binary_deserializer.hpp"
+#include "binary_serializer.hpp"
+#include "meta_object.hpp"
+#include "span.hpp"
+#include "type_id.hpp"
+
+/// Type-erased tuple of values with type IDs. The header and all elements
+/// share a single allocation:
+///
+///   header | meta objects | element offsets | type IDs | elements
+///
+/// Messages serialize as the number of elements, the type IDs of all elements
+/// and then the values. Loading looks up the meta objects of the received type
+/// IDs via `global_meta_object` and allocates once before reading any value.
+class message {
+public:
+  message() noexcept : data_(nullptr) {}
+
+  message(const message &other);
+
+  message(message &&other) noexcept : data_(other.data_) {
+    other.data_ = nullptr;
+  }
+
+  message &operator=(const message &other) {
+    message tmp{other};
+    swap(tmp);
+    return *this;
+  }
+
+  message &operator=(message &&other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~message();
+
+  /// Creates a message holding copies of `xs`.
+  template <class... Ts> static message make(Ts &&... xs) {
+    message result;
+    if constexpr (sizeof...(Ts) > 0) {
+      const meta_object *metas[] = {&meta_object_for<std::decay_t<Ts>>()...};
+      result.data_ = allocate(make_span(metas));
+      (result.emplace_next<std::decay_t<Ts>>(std::forward<Ts>(xs)), ...);
+    }
+    return result;
+  }
+
+  void swap(message &other) noexcept { std::swap(data_, other.data_); }
+
+  size_t size() const noexcept {
+    return data_ != nullptr ? hdr().size : 0;
+  }
+
+  bool empty() const noexcept { return size() == 0; }
+
+  /// Returns the type IDs of all elements.
+  span<const type_id_t> types() const noexcept {
+    return data_ != nullptr ? make_span(type_ids(), size())
+                            : span<const type_id_t>{};
+  }
+
+  type_id_t type_at(size_t index) const noexcept {
+    assert(index < size());
+    return type_ids()[index];
+  }
+
+  /// Checks whether the elements have exactly the types `Ts`.
+  template <class... Ts> bool match_elements() const noexcept {
+    if (size() != sizeof...(Ts))
+      return false;
+    size_t index = 0;
+    return (... && (type_ids()[index++] == type_id_v<Ts>));
+  }
+
+  const void *get(size_t index) const noexcept {
+    assert(index < size());
+    return data_ + offsets()[index];
+  }
+
+  void *get_mutable(size_t index) noexcept {
+    assert(index < size());
+    return data_ + offsets()[index];
+  }
+
+  template <class T> const T &get_as(size_t index) const noexcept {
+    assert(type_at(index) == type_id_v<T>);
+    return *static_cast<const T *>(get(index));
+  }
+
+  template <class T> T &get_mutable_as(size_t index) noexcept {
+    assert(type_at(index) == type_id_v<T>);
+    return *static_cast<T *>(get_mutable(index));
+  }
+
+  bool save(binary_serializer &sink) const;
+
+  /// Replaces the content of this message with a message from `source`. Leaves
+  /// this message unchanged on error.
+  bool load(binary_deserializer &source);
+
+private:
+  struct header {
+    size_t size;
+    size_t alignment;   // of the allocation
+    size_t total;       // size of the allocation in bytes
+    size_t constructed; // number of elements constructed so far
+  };
+
+  /// Allocates a block for elements of types `metas` and fills the header
+  /// without constructing any element.
+  static std::byte *allocate(span<const meta_object *const> metas);
+
+  const header &hdr() const noexcept {
+    return *reinterpret_cast<const header *>(data_);
+  }
+
+  header &hdr() noexcept { return *reinterpret_cast<header *>(data_); }
+
+  /// Constructs the first element that is not constructed yet. The destructor
+  /// only destroys constructed elements, so a throwing constructor leaks
+  /// nothing.
+  template <class T, class... Args> void emplace_next(Args &&... args) {
+    new (get_mutable(hdr().constructed)) T(std::forward<Args>(args)...);
+    ++hdr().constructed;
+  }
+
+  const meta_object *const *metas() const noexcept {
+    return reinterpret_cast<const meta_object *const *>(data_ +
+                                                        sizeof(header));
+  }
+
+  const size_t *offsets() const noexcept {
+    return reinterpret_cast<const size_t *>(metas() + hdr().size);
+  }
+
+  const type_id_t *type_ids() const noexcept {
+    return reinterpret_cast<const type_id_t *>(offsets() + hdr().size);
+  }
+
+  std::byte *data_;
+};
+
+inline bool inspect(binary_serializer &f, message &x) { return x.save(f); }
+
+inline bool inspect(binary_deserializer &f, message &x) { return x.load(f); }
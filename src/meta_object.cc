@@ -0,0 +1,30 @@
+#include <vector>
+
+#include "meta_object.hpp"
+
+#define META_OBJECT(name) result[type_id_v<name>] = &meta_object_for<name>();
+
+static std::vector<const meta_object *> builtin_meta_objects() {
+  std::vector<const meta_object *> result(UType::T_END);
+  Lists(META_OBJECT);
+  return result;
+}
+
+#undef META_OBJECT
+
+static std::vector<const meta_object *> &meta_objects() {
+  static std::vector<const meta_object *> table = builtin_meta_objects();
+  return table;
+}
+
+const meta_object *global_meta_object(type_id_t type) noexcept {
+  auto &table = meta_objects();
+  return type < table.size() ? table[type] : nullptr;
+}
+
+void register_meta_object(const meta_object &meta) {
+  auto &table = meta_objects();
+  if (meta.type >= table.size())
+    table.resize(meta.type + size_t{1});
+  table[meta.type] = &meta;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <string_view>
+
+#include "binary_deserializer.hpp"
+#include "binary_serializer.hpp"
+#include "type_id.hpp"
+
+/// Type-erased operations of a type with a type ID. Allows code that only
+/// knows the ID of a type at runtime to create, copy, destroy and serialize
+/// values of that type in raw memory.
+struct meta_object {
+  type_id_t type;
+  std::string_view type_name;
+  size_t size;
+  size_t alignment;
+  void (*default_construct)(void *ptr);
+  void (*copy_construct)(void *ptr, const void *src);
+  void (*destroy)(void *ptr) noexcept;
+  bool (*save)(binary_serializer &sink, const void *ptr);
+  bool (*load)(binary_deserializer &source, void *ptr);
+};
+
+/// Returns the meta object for `T`.
+template <class T> const meta_object &meta_object_for() {
+  static_assert(has_type_id_v<T>, "meta objects require a type ID");
+  static const meta_object result{
+      type_id_v<T>,
+      type_name_or_anonymous<T>(),
+      sizeof(T),
+      alignof(T),
+      [](void *ptr) { new (ptr) T(); },
+      [](void *ptr, const void *src) {
+        new (ptr) T(*static_cast<const T *>(src));
+      },
+      [](void *ptr) noexcept { static_cast<T *>(ptr)->~T(); },
+      [](binary_serializer &sink, const void *ptr) {
+        return sink.apply(*static_cast<const T *>(ptr));
+      },
+      [](binary_deserializer &source, void *ptr) {
+        return source.apply(*static_cast<T *>(ptr));
+      },
+  };
+  return result;
+}
+
+/// Returns the registered meta object for `type` or `nullptr`. All types in
+/// `Lists` are registered by default.
+const meta_object *global_meta_object(type_id_t type) noexcept;
+
+/// Adds `meta` to the registry, replacing any previous entry for its type.
+/// Not thread-safe: register custom types at startup before other threads
+/// look up meta objects.
+void register_meta_object(const meta_object &meta);
+
+template <class T> void register_meta_object() {
+  register_meta_object(meta_object_for<T>());
+}
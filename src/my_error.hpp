@@ -15,6 +15,8 @@ enum error_code : int32_t {
   unsupported_operation,
   end_of_stream,
   invalid_argument,
+  checksum_mismatch,
+  unknown_type,
   error_num
 };
 using error = int32_t;
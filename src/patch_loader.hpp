@@ -0,0 +1,240 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "binary_deserializer.hpp"
+#include "inspector_access.hpp"
+#include "load_inspector.hpp"
+#include "load_inspector_base.hpp"
+#include "span.hpp"
+#include "type_id.hpp"
+
+/// Applies a patch of `diff_inspector` to an object, e.g.,
+/// `loader.apply(x)`. Only loads the changed fields and list elements, all
+/// other values of the object keep their state. The object must be equal to
+/// the old version of the patch. Errors in the input get stored in the
+/// `binary_deserializer`.
+class patch_loader final : public load_inspector_base<patch_loader> {
+public:
+  using super = load_inspector_base<patch_loader>;
+
+  explicit patch_loader(binary_deserializer &source) noexcept
+      : source_(source), patching_object_(false), patching_field_(false) {}
+
+  static constexpr bool has_human_readable_format() noexcept { return false; }
+
+  // -- DSL --------------------------------------------------------------------
+
+  template <class LoadCallback> struct object_t {
+    patch_loader *f;
+    LoadCallback load_callback;
+
+    template <class... Fields> bool fields(Fields &&... fs) {
+      return f->object_fields(std::index_sequence_for<Fields...>{}, fs...) &&
+             f->run_callback(load_callback);
+    }
+
+    object_t &&pretty_name(std::string_view) && { return std::move(*this); }
+
+    template <class F> object_t &&on_save(F &&) && { return std::move(*this); }
+
+    template <class F> auto on_load(F fun) && {
+      return object_t<F>{f, std::move(fun)};
+    }
+  };
+
+  template <class T> auto object(T &) noexcept {
+    auto no_callback = [] { return true; };
+    return object_t<decltype(no_callback)>{this, no_callback};
+  }
+
+  // -- inspector interface ----------------------------------------------------
+
+  bool begin_field(std::string_view name) { return source_.begin_field(name); }
+
+  bool begin_field(std::string_view name, bool &is_present) {
+    patching_field_ = false;
+    return source_.begin_field(name, is_present);
+  }
+
+  bool begin_field(std::string_view name, span<const type_id_t> types,
+                   size_t &index) {
+    patching_field_ = false;
+    return source_.begin_field(name, types, index);
+  }
+
+  bool begin_field(std::string_view name, bool &is_present,
+                   span<const type_id_t> types, size_t &index) {
+    patching_field_ = false;
+    return source_.begin_field(name, is_present, types, index);
+  }
+
+  bool end_field() {
+    patching_field_ = false;
+    return source_.end_field();
+  }
+
+  bool begin_tuple(size_t size) {
+    patching_field_ = false;
+    return source_.begin_tuple(size);
+  }
+
+  bool end_tuple() { return source_.end_tuple(); }
+
+  bool begin_key_value_pair() { return source_.begin_key_value_pair(); }
+
+  bool end_key_value_pair() { return source_.end_key_value_pair(); }
+
+  bool begin_sequence(size_t &size) { return source_.begin_sequence(size); }
+
+  bool end_sequence() { return source_.end_sequence(); }
+
+  bool begin_associative_array(size_t &size) {
+    patching_field_ = false;
+    return source_.begin_associative_array(size);
+  }
+
+  bool end_associative_array() { return source_.end_associative_array(); }
+
+  template <class T> bool value(T &x) { return source_.value(x); }
+
+  /// Updates the changed elements of lists that kept their size and loads
+  /// all other lists as a whole.
+  template <class T> bool list(T &xs) {
+    if constexpr (is_patchable_list<patch_loader, T>()) {
+      if (std::exchange(patching_field_, false))
+        return patch_list(xs);
+    }
+    return super::list(xs);
+  }
+
+private:
+  template <class F> bool run_callback(F &callback) {
+    using result_type = decltype(callback());
+    if constexpr (std::is_same<result_type, bool>::value) {
+      if (!callback()) {
+        set_error(load_callback_failed);
+        return false;
+      }
+    } else {
+      if (auto err = callback()) {
+        set_error(std::move(err));
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <class... Fields, size_t... Is>
+  bool object_fields(std::index_sequence<Is...>, Fields &... fs) {
+    patching_field_ = false;
+    auto code = uint64_t{0};
+    if (!read_code(code))
+      return false;
+    // Objects in replaced values have the code 0 and contain all fields.
+    auto patching_object = std::exchange(patching_object_, code != 0);
+    auto mask = code - 1;
+    auto result = code == 0
+                      ? (load_object_field(fs) && ...)
+                      : ((!is_changed<Is>(mask) || load_object_field(fs)) &&
+                         ...);
+    patching_object_ = patching_object;
+    return result;
+  }
+
+  /// Loads a field of the current object. Only plain fields of a patch may
+  /// contain list patches, `diff_inspector` saves virtual fields and fields
+  /// with a fallback as a whole.
+  template <class Field> bool load_object_field(Field &fld) {
+    patching_field_ = patching_object_ && is_plain_field<Field>::value;
+    return fld(*this);
+  }
+
+  template <class T> bool patch_list(T &xs) {
+    using value_type = typename T::value_type;
+    size_t size = 0;
+    if (!begin_sequence(size))
+      return false;
+    if (size != xs.size()) {
+      // The list changed its size and contains all elements.
+      xs.clear();
+      for (size_t i = 0; i < size; ++i) {
+        auto val = value_type{};
+        if (!load(*this, val))
+          return false;
+        xs.insert(xs.end(), std::move(val));
+      }
+      return end_sequence();
+    }
+    auto x = xs.begin();
+    size_t index = 0;
+    for (;;) {
+      // Reads the number of unchanged elements plus one, 0 ends the list.
+      size_t code = 0;
+      if (!begin_sequence(code))
+        return false;
+      if (code == 0)
+        return end_sequence();
+      if (code > size - index) {
+        source_.emplace_error(error_code::invalid_argument,
+                              "list patch out of bounds");
+        return false;
+      }
+      std::advance(x, code - 1);
+      index += code;
+      if constexpr (std::is_same<decltype(*x), value_type &>::value) {
+        if (!load(*this, *x))
+          return false;
+      } else {
+        // Assigns proxy references such as the ones of `std::vector<bool>`.
+        auto tmp = value_type{};
+        if (!load(*this, tmp))
+          return false;
+        *x = tmp;
+      }
+      ++x;
+    }
+  }
+
+  template <class Field> struct is_plain_field : std::false_type {};
+
+  template <class T>
+  struct is_plain_field<load_inspector::field_t<T>> : std::true_type {};
+
+  // Saving ignores invariants, so these are plain fields for diff_inspector.
+  template <class T, class Predicate>
+  struct is_plain_field<load_inspector::field_with_invariant_t<T, Predicate>>
+      : std::true_type {};
+
+  template <size_t I> static constexpr bool is_changed(uint64_t mask) {
+    if constexpr (I < patch_mask_bits)
+      return ((mask >> I) & 1) != 0;
+    else
+      return true;
+  }
+
+  /// Reads the varbyte encoded `mask + 1` at the start of an object.
+  bool read_code(uint64_t &code) {
+    code = 0;
+    auto low7 = uint8_t{0};
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (!source_.value(low7))
+        return false;
+      code |= static_cast<uint64_t>(low7 & 0x7F) << shift;
+      if ((low7 & 0x80) == 0)
+        return true;
+    }
+    source_.emplace_error(error_code::invalid_argument, "invalid field mask");
+    return false;
+  }
+
+  binary_deserializer &source_;
+  bool patching_object_; // whether the current object is a patch
+  bool patching_field_;  // whether the next list is a field of a patch
+};
@@ -0,0 +1,398 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "binary_deserializer.hpp"
+#include "inspector_access.hpp"
+#include "load_inspector.hpp"
+#include "load_inspector_base.hpp"
+#include "my_error.hpp"
+#include "span.hpp"
+#include "type_id.hpp"
+
+/// Loads a value from input that arrives in pieces, e.g., for
+/// `incremental_deserializer`. Each call to `resume` walks the value as far
+/// as the input reaches and stops when it runs out. The partially loaded
+/// value stays valid between the calls: objects, lists and maps record their
+/// progress on a stack of frames, and the next walk skips their completed
+/// fields, elements and entries without touching them again. All other
+/// values, e.g., numbers, strings, optional values, variants and pointers,
+/// get loaded as a whole. A walk that stops inside of one continues at its
+/// first byte, so the input for the next call must start at the first byte
+/// that `consumed` does not cover.
+///
+/// Supports the default encoding of `binary_serializer`. The `inspect`
+/// overloads must describe objects, i.e., list their fields with
+/// `object(x).fields(...)`. Objects inside of values that get loaded as a
+/// whole may run their `on_load` callbacks again after such a restart.
+class resumable_loader final : public load_inspector_base<resumable_loader> {
+public:
+  using super = load_inspector_base<resumable_loader>;
+
+  resumable_loader() noexcept
+      : input_(nullptr), mark_(nullptr), offset_(0), limit_(0), level_(0),
+        atomic_(0), last_(false), suspended_(false) {}
+
+  static constexpr bool has_human_readable_format() noexcept { return false; }
+
+  /// Starts loading a new value of at most `limit` bytes.
+  void start(size_t limit) {
+    frames_.clear();
+    shared_.clear();
+    offset_ = 0;
+    limit_ = limit;
+    set_error(error_code::success);
+  }
+
+  /// Continues loading `x` from `input`, which follows the bytes that
+  /// previous calls consumed. Returns `true` once `x` is complete. Returns
+  /// `false` if `x` needs more input, in which case `suspended()` returns
+  /// `true`, or on error. Running out of input is an error if `last` is
+  /// `true`, i.e., if `input` reaches the end of the value or the limit.
+  template <class T> bool resume(T &x, span<const std::byte> input, bool last) {
+    source_.reset(input);
+    source_.set_error(error_code::success);
+    input_ = input.data();
+    mark_ = input_;
+    level_ = 0;
+    atomic_ = 0;
+    last_ = last;
+    suspended_ = false;
+    bool result;
+    if constexpr (is_resumable<T>())
+      result = load(*this, x);
+    else
+      result = unit([this, &x] { return load(*this, x); });
+    if (result)
+      mark_ = source_.current();
+    offset_ += consumed();
+    if (!result && !suspended_ && !get_error())
+      set_error(source_.move_error());
+    return result;
+  }
+
+  /// Returns whether the last call to `resume` ran out of input.
+  bool suspended() const noexcept { return suspended_; }
+
+  /// Returns the number of bytes that the last call to `resume` consumed.
+  size_t consumed() const noexcept {
+    return static_cast<size_t>(mark_ - input_);
+  }
+
+  /// Returns the number of bytes of the value that all calls to `resume`
+  /// consumed since `start`.
+  size_t offset() const noexcept { return offset_; }
+
+  /// Returns how many more bytes the value may take up to the limit.
+  /// Identifies the positions of shared objects across calls to `resume`.
+  size_t remaining() const noexcept {
+    auto pos = offset_ + static_cast<size_t>(source_.current() - input_);
+    return limit_ - pos;
+  }
+
+  /// Registers the shared object `ptr` of type `type` for the pointer at the
+  /// read position with `pos` remaining bytes.
+  void add_shared_object(size_t pos, const void *type,
+                         std::shared_ptr<void> ptr) {
+    shared_[pos] = shared_entry{type, std::move(ptr)};
+  }
+
+  /// Returns the shared object of the pointer `distance` bytes before the
+  /// read position with `pos` remaining bytes or null if there is no such
+  /// pointer or if its object has a type other than `type`.
+  std::shared_ptr<void> shared_object(size_t pos, size_t distance,
+                                      const void *type) const {
+    if (distance > std::numeric_limits<size_t>::max() - pos)
+      return nullptr;
+    auto i = shared_.find(pos + distance);
+    if (i == shared_.end() || i->second.type != type)
+      return nullptr;
+    return i->second.ptr;
+  }
+
+  /// Releases all shared objects.
+  void clear_shared_objects() noexcept { shared_.clear(); }
+
+  // -- DSL --------------------------------------------------------------------
+
+  template <class LoadCallback> struct object_t {
+    resumable_loader *f;
+    LoadCallback load_callback;
+
+    template <class... Fields> bool fields(Fields &&... fs) {
+      return f->object_fields(std::index_sequence_for<Fields...>{}, fs...) &&
+             f->run_callback(load_callback);
+    }
+
+    object_t &&pretty_name(std::string_view) && { return std::move(*this); }
+
+    template <class F> object_t &&on_save(F &&) && { return std::move(*this); }
+
+    template <class F> auto on_load(F fun) && {
+      return object_t<F>{f, std::move(fun)};
+    }
+  };
+
+  template <class T> auto object(T &) noexcept {
+    auto no_callback = [] { return true; };
+    return object_t<decltype(no_callback)>{this, no_callback};
+  }
+
+  // -- inspector interface ----------------------------------------------------
+
+  bool begin_field(std::string_view name) { return source_.begin_field(name); }
+
+  bool begin_field(std::string_view name, bool &is_present) {
+    return source_.begin_field(name, is_present);
+  }
+
+  bool begin_field(std::string_view name, span<const type_id_t> types,
+                   size_t &index) {
+    return source_.begin_field(name, types, index);
+  }
+
+  bool begin_field(std::string_view name, bool &is_present,
+                   span<const type_id_t> types, size_t &index) {
+    return source_.begin_field(name, is_present, types, index);
+  }
+
+  bool end_field() { return source_.end_field(); }
+
+  bool begin_tuple(size_t size) { return source_.begin_tuple(size); }
+
+  bool end_tuple() { return source_.end_tuple(); }
+
+  bool begin_key_value_pair() { return source_.begin_key_value_pair(); }
+
+  bool end_key_value_pair() { return source_.end_key_value_pair(); }
+
+  bool begin_sequence(size_t &size) { return source_.begin_sequence(size); }
+
+  bool end_sequence() { return source_.end_sequence(); }
+
+  bool begin_associative_array(size_t &size) {
+    return source_.begin_associative_array(size);
+  }
+
+  bool end_associative_array() { return source_.end_associative_array(); }
+
+  template <class T> bool value(T &x) { return source_.value(x); }
+
+  /// Loads a list element by element and keeps the loaded elements when the
+  /// input runs out.
+  template <class T> bool list(T &xs) {
+    if (atomic_ > 0)
+      return super::list(xs);
+    using value_type = typename T::value_type;
+    auto i = enter();
+    if (!frames_[i].started) {
+      xs.clear();
+      size_t size = 0;
+      if (!unit([this, &size] { return begin_sequence(size); }))
+        return false;
+      frames_[i].size = size;
+      frames_[i].started = true;
+    }
+    while (frames_[i].done < frames_[i].size) {
+      auto val = take_pending<value_type>(i);
+      if (!element(val)) {
+        if constexpr (is_resumable<value_type>())
+          keep_pending(i, val);
+        return false;
+      }
+      xs.insert(xs.end(), std::move(val));
+      ++frames_[i].done;
+    }
+    leave(i);
+    return end_sequence();
+  }
+
+  /// Loads a map entry by entry and keeps the loaded entries when the input
+  /// runs out.
+  template <class T> bool map(T &xs) {
+    if (atomic_ > 0)
+      return super::map(xs);
+    using entry = std::pair<typename T::key_type, typename T::mapped_type>;
+    auto i = enter();
+    if (!frames_[i].started) {
+      xs.clear();
+      size_t size = 0;
+      if (!unit([this, &size] { return begin_associative_array(size); }))
+        return false;
+      frames_[i].size = size;
+      frames_[i].started = true;
+    }
+    while (frames_[i].done < frames_[i].size) {
+      auto kv = take_pending<entry>(i);
+      if (!frames_[i].has_key) {
+        auto load_key = [this, &kv] {
+          return begin_key_value_pair() && load(*this, kv.first);
+        };
+        if (!unit(load_key))
+          return false;
+        frames_[i].has_key = true;
+      }
+      if (!element(kv.second)) {
+        keep_pending(i, kv);
+        return false;
+      }
+      if (!end_key_value_pair())
+        return false;
+      // A multimap returns an iterator, a regular map returns a pair.
+      auto emplace_result = xs.emplace(std::move(kv.first),
+                                       std::move(kv.second));
+      if constexpr (is_pair<decltype(emplace_result)>::value) {
+        if (!emplace_result.second) {
+          emplace_error(error_code::runtime_error, "multiple key definitions");
+          return false;
+        }
+      }
+      frames_[i].has_key = false;
+      ++frames_[i].done;
+    }
+    leave(i);
+    return end_associative_array();
+  }
+
+private:
+  /// Progress of an object, list or map on the path to the read position.
+  struct frame {
+    size_t done;  // number of loaded fields, elements or entries
+    size_t size;  // number of elements or entries of a list or map
+    bool started; // whether the size of a list or map has been read
+    bool has_key; // whether the key of the pending entry has been loaded
+    std::shared_ptr<void> pending; // element or entry under construction
+  };
+
+  struct shared_entry {
+    const void *type;
+    std::shared_ptr<void> ptr;
+  };
+
+  /// Checks whether `T` records its progress between calls to `resume`.
+  template <class T> static constexpr bool is_resumable() {
+    if constexpr (is_complete<inspector_access<T>>) {
+      return false;
+    } else {
+      using access_type =
+          decltype(inspect_access_type<resumable_loader, T>());
+      return std::is_same<access_type, inspector_access_type::inspect>::value ||
+             std::is_same<access_type, inspector_access_type::list>::value ||
+             std::is_same<access_type, inspector_access_type::map>::value;
+    }
+  }
+
+  template <class Field> struct is_resumable_field : std::false_type {};
+
+  template <class T>
+  struct is_resumable_field<load_inspector::field_t<T>>
+      : std::bool_constant<is_resumable<T>()> {};
+
+  template <class F> bool run_callback(F &callback) {
+    using result_type = decltype(callback());
+    if constexpr (std::is_same<result_type, bool>::value) {
+      if (!callback()) {
+        set_error(load_callback_failed);
+        return false;
+      }
+    } else {
+      if (auto err = callback()) {
+        set_error(std::move(err));
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <class... Fields, size_t... Is>
+  bool object_fields(std::index_sequence<Is...>, Fields &... fs) {
+    if (atomic_ > 0)
+      return (fs(*this) && ...);
+    auto i = enter();
+    if (!((Is < frames_[i].done || object_field(i, fs)) && ...))
+      return false;
+    leave(i);
+    return true;
+  }
+
+  template <class Field> bool object_field(size_t i, Field &fld) {
+    if constexpr (is_resumable_field<Field>::value) {
+      if (!fld(*this))
+        return false;
+    } else {
+      if (!unit([this, &fld] { return fld(*this); }))
+        return false;
+    }
+    ++frames_[i].done;
+    return true;
+  }
+
+  template <class T> bool element(T &x) {
+    if constexpr (is_resumable<T>())
+      return load(*this, x);
+    else
+      return unit([this, &x] { return load(*this, x); });
+  }
+
+  /// Loads a value as a whole. Moves the resume point past the value on
+  /// success and leaves it at the start of the value if the input runs out.
+  template <class F> bool unit(F fn) {
+    ++atomic_;
+    auto result = fn();
+    --atomic_;
+    if (result) {
+      mark_ = source_.current();
+      return true;
+    }
+    suspended_ = source_.truncated() && !last_;
+    return false;
+  }
+
+  /// Returns the frame of the object, list or map at the current nesting
+  /// level, which exists if a previous walk stopped inside of it.
+  size_t enter() {
+    if (level_ == frames_.size())
+      frames_.push_back(frame{0, 0, false, false, nullptr});
+    return level_++;
+  }
+
+  void leave(size_t i) {
+    frames_.pop_back();
+    level_ = i;
+  }
+
+  template <class T> T take_pending(size_t i) {
+    auto &ptr = frames_[i].pending;
+    if (!ptr)
+      return T{};
+    auto result = std::move(*static_cast<T *>(ptr.get()));
+    ptr.reset();
+    return result;
+  }
+
+  template <class T> void keep_pending(size_t i, T &x) {
+    if (suspended_)
+      frames_[i].pending = std::make_shared<T>(std::move(x));
+  }
+
+  binary_deserializer source_;
+  const std::byte *input_; // start of the input of the current walk
+  const std::byte *mark_;  // the next walk continues here
+  size_t offset_;          // bytes consumed before `input_`
+  size_t limit_;           // maximum size of the value
+  size_t level_;           // nesting level of objects, lists and maps
+  size_t atomic_;          // nesting level of values loaded as a whole
+  bool last_;              // whether the input ends the value
+  bool suspended_;         // whether the walk ran out of input
+  std::vector<frame> frames_;
+  // shared objects by the remaining bytes at their first pointer
+  std::unordered_map<size_t, shared_entry> shared_;
+};
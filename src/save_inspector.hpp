@@ -4,6 +4,7 @@
 #include <string_view>
 #include <utility>
 
+#include "delta_packed.hpp"
 #include "inspector_access.hpp"
 #include "my_error.hpp"
 
@@ -39,6 +40,8 @@ public:
     U fallback;
 
     // Inspector: binary_serialize
+    static constexpr size_t presence_flags = optional_field_presence_flags<T>();
+
     template <class Inspector> bool operator()(Inspector &f) {
       auto is_present = [this] { return *val != fallback; };
       auto get = [this] { return *val; };
@@ -51,10 +54,24 @@ public:
     }
   };
 
+  template <class T> struct delta_packed_field_t {
+    std::string_view field_name;
+    T *val;
+
+    static constexpr size_t presence_flags = 0;
+
+    template <class Inspector> bool operator()(Inspector &f) {
+      return f.begin_field(field_name) && save_delta_packed(f, *val) &&
+             f.end_field();
+    }
+  };
+
   template <class T> struct field_t {
     std::string_view field_name;
     T *val;
 
+    static constexpr size_t presence_flags = field_presence_flags<T>();
+
     template <class Inspector> bool operator()(Inspector &f) {
       return save_field(f, field_name, *val);
     }
@@ -63,6 +80,16 @@ public:
       return field_with_fallback_t<T, U>{field_name, val, std::move(value)};
     }
 
+    /// Stores the integers, durations or time points of a `std::vector` as
+    /// bit-packed deltas, e.g., for sorted IDs or timestamp series. See
+    /// `save_delta_packed` for the encoding.
+    auto delta_packed() && {
+      static_assert(is_delta_packed_list<T>::value,
+                    "delta_packed requires a std::vector of integers, "
+                    "durations or time points");
+      return delta_packed_field_t<T>{field_name, val};
+    }
+
     template <class Predicate> field_t &&invariant(Predicate &&) && {
       return std::move(*this);
     }
@@ -73,6 +100,8 @@ public:
     Get get;
     U fallback;
 
+    static constexpr size_t presence_flags = optional_field_presence_flags<T>();
+
     template <class Inspector> bool operator()(Inspector &f) {
       auto is_present = [this] { return get() != fallback; };
       return save_field(f, field_name, is_present, get);
@@ -88,6 +117,8 @@ public:
     std::string_view field_name;
     Get get;
 
+    static constexpr size_t presence_flags = field_presence_flags<T>();
+
     template <class Inspector> bool operator()(Inspector &f) {
       auto &&x = get();
       return save_field(f, field_name, as_mutable_ref(x));
@@ -111,6 +142,8 @@ public:
     IsPresent is_present;
     Get get;
 
+    static constexpr size_t presence_flags = optional_field_presence_flags<T>();
+
     template <class Inspector> bool operator()(Inspector &f) {
       return save_field(f, field_name, is_present, get);
     }
@@ -125,7 +158,8 @@ public:
 
     template <class... Fields> bool fields(Fields &&... fs) {
       using save_callback_result = decltype(save_callback());
-      if (!(f->begin_object(object_type, object_name) && (fs(*f) && ...)))
+      if (!(begin_object_fields<Fields...>(*f, object_type, object_name) &&
+            (fs(*f) && ...)))
         return false;
       if constexpr (std::is_same<save_callback_result, bool>::value) {
         if (!save_callback()) {
@@ -138,7 +172,7 @@ public:
           return false;
         }
       }
-      return f->end_object();
+      return end_object_fields(*f);
     }
 
     auto pretty_name(std::string_view name) && { return object_t{name, f}; }
@@ -154,9 +188,9 @@ public:
     Inspector *f;
 
     template <class... Fields> bool fields(Fields &&... fs) {
-      return f->begin_object(object_type, object_name) //
-             && (fs(*f) && ...)                        //
-             && f->end_object();
+      return begin_object_fields<Fields...>(*f, object_type, object_name) //
+             && (fs(*f) && ...)                                          //
+             && end_object_fields(*f);
     }
 
     auto pretty_name(std::string_view name) && {
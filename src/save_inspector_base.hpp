@@ -2,13 +2,46 @@
 // This file is part of CAF, the C++ Actor Framework. See the file LICENSE in
 #pragma once
 
+#include <algorithm>
+#include <functional>
 #include <string_view>
 #include <tuple>
+#include <type_traits>
+#include <vector>
 
+#include "columnar_lists.hpp"
 #include "inspector_access.hpp"
 #include "save_inspector.hpp"
 #include "type_id.hpp"
 
+/// Checks whether `T` is ordered by `std::less` of its key type.
+template <class T, class = void> struct is_sorted_by_less : std::false_type {};
+
+template <class T>
+struct is_sorted_by_less<T, std::void_t<typename T::key_compare>>
+    : std::disjunction<
+          std::is_same<typename T::key_compare, std::less<>>,
+          std::is_same<typename T::key_compare,
+                       std::less<typename T::key_type>>> {};
+
+/// Checks whether `std::less<>` can compare two values of type `T`.
+template <class T, class = void>
+struct is_less_comparable : std::false_type {};
+
+template <class T>
+struct is_less_comparable<
+    T, std::void_t<decltype(std::declval<const T &>() <
+                            std::declval<const T &>())>> : std::true_type {};
+
+template <class Inspector, class = void>
+struct has_indexed_maps : std::false_type {};
+
+template <class Inspector>
+struct has_indexed_maps<
+    Inspector,
+    std::void_t<decltype(std::declval<Inspector &>().indexed_maps())>>
+    : std::true_type {};
+
 // subtype inherit the class, here is binary_serialize class
 template <class Subtype> class save_inspector_base : public save_inspector {
 public:
@@ -31,6 +64,10 @@ public:
 
   // where T = (member type) value_type + size(): list + vector
   template <class T> bool list(const T &xs) {
+    if constexpr (is_columnar_list<Subtype, T>()) {
+      if (dref().columnar_lists())
+        return save_columnar_list(dref(), xs);
+    }
     using value_type = typename T::value_type;
     auto size = xs.size();
     if (!dref().begin_sequence(size)) /*add size to the first*/
@@ -52,18 +89,48 @@ public:
 
   // where T = map; serialize a map
   template <class T> bool map(const T &xs) {
+    if constexpr (has_indexed_maps<Subtype>::value &&
+                  !is_sorted_by_less<T>::value &&
+                  !is_less_comparable<typename T::key_type>::value) {
+      if (dref().indexed_maps()) {
+        emplace_error(error_code::unsupported_operation,
+                      "indexed maps require keys with operator<");
+        return false;
+      }
+    }
     if (!dref().begin_associative_array(xs.size())) /*begin_sequence(size)*/
       return false;
-    for (auto &&kvp : xs) {
-      if (!(dref().begin_key_value_pair()    /*return true*/
-            && save(dref(), kvp.first)       //
-            && save(dref(), kvp.second)      //
-            && dref().end_key_value_pair())) /*return true*/
-        return false;
+    if constexpr (has_indexed_maps<Subtype>::value &&
+                  !is_sorted_by_less<T>::value &&
+                  is_less_comparable<typename T::key_type>::value) {
+      // Indexed maps store their entries sorted by key.
+      if (dref().indexed_maps()) {
+        std::vector<const typename T::value_type *> entries;
+        entries.reserve(xs.size());
+        for (auto &&kvp : xs)
+          entries.push_back(&kvp);
+        std::sort(entries.begin(), entries.end(), [](auto x, auto y) {
+          return std::less<>{}(x->first, y->first);
+        });
+        for (auto entry : entries)
+          if (!map_entry(*entry))
+            return false;
+        return dref().end_associative_array();
+      }
     }
+    for (auto &&kvp : xs)
+      if (!map_entry(kvp))
+        return false;
     return dref().end_associative_array();
   }
 
+  template <class KeyValuePair> bool map_entry(const KeyValuePair &kvp) {
+    return dref().begin_key_value_pair()    /*return true*/
+           && save(dref(), kvp.first)       //
+           && save(dref(), kvp.second)      //
+           && dref().end_key_value_pair(); /*return true*/
+  }
+
   // where T = tuple
   template <class T, size_t... Is>
   bool tuple(const T &xs, std::index_sequence<Is...>) {
@@ -0,0 +1,137 @@
+#include "schema_fingerprint.hpp"
+
+void schema_hasher::add(uint64_t x) noexcept {
+  // Process the bytes in a fixed order to get the same hash on all platforms.
+  for (int i = 0; i < 8; ++i) {
+    hash_ ^= (x >> (8 * i)) & 0xFF;
+    hash_ *= 1099511628211ull;
+  }
+}
+
+void schema_hasher::add(std::string_view x) noexcept {
+  add(x.size());
+  for (auto c : x) {
+    hash_ ^= static_cast<uint8_t>(c);
+    hash_ *= 1099511628211ull;
+  }
+}
+
+void schema_hasher::add(span<const type_id_t> types) noexcept {
+  add(types.size());
+  for (auto type : types)
+    add(type);
+}
+
+bool schema_hasher::primitive(type_id_t type) noexcept {
+  add(tag::primitive);
+  add(type);
+  return true;
+}
+
+bool schema_hasher::fetch_next_object_type(type_id_t &type) noexcept {
+  type = invalid_type_id;
+  emplace_error(error_code::unsupported_operation,
+                "schema_hasher does not read type information");
+  return false;
+}
+
+bool schema_hasher::begin_object(type_id_t type,
+                                 std::string_view name) noexcept {
+  add(tag::object);
+  add(type);
+  add(name);
+  return true;
+}
+
+bool schema_hasher::end_object() noexcept {
+  add(tag::end_object);
+  return true;
+}
+
+bool schema_hasher::begin_field(std::string_view name) noexcept {
+  add(tag::field);
+  add(name);
+  return true;
+}
+
+bool schema_hasher::begin_field(std::string_view name,
+                                bool &is_present) noexcept {
+  add(tag::optional_field);
+  add(name);
+  is_present = true;
+  return true;
+}
+
+bool schema_hasher::begin_field(std::string_view name,
+                                span<const type_id_t> types,
+                                size_t &index) noexcept {
+  add(tag::variant_field);
+  add(name);
+  add(types);
+  index = 0;
+  return true;
+}
+
+bool schema_hasher::begin_field(std::string_view name, bool &is_present,
+                                span<const type_id_t> types,
+                                size_t &index) noexcept {
+  add(tag::optional_field);
+  add(tag::variant_field);
+  add(name);
+  add(types);
+  is_present = true;
+  index = 0;
+  return true;
+}
+
+bool schema_hasher::begin_tuple(size_t size) noexcept {
+  add(tag::tuple);
+  add(size);
+  return true;
+}
+
+bool schema_hasher::end_tuple() noexcept {
+  add(tag::end_tuple);
+  return true;
+}
+
+bool schema_hasher::begin_sequence(size_t &list_size) noexcept {
+  add(tag::sequence);
+  list_size = depth_ < max_depth ? 1 : 0;
+  ++depth_;
+  return true;
+}
+
+bool schema_hasher::end_sequence() noexcept {
+  --depth_;
+  add(tag::end_sequence);
+  return true;
+}
+
+bool schema_hasher::begin_associative_array(size_t &size) noexcept {
+  add(tag::map);
+  size = depth_ < max_depth ? 1 : 0;
+  ++depth_;
+  return true;
+}
+
+bool schema_hasher::end_associative_array() noexcept {
+  --depth_;
+  add(tag::end_map);
+  return true;
+}
+
+bool schema_hasher::value(std::byte &) noexcept {
+  return primitive(type_id_v<uint8_t>);
+}
+
+bool schema_hasher::value(span<std::byte> x) noexcept {
+  add(tag::bytes);
+  add(x.size());
+  return true;
+}
+
+bool schema_hasher::value(std::vector<bool> &) noexcept {
+  add(tag::bits);
+  return true;
+}
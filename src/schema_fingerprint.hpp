@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "load_inspector_base.hpp"
+#include "my_error.hpp"
+#include "span.hpp"
+#include "type_def.h"
+#include "type_id.hpp"
+
+/// Computes a hash over the layout that `inspect` overloads describe instead
+/// of over values: object types and names, field names, primitive types,
+/// variant alternatives and container shapes. Runs the load path on
+/// default-constructed values and reports every sequence and map as holding
+/// a single element, so the walk visits each element type once. Variants
+/// contribute the type IDs and the layouts of all their alternatives.
+class schema_hasher final : public load_inspector_base<schema_hasher> {
+public:
+  /// Sequences nested deeper than this report no elements, which ends the
+  /// walk through recursive types.
+  static constexpr size_t max_depth = 32;
+
+  schema_hasher() noexcept : hash_(14695981039346656037ull), depth_(0) {}
+
+  uint64_t result() const noexcept { return hash_; }
+
+  static constexpr bool has_human_readable_format() noexcept { return false; }
+
+  /// Walks every alternative of a variant, not just the first one.
+  static constexpr bool visits_all_alternatives() noexcept { return true; }
+
+  bool fetch_next_object_type(type_id_t &type) noexcept;
+
+  bool begin_object(type_id_t type, std::string_view name) noexcept;
+
+  bool end_object() noexcept;
+
+  bool begin_field(std::string_view name) noexcept;
+
+  bool begin_field(std::string_view name, bool &is_present) noexcept;
+
+  bool begin_field(std::string_view name, span<const type_id_t> types,
+                   size_t &index) noexcept;
+
+  bool begin_field(std::string_view name, bool &is_present,
+                   span<const type_id_t> types, size_t &index) noexcept;
+
+  constexpr bool end_field() noexcept { return true; }
+
+  bool begin_tuple(size_t size) noexcept;
+
+  bool end_tuple() noexcept;
+
+  constexpr bool begin_key_value_pair() noexcept { return true; }
+
+  constexpr bool end_key_value_pair() noexcept { return true; }
+
+  bool begin_sequence(size_t &list_size) noexcept;
+
+  bool end_sequence() noexcept;
+
+  bool begin_associative_array(size_t &size) noexcept;
+
+  bool end_associative_array() noexcept;
+
+  bool value(std::byte &x) noexcept;
+
+  template <class T>
+  std::enable_if_t<std::is_integral<T>::value, bool> value(T &) noexcept {
+    return primitive(type_id_v<T>);
+  }
+
+  bool value(float &) noexcept { return primitive(type_id_v<float>); }
+
+  bool value(double &) noexcept { return primitive(type_id_v<double>); }
+
+  bool value(long double &) noexcept {
+    return primitive(type_id_v<l_double>);
+  }
+
+  bool value(std::string &) noexcept {
+    return primitive(type_id_v<stl_sting>);
+  }
+
+  bool value(std::u16string &) noexcept {
+    return primitive(type_id_v<stl_u16string>);
+  }
+
+  bool value(std::u32string &) noexcept {
+    return primitive(type_id_v<stl_u32string>);
+  }
+
+  bool value(span<std::byte> x) noexcept;
+
+  bool value(std::vector<bool> &x) noexcept;
+
+private:
+  enum class tag : uint8_t {
+    object,
+    end_object,
+    field,
+    optional_field,
+    variant_field,
+    tuple,
+    end_tuple,
+    sequence,
+    end_sequence,
+    map,
+    end_map,
+    primitive,
+    bytes,
+    bits,
+  };
+
+  bool primitive(type_id_t type) noexcept;
+
+  void add(tag x) noexcept { add(static_cast<uint64_t>(x)); }
+
+  void add(uint64_t x) noexcept;
+
+  void add(std::string_view x) noexcept;
+
+  void add(span<const type_id_t> types) noexcept;
+
+  uint64_t hash_; // FNV-1a
+  size_t depth_;
+};
+
+/// Returns a fingerprint of the binary encoding of `T` for checking once per
+/// connection that both peers use the same layout. Two types with equal
+/// fingerprints describe the same field names, types and container shapes.
+/// The fingerprint gets computed on first use by walking a default-constructed
+/// `T`, so fields with invariants must accept default values. Aborts the
+/// program otherwise, since no value would reliably tell such types apart.
+template <class T> uint64_t schema_fingerprint() {
+  static const uint64_t result = [] {
+    schema_hasher f;
+    auto tmp = T{};
+    if (!f.apply(tmp))
+      std::abort();
+    return f.result();
+  }();
+  return result;
+}
@@ -0,0 +1,400 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <type_traits>
+
+#include "ieee_754.hpp"
+#include "my_error.hpp"
+#include "network_order.hpp"
+#include "segmented_deserializer.hpp"
+
+template <class T> bool int_value(segmented_deserializer &source, T &x) {
+  auto tmp = std::make_unsigned_t<T>{};
+  if (source.value(as_writable_bytes(make_span(&tmp, 1)))) {
+    x = static_cast<T>(from_network_order(tmp));
+    return true;
+  } else {
+    return false;
+  }
+}
+
+template <class T> bool float_value(segmented_deserializer &source, T &x) {
+  auto tmp = typename ieee_754_trait<T>::packed_type{};
+  if (int_value(source, tmp)) {
+    x = unpack754(tmp);
+    return true;
+  } else {
+    return false;
+  }
+}
+
+bool segmented_deserializer::next_segment() noexcept {
+  while (segment_ != segments_end_ && segment_ + 1 != segments_end_) {
+    ++segment_;
+    tail_ -= segment_->size();
+    if (!segment_->empty()) {
+      current_ = segment_->data();
+      end_ = current_ + segment_->size();
+      return true;
+    }
+  }
+  current_ = end_;
+  return false;
+}
+
+void segmented_deserializer::read_stitched(std::byte *out,
+                                           size_t size) noexcept {
+  assert(size <= remaining());
+  while (size > 0) {
+    if (current_ == end_)
+      next_segment();
+    auto n = std::min(size, static_cast<size_t>(end_ - current_));
+    memcpy(out, current_, n);
+    current_ += n;
+    out += n;
+    size -= n;
+  }
+}
+
+bool segmented_deserializer::fetch_next_object_type(type_id_t &type) noexcept {
+  type = invalid_type_id;
+  emplace_error(error_code::unsupported_operation,
+                "the default binary format does not embed type information");
+  return false;
+}
+
+bool segmented_deserializer::begin_sequence(size_t &list_size) noexcept {
+  // Use varbyte encoding to compress sequence size on the wire.
+  uint32_t x = 0;
+  uint8_t low7 = 0;
+  for (int n = 0;; ++n) {
+    if (!value(low7))
+      return false;
+    // The fifth byte holds the highest 4 bits of a 32-bit size.
+    if (n == 4 && (low7 & 0xF0) != 0) {
+      emplace_error(error_code::invalid_argument, "size exceeds 32 bits");
+      return false;
+    }
+    x |= static_cast<uint32_t>((low7 & 0x7F)) << (7 * n);
+    if ((low7 & 0x80) == 0)
+      break;
+  }
+  list_size = x;
+  return true;
+}
+
+void segmented_deserializer::skip(size_t num_bytes) {
+  if (num_bytes > remaining())
+    assert(false);
+  while (num_bytes > 0) {
+    if (current_ == end_)
+      next_segment();
+    auto n = std::min(num_bytes, static_cast<size_t>(end_ - current_));
+    current_ += n;
+    num_bytes -= n;
+  }
+}
+
+void segmented_deserializer::reset(span<const segment> segments) noexcept {
+  segment_ = segments.begin();
+  segments_end_ = segments.end();
+  tail_ = 0;
+  depth_ = 0;
+  shared_.clear();
+  if (segments.empty()) {
+    current_ = nullptr;
+    end_ = nullptr;
+    return;
+  }
+  for (auto &seg : segments.subspan(1))
+    tail_ += seg.size();
+  current_ = segment_->data();
+  end_ = current_ + segment_->size();
+}
+
+void segmented_deserializer::add_shared_object(size_t pos, const void *type,
+                                               std::shared_ptr<void> ptr) {
+  shared_[pos] = shared_entry{type, std::move(ptr)};
+}
+
+std::shared_ptr<void>
+segmented_deserializer::shared_object(size_t pos, size_t distance,
+                                      const void *type) const {
+  if (distance > std::numeric_limits<size_t>::max() - pos)
+    return nullptr;
+  auto i = shared_.find(pos + distance);
+  if (i == shared_.end() || i->second.type != type)
+    return nullptr;
+  return i->second.ptr;
+}
+
+bool segmented_deserializer::begin_field(std::string_view,
+                                         bool &is_present) noexcept {
+  auto tmp = uint8_t{0};
+  if (!value(tmp))
+    return false;
+  is_present = static_cast<bool>(tmp);
+  return true;
+}
+
+template <class T>
+constexpr size_t max_value = static_cast<size_t>(std::numeric_limits<T>::max());
+
+bool segmented_deserializer::begin_field(std::string_view,
+                                         span<const type_id_t> types,
+                                         size_t &index) noexcept {
+  auto f = [&](auto tmp) {
+    if (!value(tmp))
+      return false;
+    if (tmp < 0 || static_cast<size_t>(tmp) >= types.size()) {
+      emplace_error(error_code::invalid_field_type,
+                    "received type index out of bounds");
+      return false;
+    }
+    index = static_cast<size_t>(tmp);
+    return true;
+  };
+  if (types.size() < max_value<int8_t>) {
+    return f(int8_t{0});
+  } else if (types.size() < max_value<int16_t>) {
+    return f(int16_t{0});
+  } else if (types.size() < max_value<int32_t>) {
+    return f(int32_t{0});
+  } else {
+    return f(int64_t{0});
+  }
+}
+
+bool segmented_deserializer::begin_field(std::string_view, bool &is_present,
+                                         span<const type_id_t> types,
+                                         size_t &index) noexcept {
+  auto f = [&](auto tmp) {
+    if (!value(tmp))
+      return false;
+    if (tmp < 0) {
+      is_present = false;
+      return true;
+    }
+    if (static_cast<size_t>(tmp) >= types.size()) {
+      emplace_error(error_code::invalid_field_type,
+                    "received type index out of bounds");
+      return false;
+    }
+    is_present = true;
+    index = static_cast<size_t>(tmp);
+    return true;
+  };
+  if (types.size() < max_value<int8_t>) {
+    return f(int8_t{0});
+  } else if (types.size() < max_value<int16_t>) {
+    return f(int16_t{0});
+  } else if (types.size() < max_value<int32_t>) {
+    return f(int32_t{0});
+  } else {
+    return f(int64_t{0});
+  }
+}
+
+bool segmented_deserializer::value(bool &x) noexcept {
+  int8_t tmp = 0;
+  if (!value(tmp))
+    return false;
+  x = tmp != 0;
+  return true;
+}
+
+bool segmented_deserializer::value(std::byte &x) noexcept {
+  if (current_ != end_ || next_segment()) {
+    x = *current_++;
+    return true;
+  }
+  emplace_error(error_code::end_of_stream);
+  return false;
+}
+
+bool segmented_deserializer::value(int8_t &x) noexcept {
+  auto tmp = std::byte{0};
+  if (!value(tmp))
+    return false;
+  x = static_cast<int8_t>(tmp);
+  return true;
+}
+
+bool segmented_deserializer::value(uint8_t &x) noexcept {
+  auto tmp = std::byte{0};
+  if (!value(tmp))
+    return false;
+  x = static_cast<uint8_t>(tmp);
+  return true;
+}
+
+bool segmented_deserializer::value(int16_t &x) noexcept {
+  return int_value(*this, x);
+}
+
+bool segmented_deserializer::value(uint16_t &x) noexcept {
+  return int_value(*this, x);
+}
+
+bool segmented_deserializer::value(int32_t &x) noexcept {
+  return int_value(*this, x);
+}
+
+bool segmented_deserializer::value(uint32_t &x) noexcept {
+  return int_value(*this, x);
+}
+
+bool segmented_deserializer::value(int64_t &x) noexcept {
+  return int_value(*this, x);
+}
+
+bool segmented_deserializer::value(uint64_t &x) noexcept {
+  return int_value(*this, x);
+}
+
+bool segmented_deserializer::value(float &x) noexcept {
+  return float_value(*this, x);
+}
+
+bool segmented_deserializer::value(double &x) noexcept {
+  return float_value(*this, x);
+}
+
+bool segmented_deserializer::value(long double &x) {
+  std::string tmp;
+  if (!value(tmp))
+    return false;
+  std::istringstream iss{std::move(tmp)};
+  if (iss >> x)
+    return true;
+  emplace_error(error_code::invalid_argument);
+  return false;
+}
+
+bool segmented_deserializer::value(span<std::byte> x) noexcept {
+  // Fast path: the value sits inside the current segment.
+  if (range_check(x.size())) {
+    memcpy(x.data(), current_, x.size());
+    current_ += x.size();
+    return true;
+  }
+  if (x.size() > remaining()) {
+    emplace_error(error_code::end_of_stream);
+    return false;
+  }
+  read_stitched(x.data(), x.size());
+  return true;
+}
+
+bool segmented_deserializer::value(std::string &x) {
+  x.clear();
+  size_t str_size = 0;
+  if (!begin_sequence(str_size))
+    return false;
+  if (range_check(str_size)) {
+    x.assign(reinterpret_cast<const char *>(current_), str_size);
+    current_ += str_size;
+    return end_sequence();
+  }
+  if (str_size > remaining()) {
+    emplace_error(error_code::end_of_stream);
+    return false;
+  }
+  x.resize(str_size);
+  read_stitched(reinterpret_cast<std::byte *>(x.data()), str_size);
+  return end_sequence();
+}
+
+bool segmented_deserializer::value(std::u16string &x) {
+  x.clear();
+  size_t str_size = 0;
+  if (!begin_sequence(str_size))
+    return false;
+  if (str_size * sizeof(uint16_t) > remaining()) {
+    emplace_error(error_code::end_of_stream);
+    return false;
+  }
+  for (size_t i = 0; i < str_size; ++i) {
+    // The standard does not guarantee that char16_t is exactly 16 bits.
+    uint16_t tmp;
+    int_value(*this, tmp);
+    x.push_back(static_cast<char16_t>(tmp));
+  }
+  return end_sequence();
+}
+
+bool segmented_deserializer::value(std::u32string &x) {
+  x.clear();
+  size_t str_size = 0;
+  if (!begin_sequence(str_size))
+    return false;
+  if (str_size * sizeof(uint32_t) > remaining()) {
+    emplace_error(error_code::end_of_stream);
+    return false;
+  }
+  for (size_t i = 0; i < str_size; ++i) {
+    // The standard does not guarantee that char32_t is exactly 32 bits.
+    uint32_t tmp;
+    int_value(*this, tmp);
+    x.push_back(static_cast<char32_t>(tmp));
+  }
+  return end_sequence();
+}
+
+bool segmented_deserializer::value(std::vector<bool> &x) {
+  x.clear();
+  size_t len = 0;
+  if (!begin_sequence(len))
+    return false;
+  if (len == 0)
+    return end_sequence();
+  size_t blocks = len / 8;
+  for (size_t block = 0; block < blocks; ++block) {
+    uint8_t tmp = 0;
+    if (!value(tmp))
+      return false;
+    x.emplace_back((tmp & 0b1000'0000) != 0);
+    x.emplace_back((tmp & 0b0100'0000) != 0);
+    x.emplace_back((tmp & 0b0010'0000) != 0);
+    x.emplace_back((tmp & 0b0001'0000) != 0);
+    x.emplace_back((tmp & 0b0000'1000) != 0);
+    x.emplace_back((tmp & 0b0000'0100) != 0);
+    x.emplace_back((tmp & 0b0000'0010) != 0);
+    x.emplace_back((tmp & 0b0000'0001) != 0);
+  }
+  auto trailing_block_size = len % 8;
+  if (trailing_block_size > 0) {
+    uint8_t tmp = 0;
+    if (!value(tmp))
+      return false;
+    switch (trailing_block_size) {
+    case 7:
+      x.emplace_back((tmp & 0b0100'0000) != 0);
+      [[fallthrough]];
+    case 6:
+      x.emplace_back((tmp & 0b0010'0000) != 0);
+      [[fallthrough]];
+    case 5:
+      x.emplace_back((tmp & 0b0001'0000) != 0);
+      [[fallthrough]];
+    case 4:
+      x.emplace_back((tmp & 0b0000'1000) != 0);
+      [[fallthrough]];
+    case 3:
+      x.emplace_back((tmp & 0b0000'0100) != 0);
+      [[fallthrough]];
+    case 2:
+      x.emplace_back((tmp & 0b0000'0010) != 0);
+      [[fallthrough]];
+    case 1:
+      x.emplace_back((tmp & 0b0000'0001) != 0);
+      [[fallthrough]];
+    default:
+      break;
+    }
+  }
+  return end_sequence();
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "load_inspector_base.hpp"
+#include "my_error.hpp"
+#include "span.hpp"
+#include "squashed_int.hpp"
+#include "type_def.h"
+#include "type_id.hpp"
+
+/// Deserializes the binary format of `binary_serializer` from a chain of
+/// non-contiguous buffers, e.g., the receive buffers of a network layer.
+/// Values inside a single segment take the same contiguous path as
+/// `binary_deserializer`, only values crossing a segment boundary get stitched
+/// together byte-wise. The segments must outlive the deserializer.
+class segmented_deserializer final
+    : public load_inspector_base<segmented_deserializer> {
+public:
+  using super = load_inspector_base<segmented_deserializer>;
+
+  using segment = span<const std::byte>;
+
+  segmented_deserializer() noexcept
+      : segment_(nullptr), segments_end_(nullptr), current_(nullptr),
+        end_(nullptr), tail_(0), depth_(0) {}
+
+  explicit segmented_deserializer(span<const segment> segments) noexcept
+      : depth_(0) {
+    reset(segments);
+  }
+
+  virtual ~segmented_deserializer() {}
+
+  /// Returns the number of unread bytes in all segments.
+  size_t remaining() const noexcept {
+    return static_cast<size_t>(end_ - current_) + tail_;
+  }
+
+  /// Returns the unread bytes of the current segment.
+  span<const std::byte> remainder() const noexcept {
+    return make_span(current_, end_);
+  }
+
+  void skip(size_t num_bytes);
+
+  void reset(span<const segment> segments) noexcept;
+
+  /// Registers the shared object `ptr` of type `type` for the pointer at the
+  /// read position with `pos` remaining bytes.
+  void add_shared_object(size_t pos, const void *type,
+                         std::shared_ptr<void> ptr);
+
+  /// Returns the shared object of the pointer `distance` bytes before the
+  /// read position with `pos` remaining bytes or null if there is no such
+  /// pointer or if its object has a type other than `type`. Positions count
+  /// across segment boundaries, like the distances that `binary_serializer`
+  /// writes.
+  std::shared_ptr<void> shared_object(size_t pos, size_t distance,
+                                      const void *type) const;
+
+  /// Releases all shared objects.
+  void clear_shared_objects() noexcept { shared_.clear(); }
+
+  static constexpr bool has_human_readable_format() noexcept { return false; }
+
+  bool fetch_next_object_type(type_id_t &type) noexcept;
+
+  bool begin_object(type_id_t, std::string_view) noexcept {
+    ++depth_;
+    return true;
+  }
+
+  bool end_object() noexcept {
+    // Back-references never leave their top-level object.
+    if (--depth_ == 0 && !shared_.empty())
+      clear_shared_objects();
+    return true;
+  }
+
+  constexpr bool begin_field(std::string_view) noexcept { return true; }
+
+  bool begin_field(std::string_view name, bool &is_present) noexcept;
+
+  bool begin_field(std::string_view name, span<const type_id_t> types,
+                   size_t &index) noexcept;
+
+  bool begin_field(std::string_view name, bool &is_present,
+                   span<const type_id_t> types, size_t &index) noexcept;
+
+  constexpr bool end_field() { return true; }
+
+  constexpr bool begin_tuple(size_t) noexcept { return true; }
+
+  constexpr bool end_tuple() noexcept { return true; }
+
+  constexpr bool begin_key_value_pair() noexcept { return true; }
+
+  constexpr bool end_key_value_pair() noexcept { return true; }
+
+  bool begin_sequence(size_t &list_size) noexcept;
+
+  constexpr bool end_sequence() noexcept { return true; }
+
+  bool begin_associative_array(size_t &size) noexcept {
+    return begin_sequence(size);
+  }
+
+  bool end_associative_array() noexcept { return end_sequence(); }
+
+  bool value(bool &x) noexcept;
+
+  bool value(std::byte &x) noexcept;
+
+  bool value(uint8_t &x) noexcept;
+
+  bool value(int8_t &x) noexcept;
+
+  bool value(int16_t &x) noexcept;
+
+  bool value(uint16_t &x) noexcept;
+
+  bool value(int32_t &x) noexcept;
+
+  bool value(uint32_t &x) noexcept;
+
+  bool value(int64_t &x) noexcept;
+
+  bool value(uint64_t &x) noexcept;
+
+  template <class T>
+  std::enable_if_t<std::is_integral<T>::value, bool> value(T &x) noexcept {
+    auto tmp = squashed_int_t<T>{0};
+    if (value(tmp)) {
+      x = static_cast<T>(tmp);
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  bool value(float &x) noexcept;
+
+  bool value(double &x) noexcept;
+
+  bool value(long double &x);
+
+  bool value(std::string &x);
+
+  bool value(std::u16string &x);
+
+  bool value(std::u32string &x);
+
+  bool value(span<std::byte> x) noexcept;
+
+  bool value(std::vector<bool> &x);
+
+private:
+  bool range_check(size_t read_size) const noexcept {
+    return current_ + read_size <= end_;
+  }
+
+  /// Moves to the next non-empty segment. Returns `false` if none is left.
+  bool next_segment() noexcept;
+
+  /// Copies `size` bytes that may span several segments.
+  void read_stitched(std::byte *out, size_t size) noexcept;
+
+  const segment *segment_;
+  const segment *segments_end_;
+  const std::byte *current_;
+  const std::byte *end_;
+  size_t tail_; // number of bytes in the segments after `segment_`
+  size_t depth_; // nesting level of objects
+  struct shared_entry {
+    const void *type;
+    std::shared_ptr<void> ptr;
+  };
+  // shared objects by the remaining bytes at their first pointer
+  std::unordered_map<size_t, shared_entry> shared_;
+};
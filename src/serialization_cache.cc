@@ -0,0 +1,68 @@
+#include "serialization_cache.hpp"
+
+size_t serialization_cache::key_hash::operator()(const key &k) const noexcept {
+  auto h = std::hash<const void *>{}(k.type);
+  auto combine = [&h](size_t x) {
+    h ^= x + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+  };
+  combine(std::hash<const void *>{}(k.identity));
+  combine(std::hash<uint64_t>{}(k.version));
+  combine(k.layout);
+  return h;
+}
+
+serialization_cache::bytes_ptr serialization_cache::find(const key &k) {
+  std::lock_guard<std::mutex> guard{mtx_};
+  auto i = index_.find(k);
+  if (i == index_.end()) {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  hits_.fetch_add(1, std::memory_order_relaxed);
+  lru_.splice(lru_.begin(), lru_, i->second);
+  return i->second->bytes;
+}
+
+void serialization_cache::insert(const key &k, span<const std::byte> bytes,
+                                 std::shared_ptr<const void> owner) {
+  if (bytes.size() > capacity_)
+    return;
+  // Copies the bytes before taking the lock.
+  auto ptr = std::make_shared<const byte_buffer>(bytes.begin(), bytes.end());
+  std::lock_guard<std::mutex> guard{mtx_};
+  if (auto i = index_.find(k); i != index_.end()) {
+    // Another thread stored the same encoding in the meantime.
+    lru_.splice(lru_.begin(), lru_, i->second);
+    return;
+  }
+  evict(bytes.size());
+  lru_.push_front(entry{k, std::move(ptr), std::move(owner)});
+  index_.emplace(k, lru_.begin());
+  size_ += bytes.size();
+}
+
+void serialization_cache::clear() {
+  std::lock_guard<std::mutex> guard{mtx_};
+  index_.clear();
+  lru_.clear();
+  size_ = 0;
+}
+
+size_t serialization_cache::size() const {
+  std::lock_guard<std::mutex> guard{mtx_};
+  return size_;
+}
+
+size_t serialization_cache::entries() const {
+  std::lock_guard<std::mutex> guard{mtx_};
+  return index_.size();
+}
+
+void serialization_cache::evict(size_t required) {
+  while (!lru_.empty() && capacity_ - size_ < required) {
+    auto &last = lru_.back();
+    size_ -= last.bytes->size();
+    index_.erase(last.k);
+    lru_.pop_back();
+  }
+}
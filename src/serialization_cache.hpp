@@ -0,0 +1,208 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "def_traits.hpp"
+#include "inspector_access.hpp"
+#include "my_error.hpp"
+#include "span.hpp"
+#include "type_def.h"
+
+using byte_buffer = std::vector<std::byte>;
+
+/// Bounded LRU cache for the encodings of immutable sub-objects. Entries map
+/// the identity of an object plus a version counter, or a user-provided hash,
+/// to the bytes that `binary_serializer` produced for it. Safe to share
+/// between threads and serializers.
+class serialization_cache {
+public:
+  /// Identifies one encoding of a value.
+  struct key {
+    /// Tag of the value type.
+    const void *type;
+
+    /// Address of the value or null for keys with a user-provided hash.
+    const void *identity;
+
+    /// Version counter or user-provided hash of the value.
+    uint64_t version;
+
+    /// Settings of the serializer that affect the encoding.
+    uint8_t layout;
+
+    friend bool operator==(const key &x, const key &y) noexcept {
+      return x.type == y.type && x.identity == y.identity &&
+             x.version == y.version && x.layout == y.layout;
+    }
+  };
+
+  using bytes_ptr = std::shared_ptr<const byte_buffer>;
+
+  /// Creates a cache that stores at most `capacity` bytes of encodings.
+  explicit serialization_cache(size_t capacity) noexcept
+      : capacity_(capacity), size_(0), hits_(0), misses_(0) {}
+
+  DISABLE_COPY(serialization_cache)
+  DISABLE_MOVE(serialization_cache)
+
+  /// Returns the encoding stored for `k` or null. Counts a hit or a miss.
+  bytes_ptr find(const key &k);
+
+  /// Stores a copy of `bytes` for `k`, evicting the least recently used
+  /// entries as needed. Keeps `owner` alive while the entry exists, so that
+  /// no other object can reuse the address in `k.identity`. Ignores
+  /// encodings larger than the capacity.
+  void insert(const key &k, span<const std::byte> bytes,
+              std::shared_ptr<const void> owner = nullptr);
+
+  /// Removes all entries.
+  void clear();
+
+  /// Returns the maximum number of bytes in all stored encodings.
+  size_t capacity() const noexcept { return capacity_; }
+
+  /// Returns the number of bytes in all stored encodings.
+  size_t size() const;
+
+  /// Returns the number of stored encodings.
+  size_t entries() const;
+
+  size_t hits() const noexcept { return hits_.load(std::memory_order_relaxed); }
+
+  size_t misses() const noexcept {
+    return misses_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct key_hash {
+    size_t operator()(const key &k) const noexcept;
+  };
+
+  struct entry {
+    key k;
+    bytes_ptr bytes;
+    std::shared_ptr<const void> owner;
+  };
+
+  using entry_list = std::list<entry>;
+
+  void evict(size_t required);
+
+  size_t capacity_;
+  size_t size_; // bytes in all stored encodings
+  entry_list lru_; // most recently used entry first
+  std::unordered_map<key, entry_list::iterator, key_hash> index_;
+  mutable std::mutex mtx_;
+  std::atomic<size_t> hits_;
+  std::atomic<size_t> misses_;
+};
+
+/// Wraps an immutable `T` whose encoding may come from a
+/// `serialization_cache`. The cache identifies the value by its address plus
+/// a version counter, which callers must bump when replacing the value with
+/// a modified copy, or by a hash of its content via `with_hash`. Loading
+/// always decodes the value and resets the version to 0.
+template <class T> class cacheable {
+public:
+  using value_type = T;
+
+  cacheable() noexcept : version_(0), hashed_(false) {}
+
+  explicit cacheable(std::shared_ptr<const T> value,
+                     uint64_t version = 0) noexcept
+      : value_(std::move(value)), version_(version), hashed_(false) {}
+
+  /// Creates a wrapper that identifies `value` by `hash` instead of its
+  /// address. Values with the same hash must have the same encoding.
+  static cacheable with_hash(std::shared_ptr<const T> value, uint64_t hash) {
+    cacheable result{std::move(value), hash};
+    result.hashed_ = true;
+    return result;
+  }
+
+  const std::shared_ptr<const T> &get() const noexcept { return value_; }
+
+  const T &operator*() const noexcept { return *value_; }
+
+  const T *operator->() const noexcept { return value_.get(); }
+
+  explicit operator bool() const noexcept { return value_ != nullptr; }
+
+  uint64_t version() const noexcept { return version_; }
+
+  bool hashed() const noexcept { return hashed_; }
+
+  /// Returns the key of the encoding with the settings in `layout`.
+  serialization_cache::key key(uint8_t layout) const noexcept {
+    return {&type_tag, hashed_ ? nullptr : value_.get(), version_, layout};
+  }
+
+private:
+  static constexpr char type_tag = 0;
+
+  std::shared_ptr<const T> value_;
+  uint64_t version_;
+  bool hashed_;
+};
+
+template <class Inspector, class = void>
+struct has_serialization_cache : std::false_type {};
+
+template <class Inspector>
+struct has_serialization_cache<
+    Inspector, std::void_t<decltype(std::declval<Inspector &>().cache())>>
+    : std::true_type {};
+
+template <class T>
+struct inspector_access<cacheable<T>> : inspector_access_base<cacheable<T>> {
+  template <class Inspector> static bool apply(Inspector &f, cacheable<T> &x) {
+    if constexpr (Inspector::is_loading) {
+      auto value = std::make_shared<T>();
+      if (!f.apply(*value))
+        return false;
+      x = cacheable<T>{std::move(value)};
+      return true;
+    } else {
+      if (!x) {
+        f.emplace_error(error_code::runtime_error, "cacheable without value");
+        return false;
+      }
+      if constexpr (has_serialization_cache<Inspector>::value) {
+        if (auto cache = f.cache()) {
+          auto k = x.key(f.layout());
+          if (auto bytes = cache->find(k))
+            return f.value(make_span(*bytes));
+          auto pos = f.write_pos();
+          // Cached bytes may not refer to shared objects outside of them.
+          auto limit = f.limit_back_references(pos);
+          auto ok = f.apply(*x);
+          f.limit_back_references(limit);
+          if (!ok)
+            return false;
+          // Keeps values with identity keys alive while cached.
+          std::shared_ptr<const void> owner;
+          if (!x.hashed())
+            owner = x.get();
+          const auto *first = f.buf().data() + pos;
+          cache->insert(k, make_span(first, f.write_pos() - pos),
+                        std::move(owner));
+          return true;
+        }
+      }
+      return f.apply(*x);
+    }
+  }
+
+  template <class Inspector> static bool skip(Inspector &f) {
+    return f.template skip_value<T>();
+  }
+};
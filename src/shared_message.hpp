@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "binary_deserializer.hpp"
+#include "my_error.hpp"
+#include "span.hpp"
+
+using byte_buffer = std::vector<std::byte>;
+
+/// Reference-counted, immutable view of a received buffer that holds an
+/// encoded `T`. Copies share the buffer and the decoded value: the first
+/// call to `get` on any copy decodes the buffer exactly once, even with
+/// concurrent callers, and all later calls return the same `const T`. Hence,
+/// delivering one buffer to many readers costs a single decode.
+template <class T> class shared_message {
+public:
+  /// Function for configuring the deserializer before decoding, e.g., to
+  /// enable typed streams or presence bitmaps.
+  using configure_fn = std::function<void(binary_deserializer &)>;
+
+  shared_message() noexcept = default;
+
+  explicit shared_message(byte_buffer bytes, configure_fn configure = nullptr)
+      : state_(
+            std::make_shared<state>(std::move(bytes), std::move(configure))) {}
+
+  /// Returns the decoded value or null if the buffer does not contain a valid
+  /// `T`. Decodes the buffer on the first call.
+  const T *get() const {
+    if (!state_)
+      return nullptr;
+    std::call_once(state_->once, [this] { state_->decode(); });
+    return state_->value ? std::addressof(*state_->value) : nullptr;
+  }
+
+  /// Returns the decoded value. Requires a successful decode.
+  const T &operator*() const {
+    auto ptr = get();
+    assert(ptr != nullptr);
+    return *ptr;
+  }
+
+  const T *operator->() const { return std::addressof(**this); }
+
+  /// Returns the error of decoding the buffer. Decodes the buffer on the
+  /// first call.
+  error get_error() const {
+    if (!state_)
+      return error_code::runtime_error;
+    get();
+    return state_->err;
+  }
+
+  /// Returns whether any copy already decoded the buffer.
+  bool decoded() const noexcept {
+    return state_ && state_->done.load(std::memory_order_acquire);
+  }
+
+  span<const std::byte> bytes() const noexcept {
+    return state_ ? make_span(state_->bytes) : span<const std::byte>{};
+  }
+
+  /// Returns the number of copies that share the buffer.
+  long use_count() const noexcept { return state_.use_count(); }
+
+  explicit operator bool() const noexcept { return state_ != nullptr; }
+
+private:
+  struct state {
+    state(byte_buffer input, configure_fn fn)
+        : bytes(std::move(input)), configure(std::move(fn)),
+          err(error_code::success), done(false) {}
+
+    void decode() {
+      binary_deserializer source{bytes};
+      if (configure) {
+        configure(source);
+        configure = nullptr;
+      }
+      value.emplace();
+      if (!source.apply(*value)) {
+        value.reset();
+        err = source.get_error();
+        if (err == error_code::success)
+          err = error_code::runtime_error;
+      }
+      done.store(true, std::memory_order_release);
+    }
+
+    const byte_buffer bytes;
+    configure_fn configure;
+    std::once_flag once;
+    std::optional<T> value;
+    error err;
+    std::atomic<bool> done;
+  };
+
+  std::shared_ptr<state> state_;
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "binary_serializer.hpp"
+#include "save_inspector_base.hpp"
+#include "span.hpp"
+#include "type_def.h"
+#include "type_id.hpp"
+
+/// Produces the format of `binary_serializer` in bounded pieces. Output
+/// collects in a window of `capacity` bytes that gets handed to `Sink`
+/// whenever it fills up, so the memory for serializing a huge object stays
+/// at roughly `capacity` bytes instead of the full encoded size.
+///
+/// The sink has the signature `bool(span<const std::byte>)` and must be done
+/// with the bytes when it returns. It applies backpressure by not returning
+/// until the downstream (socket, queue, ...) accepted the bytes, e.g., by
+/// running the event loop in the meantime. Returning `false` aborts
+/// serialization.
+template <class Sink>
+class stream_serializer final
+    : public save_inspector_base<stream_serializer<Sink>> {
+public:
+  stream_serializer(Sink sink, size_t capacity)
+      : impl_(window_), sink_(std::move(sink)), capacity_(capacity),
+        total_(0) {
+    window_.reserve(capacity);
+  }
+
+  DISABLE_COPY(stream_serializer)
+  DISABLE_MOVE(stream_serializer)
+
+  /// Returns the number of bytes waiting in the window.
+  size_t buffered() const noexcept { return window_.size(); }
+
+  /// Returns the number of bytes handed to the sink so far.
+  size_t total() const noexcept { return total_; }
+
+  /// Hands all buffered bytes to the sink.
+  bool flush() {
+    if (window_.empty())
+      return true;
+    if (!sink_(make_span(std::as_const(window_)))) {
+      this->emplace_error(error_code::runtime_error, "sink refused data");
+      return false;
+    }
+    total_ += window_.size();
+    window_.clear();
+    impl_.seek(0);
+    return true;
+  }
+
+  static constexpr bool has_human_readable_format() noexcept { return false; }
+
+  constexpr bool begin_object(type_id_t, std::string_view) noexcept {
+    return true;
+  }
+
+  constexpr bool end_object() { return true; }
+
+  template <class... Ts> bool begin_field(Ts &&... xs) {
+    return impl_.begin_field(std::forward<Ts>(xs)...) && maybe_flush();
+  }
+
+  constexpr bool end_field() { return true; }
+
+  constexpr bool begin_tuple(size_t) { return true; }
+
+  constexpr bool end_tuple() { return true; }
+
+  constexpr bool begin_key_value_pair() { return true; }
+
+  constexpr bool end_key_value_pair() { return true; }
+
+  bool begin_sequence(size_t list_size) {
+    return impl_.begin_sequence(list_size) && maybe_flush();
+  }
+
+  constexpr bool end_sequence() { return true; }
+
+  bool begin_associative_array(size_t size) { return begin_sequence(size); }
+
+  bool end_associative_array() { return end_sequence(); }
+
+  bool value(std::byte x) { return impl_.value(x) && maybe_flush(); }
+
+  template <class T>
+  std::enable_if_t<std::is_arithmetic<T>::value, bool> value(T x) {
+    return impl_.value(x) && maybe_flush();
+  }
+
+  bool value(const std::u16string &x) {
+    return impl_.value(x) && maybe_flush();
+  }
+
+  bool value(const std::u32string &x) {
+    return impl_.value(x) && maybe_flush();
+  }
+
+  bool value(const std::vector<bool> &x) {
+    return impl_.value(x) && maybe_flush();
+  }
+
+  bool value(std::string_view x) {
+    return begin_sequence(x.size()) && value(as_bytes(make_span(x)));
+  }
+
+  bool value(span<const std::byte> x) {
+    // Large blocks bypass the window instead of growing it.
+    if (x.size() < capacity_)
+      return impl_.value(x) && maybe_flush();
+    if (!flush())
+      return false;
+    if (!sink_(x)) {
+      this->emplace_error(error_code::runtime_error, "sink refused data");
+      return false;
+    }
+    total_ += x.size();
+    return true;
+  }
+
+private:
+  bool maybe_flush() { return window_.size() < capacity_ || flush(); }
+
+  byte_buffer window_;
+  binary_serializer impl_;
+  Sink sink_;
+  size_t capacity_;
+  size_t total_;
+};
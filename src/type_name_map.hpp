@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+#include "type_id.hpp"
+
+/// Pairs a type name with its ID.
+struct type_name_entry {
+  std::string_view name;
+  type_id_t id = invalid_type_id;
+};
+
+/// Hashes `str` with FNV-1a followed by the finalizer of MurmurHash3, mixing
+/// in `seed` to get an independent hash function per seed.
+constexpr uint32_t type_name_hash(uint32_t seed,
+                                  std::string_view str) noexcept {
+  uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+  for (auto c : str) {
+    h ^= static_cast<uint8_t>(c);
+    h *= 16777619u;
+  }
+  h ^= h >> 16;
+  h *= 0x85EBCA6Bu;
+  h ^= h >> 13;
+  h *= 0xC2B2AE35u;
+  h ^= h >> 16;
+  return h;
+}
+
+/// Perfect hash table from type names to type IDs, built at compile time with
+/// the hash-and-displace scheme: the seed-0 hash picks a bucket and each
+/// bucket stores the seed that places all of its names into free slots. A
+/// lookup computes two hashes and compares one name. For names that appear
+/// more than once, the first entry wins.
+template <size_t N> class type_name_map {
+public:
+  static_assert(N > 0, "type_name_map requires at least one entry");
+
+  static constexpr size_t num_buckets = N;
+
+  static constexpr size_t num_slots = [] {
+    size_t result = 1;
+    while (result < 2 * N)
+      result *= 2;
+    return result;
+  }();
+
+  constexpr explicit type_name_map(const type_name_entry (&entries)[N])
+      : entries_(), seeds_(), slots_() {
+    for (size_t i = 0; i < N; ++i)
+      entries_[i] = entries[i];
+    build();
+  }
+
+  /// Returns the ID for `name` or `invalid_type_id` if `name` is unknown.
+  constexpr type_id_t find(std::string_view name) const noexcept {
+    auto bucket = type_name_hash(0, name) % num_buckets;
+    auto slot = type_name_hash(seeds_[bucket], name) % num_slots;
+    auto index = slots_[slot];
+    if (index == 0 || entries_[index - 1].name != name)
+      return invalid_type_id;
+    return entries_[index - 1].id;
+  }
+
+  static constexpr size_t size() noexcept { return N; }
+
+private:
+  constexpr void build() {
+    // Group the entries by bucket, dropping repeated names. Equal names always
+    // share a bucket.
+    size_t bucket_of[N] = {};
+    size_t bucket_begin[num_buckets + 1] = {};
+    for (size_t i = 0; i < N; ++i) {
+      bucket_of[i] = type_name_hash(0, entries_[i].name) % num_buckets;
+      ++bucket_begin[bucket_of[i] + 1];
+    }
+    for (size_t bucket = 0; bucket < num_buckets; ++bucket)
+      bucket_begin[bucket + 1] += bucket_begin[bucket];
+    size_t members[N] = {};
+    size_t bucket_sizes[num_buckets] = {};
+    for (size_t i = 0; i < N; ++i) {
+      auto first = bucket_begin[bucket_of[i]];
+      auto &count = bucket_sizes[bucket_of[i]];
+      auto repeated = false;
+      for (size_t k = first; k < first + count && !repeated; ++k)
+        repeated = entries_[members[k]].name == entries_[i].name;
+      if (!repeated)
+        members[first + count++] = i;
+    }
+    size_t max_size = 0;
+    for (auto size : bucket_sizes)
+      max_size = size > max_size ? size : max_size;
+    // Placing large buckets first keeps the seed search short.
+    bool taken[num_slots] = {};
+    size_t picked[N] = {};
+    for (auto size = max_size; size > 0; --size)
+      for (size_t bucket = 0; bucket < num_buckets; ++bucket)
+        if (bucket_sizes[bucket] == size)
+          place(bucket, members + bucket_begin[bucket], size, taken, picked);
+  }
+
+  /// Searches a seed for `bucket` that maps the names of the `count` entries
+  /// at `members` to free slots and assigns these slots to the entries.
+  constexpr void place(size_t bucket, const size_t *members, size_t count,
+                       bool *taken, size_t *picked) {
+    uint32_t seed = 1;
+    for (;; ++seed) {
+      size_t num_picked = 0;
+      for (; num_picked < count; ++num_picked) {
+        auto name = entries_[members[num_picked]].name;
+        auto slot = type_name_hash(seed, name) % num_slots;
+        auto collision = taken[slot];
+        for (size_t k = 0; k < num_picked && !collision; ++k)
+          collision = picked[k] == slot;
+        if (collision)
+          break;
+        picked[num_picked] = slot;
+      }
+      if (num_picked == count)
+        break;
+    }
+    for (size_t k = 0; k < count; ++k) {
+      taken[picked[k]] = true;
+      slots_[picked[k]] = members[k] + 1;
+    }
+    seeds_[bucket] = seed;
+  }
+
+  type_name_entry entries_[N];
+  uint32_t seeds_[num_buckets];
+  size_t slots_[num_slots]; // index into `entries_` plus one, 0 if empty
+};
+
+/// Expands to the `type_name_entry` of `name` in a `Lists`-style macro. User
+/// types can extend the builtin table with their own list:
+///
+///   constexpr type_name_entry names[] = {Lists(TypeNameEntry)
+///                                          MyTypes(TypeNameEntry)};
+///   constexpr type_name_map<std::size(names)> my_type_names{names};
+#define TypeNameEntry(name)                                                    \
+  type_name_entry{type_name<name>::value, type_id_v<name>},
+
+/// Type names and IDs of all types in `Lists`.
+constexpr type_name_entry builtin_type_names[] = {Lists(TypeNameEntry)};
+
+constexpr type_name_map<std::size(builtin_type_names)> global_type_names{
+    builtin_type_names};
+
+/// Returns the ID of the type in `Lists` called `name` or `invalid_type_id`.
+constexpr type_id_t type_id_by_name(std::string_view name) noexcept {
+  return global_type_names.find(name);
+}
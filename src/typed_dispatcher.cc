@@ -0,0 +1,24 @@
+#include "typed_dispatcher.hpp"
+
+void typed_dispatcher::set(type_id_t type, handler f) {
+  if (type >= handlers_.size())
+    handlers_.resize(type + size_t{1});
+  handlers_[type] = std::move(f);
+}
+
+bool typed_dispatcher::dispatch(binary_deserializer &source) {
+  auto type = type_id_t{0};
+  if (!source.fetch_next_object_type(type))
+    return false;
+  if (type < handlers_.size() && handlers_[type])
+    return handlers_[type](source);
+  ++skipped_;
+  return source.skip_object();
+}
+
+bool typed_dispatcher::dispatch_all(binary_deserializer &source) {
+  while (source.remaining() > 0)
+    if (!dispatch(source))
+      return false;
+  return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "binary_deserializer.hpp"
+#include "type_id.hpp"
+
+/// Consumes a typed stream (see `binary_serializer::set_typed_stream`) of
+/// heterogeneous objects. Handlers live in a dense table indexed by
+/// `type_id_t`, so dispatching an object or dropping an object without
+/// handler takes a single lookup.
+class typed_dispatcher {
+public:
+  using handler = std::function<bool(binary_deserializer &)>;
+
+  typed_dispatcher() : skipped_(0) {}
+
+  /// Calls `f` with each object of type `T`. The objects get decoded into the
+  /// same `T`, so `f` must not keep references to it.
+  template <class T, class F> void add(F f) {
+    set(type_id_v<T>, [f{std::move(f)}, tmp{T{}}](
+                          binary_deserializer &source) mutable {
+      if (!source.apply(tmp))
+        return false;
+      f(tmp);
+      return true;
+    });
+  }
+
+  /// Sets the handler for objects of type `type`. Handlers read the complete
+  /// object from the deserializer. An empty handler drops objects of `type`.
+  void set(type_id_t type, handler f);
+
+  /// Decodes the next object from `source` and passes it to its handler.
+  bool dispatch(binary_deserializer &source);
+
+  /// Dispatches objects until `source` has no more input.
+  bool dispatch_all(binary_deserializer &source);
+
+  /// Returns how many objects without handler got dropped.
+  size_t skipped() const noexcept { return skipped_; }
+
+private:
+  std::vector<handler> handlers_;
+  size_t skipped_;
+};
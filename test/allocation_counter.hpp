@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global allocation functions of the test program to count heap
+// allocations, e.g., for checking that a code path allocates nothing.
+// Include in one file per test program only.
+
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+  ++allocations;
+  if (auto ptr = std::malloc(size))
+    return ptr;
+  throw std::bad_alloc{};
+}
+
+// Both forms of operator delete must release with the function that
+// allocated, otherwise GCC warns about mismatched allocation functions.
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
@@ -0,0 +1,62 @@
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../src/binary_deserializer.hpp"
+#include "../src/binary_serializer.hpp"
+#include "../src/crc32c.hpp"
+
+class Person {
+public:
+  std::string name;
+  int age;
+  std::vector<std::string> tags;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Person &x) {
+  return f.object(x).fields(f.field("name", x.name), f.field("age", x.age),
+                            f.field("tags", x.tags));
+}
+
+int main() {
+  // standard check value of CRC32C
+  std::string_view check = "123456789";
+  assert(crc32c::compute(as_bytes(make_span(check))) == 0xE3069283);
+  Person p{"tom", 10, {}};
+  for (int i = 0; i < 2000; ++i)
+    p.tags.emplace_back("tag " + std::to_string(i));
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  sink.begin_checksum();
+  bool r = sink.apply(p) && sink.end_checksum();
+  assert(r);
+  // incremental updates match a single pass
+  auto payload = make_span(buf.data(), buf.size() - 4);
+  crc32c partial;
+  partial.update(payload.first(1000));
+  partial.update(payload.subspan(1000));
+  assert(partial.value() == crc32c::compute(as_bytes(payload)));
+  // verify on load
+  {
+    binary_deserializer source{buf};
+    Person q;
+    source.begin_checksum();
+    r = source.apply(q) && source.verify_checksum();
+    assert(r);
+    assert(q.tags == p.tags && source.remaining() == 0);
+  }
+  // a flipped bit fails verification
+  buf[buf.size() / 2] ^= std::byte{0x01};
+  {
+    binary_deserializer source{buf};
+    Person q;
+    source.begin_checksum();
+    r = source.apply(q) && source.verify_checksum();
+    assert(!r);
+  }
+  std::cout << "checksummed " << buf.size() << " bytes\n";
+  return 0;
+}
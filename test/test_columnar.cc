@@ -0,0 +1,221 @@
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../src/binary_deserializer.hpp"
+#include "../src/binary_serializer.hpp"
+#include "../src/lz_block.hpp"
+
+static size_t saves = 0;
+static size_t loads = 0;
+
+class Venue {
+public:
+  std::string name;
+  int16_t region = 0;
+};
+
+bool operator==(const Venue &a, const Venue &b) {
+  return a.name == b.name && a.region == b.region;
+}
+
+template <class Inspector> bool inspect(Inspector &f, Venue &x) {
+  return f.object(x).fields(f.field("name", x.name),
+                            f.field("region", x.region));
+}
+
+class Trade {
+public:
+  int64_t timestamp = 0;
+  double price = 0;
+  int32_t quantity = 0;
+  Venue venue;
+  std::optional<int32_t> flags;
+  bool buy = false;
+};
+
+bool operator==(const Trade &a, const Trade &b) {
+  return a.timestamp == b.timestamp && a.price == b.price &&
+         a.quantity == b.quantity && a.venue == b.venue &&
+         a.flags == b.flags && a.buy == b.buy;
+}
+
+template <class Inspector> bool inspect(Inspector &f, Trade &x) {
+  return f.object(x)
+      .on_save([] {
+        ++saves;
+        return true;
+      })
+      .on_load([] {
+        ++loads;
+        return true;
+      })
+      .fields(f.field("timestamp", x.timestamp), f.field("price", x.price),
+              f.field("quantity", x.quantity), f.field("venue", x.venue),
+              f.field("flags", x.flags), f.field("buy", x.buy));
+}
+
+class Tape {
+public:
+  std::optional<std::string> symbol;
+  std::vector<Trade> trades;
+  std::optional<int32_t> session;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Tape &x) {
+  return f.object(x).fields(f.field("symbol", x.symbol),
+                            f.field("trades", x.trades),
+                            f.field("session", x.session));
+}
+
+template <> struct type_id<Venue> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+template <> struct type_id<Trade> {
+  static constexpr type_id_t value = first_custom_type_id + 1;
+};
+
+template <> struct type_id<Tape> {
+  static constexpr type_id_t value = first_custom_type_id + 2;
+};
+
+Tape make_tape(size_t size) {
+  Tape x;
+  x.symbol = "ACME";
+  x.session = 7;
+  for (size_t i = 0; i < size; ++i) {
+    auto n = static_cast<int32_t>(i);
+    Trade t;
+    t.timestamp = 1700000000000 + n * 10;
+    t.price = 100.0 + (n % 8) * 0.25;
+    t.quantity = 100 * (1 + n % 3);
+    t.venue = Venue{i % 2 == 0 ? "XNAS" : "ARCX", static_cast<int16_t>(n % 2)};
+    if (i % 5 == 0)
+      t.flags = n;
+    t.buy = i % 3 == 0;
+    x.trades.push_back(t);
+  }
+  return x;
+}
+
+struct settings {
+  bool columnar = true;
+  bool presence_bitmaps = false;
+  bool nested_object_lengths = false;
+};
+
+byte_buffer serialize(const Tape &x, settings cfg) {
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  sink.set_columnar_lists(cfg.columnar);
+  sink.set_presence_bitmaps(cfg.presence_bitmaps);
+  sink.set_nested_object_lengths(cfg.nested_object_lengths);
+  auto r = sink.apply(x);
+  assert(r);
+  return buf;
+}
+
+void configure(binary_deserializer &source, settings cfg) {
+  source.set_columnar_lists(cfg.columnar);
+  source.set_presence_bitmaps(cfg.presence_bitmaps);
+  source.set_nested_object_lengths(cfg.nested_object_lengths);
+}
+
+bool deserialize(const byte_buffer &buf, Tape &x, settings cfg) {
+  binary_deserializer source{buf};
+  configure(source, cfg);
+  return source.apply(x) && source.remaining() == 0;
+}
+
+int main() {
+  auto tape = make_tape(1000);
+  // Round trips with all layouts.
+  for (int i = 0; i < 4; ++i) {
+    settings cfg{true, (i & 1) != 0, (i & 2) != 0};
+    auto buf = serialize(tape, cfg);
+    Tape copy;
+    assert(deserialize(buf, copy, cfg));
+    assert(copy.symbol == tape.symbol && copy.session == tape.session);
+    assert(copy.trades == tape.trades);
+    auto rows = serialize(tape, settings{false, cfg.presence_bitmaps,
+                                         cfg.nested_object_lengths});
+    // Columns drop the lengths of the records.
+    assert(rows != buf && (cfg.nested_object_lengths
+                               ? rows.size() == buf.size() + 4 * 1000
+                               : rows.size() == buf.size()));
+  }
+  std::cout << "round trip: ok\n";
+  // Columns store the values of each field next to each other.
+  {
+    Tape x;
+    x.trades = make_tape(3).trades;
+    auto buf = serialize(x, settings{});
+    // The optional symbol, the list size and the first timestamp.
+    assert(buf[0] == std::byte{0} && buf[1] == std::byte{3});
+    for (size_t i = 0; i < 3; ++i) {
+      int64_t timestamp = 0;
+      binary_deserializer source{buf.data() + 2 + i * 8, 8};
+      auto r = source.value(timestamp);
+      assert(r && timestamp == x.trades[i].timestamp);
+    }
+  }
+  std::cout << "layout: ok\n";
+  // Columns compress better than rows.
+  {
+    auto rows = serialize(tape, settings{false});
+    auto columns = serialize(tape, settings{});
+    byte_buffer compressed_rows;
+    byte_buffer compressed_columns;
+    lz_compress(make_span(rows), compressed_rows);
+    lz_compress(make_span(columns), compressed_columns);
+    assert(compressed_columns.size() < compressed_rows.size());
+  }
+  std::cout << "compression: ok\n";
+  // Callbacks run once per record.
+  {
+    saves = 0;
+    loads = 0;
+    auto buf = serialize(tape, settings{});
+    Tape copy;
+    assert(deserialize(buf, copy, settings{}));
+    assert(saves == 1000 && loads == 1000);
+  }
+  std::cout << "callbacks: ok\n";
+  // Skipping and verifying columnar lists.
+  for (int i = 0; i < 4; ++i) {
+    settings cfg{true, (i & 1) != 0, (i & 2) != 0};
+    auto buf = serialize(tape, cfg);
+    binary_deserializer source{buf};
+    configure(source, cfg);
+    auto r = source.verify<Tape>();
+    assert(r && source.remaining() == 0);
+    // Loads only the last field.
+    Tape copy;
+    source.reset(buf);
+    source.set_field_mask(uint64_t{1} << 2);
+    r = source.apply(copy);
+    assert(r && copy.trades.empty() && copy.session == 7);
+  }
+  std::cout << "skip: ok\n";
+  // Truncated input.
+  {
+    auto buf = serialize(tape, settings{});
+    auto half = buf.size() / 2;
+    for (size_t size : {size_t{2}, size_t{100}, half, buf.size() - 1}) {
+      Tape copy;
+      binary_deserializer source{buf.data(), size};
+      source.set_columnar_lists(true);
+      assert(!source.apply(copy));
+    }
+    // Sizes larger than the input.
+    byte_buffer bad{std::byte{0}, std::byte{0xFF}, std::byte{0x7F}};
+    Tape copy;
+    assert(!deserialize(bad, copy, settings{}));
+  }
+  std::cout << "errors: ok\n";
+  return 0;
+}
@@ -0,0 +1,197 @@
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/binary_deserializer.hpp"
+#include "../src/binary_field_locator.hpp"
+#include "../src/binary_serializer.hpp"
+#include "../src/schema_fingerprint.hpp"
+#include "allocation_counter.hpp"
+
+using timestamp = std::chrono::time_point<std::chrono::system_clock,
+                                          std::chrono::milliseconds>;
+
+class Series {
+public:
+  std::string name;
+  std::vector<uint64_t> ids;
+  std::vector<timestamp> times;
+  std::vector<int32_t> levels;
+  uint32_t version = 0;
+};
+
+bool operator==(const Series &a, const Series &b) {
+  return a.name == b.name && a.ids == b.ids && a.times == b.times &&
+         a.levels == b.levels && a.version == b.version;
+}
+
+template <class Inspector> bool inspect(Inspector &f, Series &x) {
+  return f.object(x).fields(f.field("name", x.name),
+                            f.field("ids", x.ids).delta_packed(),
+                            f.field("times", x.times).delta_packed(),
+                            f.field("levels", x.levels).delta_packed(),
+                            f.field("version", x.version));
+}
+
+class Plain {
+public:
+  std::vector<uint64_t> ids;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Plain &x) {
+  return f.object(x).fields(f.field("ids", x.ids));
+}
+
+class Packed {
+public:
+  std::vector<uint64_t> ids;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Packed &x) {
+  return f.object(x).fields(f.field("ids", x.ids).delta_packed());
+}
+
+template <> struct type_id<Series> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+template <> struct type_id<Plain> {
+  static constexpr type_id_t value = first_custom_type_id + 1;
+};
+
+template <> struct type_id<Packed> {
+  static constexpr type_id_t value = first_custom_type_id + 2;
+};
+
+Series make_series(size_t size) {
+  Series x;
+  x.name = "sensor";
+  x.version = 3;
+  auto id = uint64_t{1} << 40;
+  auto time = timestamp{std::chrono::milliseconds{1700000000000}};
+  for (size_t i = 0; i < size; ++i) {
+    id += 1 + (i * 7) % 13;
+    x.ids.push_back(id);
+    // Fixed interval with a gap every 100 values.
+    time += std::chrono::milliseconds{i % 100 == 99 ? 250 : 10};
+    x.times.push_back(time);
+    // Unsorted and negative values.
+    x.levels.push_back(static_cast<int32_t>((i * 2654435761u) % 2001) - 1000);
+  }
+  return x;
+}
+
+template <class T> byte_buffer serialize(const T &x) {
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  auto r = sink.apply(x);
+  assert(r);
+  return buf;
+}
+
+template <class T> bool deserialize(const byte_buffer &buf, T &x) {
+  binary_deserializer source{buf};
+  return source.apply(x) && source.remaining() == 0;
+}
+
+int main() {
+  // The kernels round-trip all bit widths.
+  for (size_t width = 0; width <= 64; ++width) {
+    uint64_t in[delta_block_size - 1];
+    uint64_t words[delta_block_words];
+    uint64_t out[delta_block_size - 1];
+    auto mask = width == 64 ? ~uint64_t{0} : (uint64_t{1} << width) - 1;
+    for (size_t i = 0; i < delta_block_size - 1; ++i)
+      in[i] = (i * 0x9E3779B97F4A7C15) & mask;
+    for (size_t count : {size_t{0}, size_t{1}, size_t{33}, size_t{127}}) {
+      pack_bits(in, count, width, words);
+      unpack_bits(words, count, width, out);
+      for (size_t i = 0; i < count; ++i)
+        assert(out[i] == in[i]);
+    }
+  }
+  std::cout << "kernels: ok\n";
+  // Round trips with partial blocks.
+  for (size_t size : {0, 1, 2, 127, 128, 129, 1000}) {
+    auto x = make_series(size);
+    auto buf = serialize(x);
+    Series copy;
+    assert(deserialize(buf, copy) && copy == x);
+  }
+  std::cout << "round trip: ok\n";
+  // Sorted IDs need a few bits per value.
+  {
+    auto x = make_series(1000);
+    Plain plain{x.ids};
+    Packed packed{x.ids};
+    auto plain_buf = serialize(plain);
+    auto packed_buf = serialize(packed);
+    assert(packed_buf.size() * 4 < plain_buf.size());
+    Packed copy;
+    assert(deserialize(packed_buf, copy) && copy.ids == x.ids);
+    // Timestamps with a fixed interval need no bits at all.
+    Packed steps;
+    for (uint64_t i = 0; i < 128; ++i)
+      steps.ids.push_back(1000 + i * 10);
+    auto buf = serialize(steps);
+    assert(buf.size() == 1 + 1 + 8 + 8 + 1);
+  }
+  std::cout << "size: ok\n";
+  // Skipping, verifying and locating fields after delta-packed fields.
+  {
+    auto x = make_series(300);
+    auto buf = serialize(x);
+    binary_deserializer source{buf};
+    auto r = source.verify<Series>();
+    assert(r && source.remaining() == 0);
+    Series copy;
+    source.reset(buf);
+    source.set_field_mask(uint64_t{1} << 4);
+    r = source.apply(copy);
+    assert(r && copy.ids.empty() && copy.times.empty() && copy.version == 3);
+    field_location loc;
+    source.reset(buf);
+    binary_field_locator locator{source};
+    assert(locator.locate<Series>("version", loc) && !loc.fixed);
+    assert(loc.offset == buf.size() - 4 && loc.size == 4);
+    source.reset(buf);
+    assert(!locator.locate<Series>("ids", loc));
+    // Skipping and verifying allocate nothing.
+    auto before = allocations;
+    source.reset(buf);
+    r = source.verify<Series>();
+    assert(r && source.remaining() == 0 && allocations == before);
+    // Skipping checks the bit widths.
+    Packed packed{{1, 2, 3}};
+    auto bad = serialize(packed);
+    bad[1] = std::byte{65};
+    source.reset(bad);
+    assert(!source.verify<Packed>());
+  }
+  std::cout << "skip: ok\n";
+  // The encoding differs from plain lists.
+  assert(schema_fingerprint<Plain>() != schema_fingerprint<Packed>());
+  std::cout << "fingerprint: ok\n";
+  // Truncated input and invalid bit widths.
+  {
+    auto buf = serialize(make_series(200));
+    for (size_t size : {size_t{10}, buf.size() / 2, buf.size() - 1}) {
+      Series copy;
+      binary_deserializer source{buf.data(), size};
+      assert(!source.apply(copy));
+    }
+    Packed packed{{1, 2, 3}};
+    auto bad = serialize(packed);
+    bad[1] = std::byte{65};
+    Packed copy;
+    assert(!deserialize(bad, copy));
+    // Sizes larger than the input.
+    byte_buffer huge{std::byte{0xFF}, std::byte{0xFF}, std::byte{0x7F}};
+    assert(!deserialize(huge, copy));
+  }
+  std::cout << "errors: ok\n";
+  return 0;
+}
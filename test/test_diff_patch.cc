@@ -0,0 +1,238 @@
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../src/binary_serializer.hpp"
+#include "../src/diff_inspector.hpp"
+#include "../src/patch_loader.hpp"
+
+class Position {
+public:
+  int32_t x = 0;
+  int32_t y = 0;
+};
+
+bool operator==(const Position &a, const Position &b) {
+  return a.x == b.x && a.y == b.y;
+}
+
+template <class Inspector> bool inspect(Inspector &f, Position &x) {
+  return f.object(x).fields(f.field("x", x.x), f.field("y", x.y));
+}
+
+class Unit {
+public:
+  std::string name;
+  Position pos;
+  int32_t health = 100;
+};
+
+bool operator==(const Unit &a, const Unit &b) {
+  return a.name == b.name && a.pos == b.pos && a.health == b.health;
+}
+
+template <class Inspector> bool inspect(Inspector &f, Unit &x) {
+  return f.object(x).fields(f.field("name", x.name), f.field("pos", x.pos),
+                            f.field("health", x.health));
+}
+
+static size_t loads = 0;
+
+class World {
+public:
+  int64_t tick = 0;
+  std::string title;
+  std::vector<Unit> units;
+  std::vector<bool> flags;
+  std::vector<int32_t> scores;
+  std::optional<Position> target;
+  std::map<std::string, int32_t> counters;
+  double gravity = 9.81;
+};
+
+bool operator==(const World &a, const World &b) {
+  return a.tick == b.tick && a.title == b.title && a.units == b.units &&
+         a.flags == b.flags && a.scores == b.scores && a.target == b.target &&
+         a.counters == b.counters && a.gravity == b.gravity;
+}
+
+template <class Inspector> bool inspect(Inspector &f, World &x) {
+  return f.object(x)
+      .on_load([] {
+        ++loads;
+        return true;
+      })
+      .fields(f.field("tick", x.tick), f.field("title", x.title),
+              f.field("units", x.units), f.field("flags", x.flags),
+              f.field("scores", x.scores), f.field("target", x.target),
+              f.field("counters", x.counters),
+              f.field("gravity", x.gravity));
+}
+
+/// Stores its members behind a getter and a setter.
+class Squad {
+public:
+  const std::vector<int32_t> &members() const { return members_; }
+
+  void members(std::vector<int32_t> xs) { members_ = std::move(xs); }
+
+  int32_t rank = 0;
+  std::vector<int32_t> levels;
+
+private:
+  std::vector<int32_t> members_;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Squad &x) {
+  auto get = [&x] { return x.members(); };
+  auto set = [&x](std::vector<int32_t> xs) { x.members(std::move(xs)); };
+  auto is_valid = [](const std::vector<int32_t> &xs) { return xs.size() < 4; };
+  return f.object(x).fields(f.field("members", get, set),
+                            f.field("rank", x.rank),
+                            f.field("levels", x.levels).invariant(is_valid));
+}
+
+template <> struct type_id<Position> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+template <> struct type_id<Unit> {
+  static constexpr type_id_t value = first_custom_type_id + 1;
+};
+
+template <> struct type_id<World> {
+  static constexpr type_id_t value = first_custom_type_id + 2;
+};
+
+template <> struct type_id<Squad> {
+  static constexpr type_id_t value = first_custom_type_id + 3;
+};
+
+World make_world() {
+  World x;
+  x.tick = 1;
+  x.title = "arena";
+  for (int32_t i = 0; i < 1000; ++i)
+    x.units.push_back(Unit{"unit-" + std::to_string(i), {i, -i}, 100});
+  x.flags.assign(100, false);
+  x.scores.assign(100, 0);
+  x.counters = {{"kills", 0}, {"deaths", 0}};
+  return x;
+}
+
+/// Writes the patch from `x` to `y`, applies it to a copy of `x` and checks
+/// that the result equals `y`. Returns the size of the patch.
+size_t round_trip(const World &x, const World &y) {
+  byte_buffer buf;
+  diff_inspector f{buf};
+  auto r = f.diff(x, y);
+  assert(r && f.changed() == !(x == y));
+  auto z = x;
+  binary_deserializer source{buf};
+  patch_loader loader{source};
+  r = loader.apply(z);
+  assert(r && source.remaining() == 0);
+  assert(z == y);
+  return buf.size();
+}
+
+int main() {
+  auto world = make_world();
+  byte_buffer full;
+  binary_serializer sink(full);
+  auto r = sink.apply(world);
+  assert(r);
+  // No changes result in an empty mask, which takes two bytes for the eight
+  // fields of a World.
+  assert(round_trip(world, world) == 2);
+  std::cout << "unchanged: ok\n";
+  // Scalar fields.
+  {
+    auto next = world;
+    next.tick = 2;
+    next.gravity = 1.62;
+    // The mask of fields 0 and 7.
+    assert(round_trip(world, next) == 2 + 8 + 8);
+  }
+  std::cout << "fields: ok\n";
+  // Nested objects in lists that keep their size.
+  {
+    auto next = world;
+    next.units[500].pos.x = 7;
+    next.units[999].health = 50;
+    next.flags[3] = true;
+    next.scores[42] = 10;
+    auto size = round_trip(world, next);
+    assert(size < 100);
+    assert(size * 100 < full.size());
+  }
+  std::cout << "nested: ok\n";
+  // Lists that change their size, optional values and maps.
+  {
+    auto next = world;
+    next.units.pop_back();
+    next.units[0].name = "hero";
+    next.flags.push_back(true);
+    next.target = Position{1, 2};
+    next.counters["kills"] = 3;
+    round_trip(world, next);
+    round_trip(next, world);
+    auto other = next;
+    other.target->y = 5;
+    round_trip(next, other);
+  }
+  std::cout << "replace: ok\n";
+  // Virtual fields contain the whole list, fields with an invariant a patch.
+  {
+    Squad x;
+    x.members({1, 2, 3});
+    x.levels = {1, 1, 1};
+    for (auto members : {std::vector<int32_t>{}, std::vector<int32_t>{1, 5, 3},
+                         std::vector<int32_t>{1, 2, 3, 4}}) {
+      auto y = x;
+      y.members(members);
+      y.rank = 1;
+      y.levels[1] = 2;
+      byte_buffer buf;
+      diff_inspector f{buf};
+      r = f.diff(x, y);
+      assert(r && f.changed());
+      auto z = x;
+      binary_deserializer source{buf};
+      patch_loader loader{source};
+      r = loader.apply(z);
+      assert(r && source.remaining() == 0);
+      assert(z.members() == members && z.rank == 1);
+      assert(z.levels == y.levels);
+    }
+  }
+  std::cout << "virtual fields: ok\n";
+  // Callbacks run after applying a patch.
+  {
+    auto next = world;
+    next.title = "desert";
+    byte_buffer buf;
+    diff_inspector f{buf};
+    r = f.diff(world, next);
+    assert(r);
+    auto before = loads;
+    auto x = world;
+    binary_deserializer source{buf};
+    patch_loader loader{source};
+    r = loader.apply(x);
+    assert(r && x.title == "desert" && loads == before + 1);
+    // Truncated patches.
+    for (size_t size = 0; size < buf.size(); ++size) {
+      auto y = world;
+      binary_deserializer truncated{buf.data(), size};
+      patch_loader truncated_loader{truncated};
+      assert(!truncated_loader.apply(y));
+    }
+  }
+  std::cout << "errors: ok\n";
+  return 0;
+}
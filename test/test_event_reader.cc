@@ -0,0 +1,208 @@
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "../src/binary_event_reader.hpp"
+#include "../src/binary_serializer.hpp"
+#include "allocation_counter.hpp"
+
+class Point {
+public:
+  int32_t x = 0;
+  int32_t y = 0;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Point &x) {
+  return f.object(x).fields(f.field("x", x.x), f.field("y", x.y));
+}
+
+class Shape {
+public:
+  std::string name;
+  std::vector<Point> points;
+  std::optional<double> area;
+  std::variant<uint16_t, std::string> color;
+  std::map<std::string, bool> tags;
+  std::vector<std::string> labels;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Shape &x) {
+  return f.object(x).fields(f.field("name", x.name),
+                            f.field("points", x.points),
+                            f.field("area", x.area), f.field("color", x.color),
+                            f.field("tags", x.tags),
+                            f.field("labels", x.labels));
+}
+
+class Series {
+public:
+  std::vector<uint32_t> ids;
+  std::vector<std::chrono::milliseconds> delays;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Series &x) {
+  return f.object(x).fields(f.field("ids", x.ids).delta_packed(),
+                            f.field("delays", x.delays).delta_packed());
+}
+
+template <> struct type_id<Point> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+template <> struct type_name<Point> {
+  static constexpr std::string_view value = "point";
+};
+
+template <> struct type_id<Shape> {
+  static constexpr type_id_t value = first_custom_type_id + 1;
+};
+
+template <> struct type_name<Shape> {
+  static constexpr std::string_view value = "shape";
+};
+
+template <> struct type_id<Series> {
+  static constexpr type_id_t value = first_custom_type_id + 2;
+};
+
+template <> struct type_name<Series> {
+  static constexpr std::string_view value = "series";
+};
+
+/// Prints all events in a compact notation.
+class printer : public event_handler {
+public:
+  std::string out;
+
+  void on_begin_object(type_id_t, std::string_view name) {
+    out += std::string{name} + "{";
+  }
+  void on_end_object() { out += "}"; }
+  void on_field(std::string_view name) { out += std::string{name} + "="; }
+  void on_absent_field(std::string_view name) {
+    out += std::string{name} + "=null ";
+  }
+  void on_begin_sequence(size_t n) { out += "[" + std::to_string(n) + ":"; }
+  void on_end_sequence() { out += "]"; }
+  void on_begin_map(size_t n) { out += "<" + std::to_string(n) + ":"; }
+  void on_end_map() { out += ">"; }
+  void on_bool(bool x) { out += x ? "true " : "false "; }
+  void on_int64(int64_t x) { out += std::to_string(x) + " "; }
+  void on_uint64(uint64_t x) { out += std::to_string(x) + "u "; }
+  void on_double(double x) { out += std::to_string(x) + " "; }
+  void on_string(std::string_view x) { out += "'" + std::string{x} + "' "; }
+};
+
+/// Counts labels and sums up the coordinates of points.
+class aggregator : public event_handler {
+public:
+  std::string_view field;
+  size_t labels = 0;
+  int64_t sum = 0;
+
+  void on_field(std::string_view name) { field = name; }
+  void on_string(std::string_view) {
+    if (field == "labels")
+      ++labels;
+  }
+  void on_int64(int64_t x) { sum += x; }
+};
+
+int main() {
+  Shape shape{"triangle",
+              {{0, 0}, {4, 0}, {0, 3}},
+              std::nullopt,
+              uint16_t{7},
+              {{"closed", true}},
+              {"a", "b", "c"}};
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  auto r = sink.apply(shape);
+  assert(r);
+  {
+    printer handler;
+    binary_deserializer source{buf};
+    binary_event_reader reader{source, handler};
+    r = reader.read<Shape>();
+    assert(r && source.remaining() == 0);
+    assert(handler.out == "shape{name='triangle' points=[3:point{x=0 y=0 }"
+                          "point{x=4 y=0 }point{x=0 y=3 }]area=null "
+                          "color=7u tags=<1:'closed' true >"
+                          "labels=[3:'a' 'b' 'c' ]}");
+  }
+  std::cout << "events: ok\n";
+  {
+    std::vector<Shape> shapes(100, shape);
+    buf.clear();
+    binary_serializer sink(buf);
+    for (auto &x : shapes) {
+      r = sink.apply(x);
+      assert(r);
+    }
+    aggregator handler;
+    binary_deserializer source{buf};
+    binary_event_reader reader{source, handler};
+    auto before = allocations;
+    while (source.remaining() > 0) {
+      r = reader.read<Shape>();
+      assert(r);
+    }
+    assert(allocations == before);
+    assert(handler.labels == 300 && handler.sum == 700);
+  }
+  std::cout << "aggregation: ok\n";
+  // Delta-packed lists report their elements instead of the blocks.
+  {
+    using std::chrono::milliseconds;
+    Series series{{100, 101, 102}, {milliseconds{5}, milliseconds{3}}};
+    for (uint32_t i = 0; i < 200; ++i)
+      series.ids.push_back(1000 + 7 * i);
+    byte_buffer tmp;
+    binary_serializer tmp_sink(tmp);
+    r = tmp_sink.apply(series);
+    assert(r);
+    printer handler;
+    binary_deserializer source{tmp};
+    binary_event_reader reader{source, handler};
+    r = reader.read<Series>();
+    assert(r && source.remaining() == 0);
+    std::string ids = "[203:100u 101u 102u ";
+    for (uint32_t i = 0; i < 200; ++i)
+      ids += std::to_string(1000 + 7 * i) + "u ";
+    assert(handler.out == "series{ids=" + ids + "]delays=[2:5 3 ]}");
+  }
+  std::cout << "delta-packed: ok\n";
+  // Columnar lists report their columns.
+  {
+    byte_buffer tmp;
+    binary_serializer tmp_sink(tmp);
+    tmp_sink.set_columnar_lists(true);
+    r = tmp_sink.apply(shape);
+    assert(r);
+    printer handler;
+    binary_deserializer source{tmp};
+    source.set_columnar_lists(true);
+    binary_event_reader reader{source, handler};
+    r = reader.read<Shape>();
+    assert(r && source.remaining() == 0);
+    assert(handler.out == "shape{name='triangle' points=[3:x=0 x=4 x=0 y=0 "
+                          "y=0 y=3 ]area=null color=7u tags=<1:'closed' "
+                          "true >labels=[3:'a' 'b' 'c' ]}");
+  }
+  std::cout << "columnar: ok\n";
+  {
+    printer handler;
+    binary_deserializer source{buf.data(), 10};
+    binary_event_reader reader{source, handler};
+    r = reader.read<Shape>();
+    assert(!r);
+  }
+  std::cout << "errors: ok\n";
+  return 0;
+}
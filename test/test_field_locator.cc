@@ -0,0 +1,162 @@
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <variant>
+
+#include "../src/binary_field_locator.hpp"
+#include "../src/binary_serializer.hpp"
+
+class Header {
+public:
+  uint8_t hops = 0;
+  int64_t timestamp = 0;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Header &x) {
+  return f.object(x).fields(f.field("hops", x.hops),
+                            f.field("timestamp", x.timestamp));
+}
+
+class Packet {
+public:
+  Header header;
+  int32_t id = 0;
+  std::string payload;
+  std::variant<int32_t, std::string> route;
+  std::optional<double> weight;
+  bool urgent = false;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Packet &x) {
+  return f.object(x).fields(f.field("header", x.header), f.field("id", x.id),
+                            f.field("payload", x.payload),
+                            f.field("route", x.route),
+                            f.field("weight", x.weight),
+                            f.field("urgent", x.urgent));
+}
+
+template <> struct type_id<Header> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+template <> struct type_id<Packet> {
+  static constexpr type_id_t value = first_custom_type_id + 1;
+};
+
+Packet make_packet() {
+  Packet x;
+  x.header = Header{3, 1000};
+  x.id = 42;
+  x.payload = "hello";
+  x.route = std::string{"north"};
+  x.weight = 2.5;
+  return x;
+}
+
+bool locate(const byte_buffer &buf, std::string_view path, field_location &loc,
+            bool nested_object_lengths = false) {
+  binary_deserializer source{buf};
+  source.set_nested_object_lengths(nested_object_lengths);
+  binary_field_locator locator{source};
+  return locator.locate<Packet>(path, loc);
+}
+
+int main() {
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  auto r = sink.apply(make_packet());
+  assert(r);
+  // Fields with a fixed-size prefix.
+  {
+    field_location loc;
+    assert(locate(buf, "header.hops", loc));
+    assert(loc.offset == 0 && loc.size == 1 && loc.fixed);
+    assert(locate(buf, "header.timestamp", loc));
+    assert(loc.offset == 1 && loc.size == 8 && loc.fixed);
+    assert(locate(buf, "id", loc));
+    assert(loc.offset == 9 && loc.size == 4 && loc.fixed);
+    // The offset depends on the size of the payload and the route.
+    assert(locate(buf, "weight", loc));
+    assert(loc.size == 8 && !loc.fixed);
+    assert(locate(buf, "urgent", loc));
+    assert(loc.offset == buf.size() - 1 && loc.size == 1 && !loc.fixed);
+  }
+  std::cout << "locate: ok\n";
+  // Missing fields and fields without a fixed size.
+  {
+    field_location loc;
+    assert(!locate(buf, "header.ttl", loc));
+    assert(!locate(buf, "hops", loc));
+    assert(!locate(buf, "payload", loc));
+    assert(!locate(buf, "header", loc));
+    assert(!locate(buf, "route", loc));
+    assert(!locate(buf, "id.value", loc));
+    assert(!locate(buf, "", loc));
+    auto packet = make_packet();
+    packet.weight = std::nullopt;
+    byte_buffer tmp;
+    binary_serializer tmp_sink(tmp);
+    r = tmp_sink.apply(packet);
+    assert(r);
+    assert(!locate(tmp, "weight", loc));
+    byte_buffer prefix{buf.begin(), buf.begin() + 5};
+    assert(!locate(prefix, "id", loc));
+  }
+  std::cout << "missing: ok\n";
+  // Updating fields in place.
+  {
+    field_location hops;
+    field_location timestamp;
+    field_location id;
+    field_location urgent;
+    r = locate(buf, "header.hops", hops) &&
+        locate(buf, "header.timestamp", timestamp) && locate(buf, "id", id) &&
+        locate(buf, "urgent", urgent);
+    assert(r);
+    auto size = buf.size();
+    r = sink.overwrite_value(hops, uint8_t{4}) &&
+        sink.overwrite_value(timestamp, int64_t{2000}) &&
+        sink.overwrite_value(id, int32_t{43}) &&
+        sink.overwrite_value(urgent, true);
+    assert(r && buf.size() == size && sink.write_pos() == size);
+    Packet x;
+    binary_deserializer source{buf};
+    r = source.apply(x);
+    assert(r && x.header.hops == 4 && x.header.timestamp == 2000);
+    assert(x.id == 43 && x.payload == "hello" && x.urgent);
+    // Values with another size.
+    assert(!sink.overwrite_value(id, int64_t{0}));
+    assert(!sink.overwrite_value(urgent, int32_t{0}));
+    // Objects after the end of the buffer.
+    assert(!sink.overwrite_value(id, int32_t{0}, size));
+    assert(sink.write_pos() == size);
+  }
+  std::cout << "overwrite: ok\n";
+  // Nested object lengths.
+  {
+    byte_buffer tmp;
+    binary_serializer tmp_sink(tmp);
+    tmp_sink.set_nested_object_lengths(true);
+    r = tmp_sink.apply(make_packet());
+    assert(r);
+    field_location loc;
+    assert(locate(tmp, "header.timestamp", loc, true));
+    assert(loc.offset == 5 && loc.fixed);
+    assert(locate(tmp, "id", loc, true));
+    assert(loc.offset == 13 && loc.fixed);
+    // The locator leaves the deserializer at the top level.
+    binary_deserializer source{tmp};
+    source.set_nested_object_lengths(true);
+    binary_field_locator locator{source};
+    assert(locator.locate<Packet>("id", loc));
+    assert(source.depth() == 0);
+    Packet x;
+    source.reset(tmp);
+    r = source.apply(x);
+    assert(r && x.id == 42 && x.payload == "hello");
+  }
+  std::cout << "nested object lengths: ok\n";
+  return 0;
+}
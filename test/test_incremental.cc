@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../src/binary_serializer.hpp"
+#include "../src/incremental_deserializer.hpp"
+
+static size_t loads = 0;
+
+class Person {
+public:
+  std::string name;
+  int age;
+  std::vector<std::string> tags;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Person &x) {
+  return f.object(x)
+      .on_load([] {
+        ++loads;
+        return true;
+      })
+      .fields(f.field("name", x.name), f.field("age", x.age),
+              f.field("tags", x.tags));
+}
+
+class Team {
+public:
+  std::string name;
+  std::map<std::string, Person> members;
+  std::vector<std::vector<int32_t>> shifts;
+  std::optional<Person> coach;
+  std::shared_ptr<Person> lead;
+  std::shared_ptr<Person> deputy;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Team &x) {
+  return f.object(x).fields(f.field("name", x.name),
+                            f.field("members", x.members),
+                            f.field("shifts", x.shifts),
+                            f.field("coach", x.coach), f.field("lead", x.lead),
+                            f.field("deputy", x.deputy));
+}
+
+template <> struct type_id<Person> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+template <> struct type_id<Team> {
+  static constexpr type_id_t value = first_custom_type_id + 1;
+};
+
+/// Feeds `buf` in pieces of `piece_size` bytes and returns all messages.
+std::vector<Person> feed_all(incremental_deserializer<Person> &source,
+                             const byte_buffer &buf, size_t piece_size) {
+  std::vector<Person> received;
+  for (size_t pos = 0; pos < buf.size(); pos += piece_size) {
+    auto len = std::min(piece_size, buf.size() - pos);
+    auto status = source.feed(make_span(buf.data() + pos, len));
+    while (status == decode_status::done) {
+      received.emplace_back(source.value());
+      status = source.feed({});
+    }
+    assert(status == decode_status::need_more);
+  }
+  return received;
+}
+
+int main() {
+  Person p1{"tom", 10, {"a", "bb", "ccc"}};
+  Person p2{"jerry", 20, {}};
+  // Feeds both messages in 3-byte pieces.
+  for (auto typed : {false, true}) {
+    byte_buffer buf;
+    binary_serializer sink(buf);
+    sink.set_typed_stream(typed);
+    bool r = sink.apply(p1) && sink.apply(p2);
+    assert(r);
+    incremental_deserializer<Person> source{
+        [typed](binary_deserializer &src) { src.set_typed_stream(typed); }};
+    loads = 0;
+    auto received = feed_all(source, buf, 3);
+    assert(received.size() == 2 && loads == 2);
+    assert(received[0].name == "tom" && received[0].age == 10);
+    assert(received[0].tags == p1.tags);
+    assert(received[1].name == "jerry" && received[1].age == 20);
+    assert(received[1].tags.empty());
+    assert(source.buffered() == 0);
+  }
+  std::cout << "pieces: ok\n";
+  // Large messages get decoded while they arrive and only buffer the bytes
+  // of a cut string.
+  for (auto typed : {false, true}) {
+    Person big{"big", 1, {}};
+    for (int i = 0; i < 50000; ++i)
+      big.tags.emplace_back("tag number " + std::to_string(i));
+    byte_buffer buf;
+    binary_serializer sink(buf);
+    sink.set_typed_stream(typed);
+    bool r = sink.apply(big) && sink.apply(p1);
+    assert(r);
+    incremental_deserializer<Person> source{
+        [typed](binary_deserializer &src) { src.set_typed_stream(typed); }};
+    loads = 0;
+    auto half = buf.size() / 2;
+    for (size_t pos = 0; pos < half; pos += 4096) {
+      auto len = std::min(size_t{4096}, half - pos);
+      auto status = source.feed(make_span(buf.data() + pos, len));
+      assert(status == decode_status::need_more);
+      assert(source.buffered() < 32);
+    }
+    auto &tags = source.value().tags;
+    assert(tags.size() > 20000 && tags.size() < 30000 && loads == 0);
+    assert(std::equal(tags.begin(), tags.end(), big.tags.begin()));
+    auto rest = byte_buffer{buf.begin() + static_cast<ptrdiff_t>(half),
+                            buf.end()};
+    auto received = feed_all(source, rest, 4096);
+    assert(received.size() == 2 && loads == 2);
+    assert(received[0].tags == big.tags && received[1].name == "tom");
+  }
+  std::cout << "large: ok\n";
+  // Maps, nested lists, optional values and shared objects byte by byte.
+  {
+    Team team;
+    team.name = "blue";
+    team.members = {{"tom", p1}, {"jerry", p2}};
+    team.shifts = {{1, 2, 3}, {}, {4}};
+    team.coach = p1;
+    team.lead = std::make_shared<Person>(p2);
+    team.deputy = team.lead;
+    byte_buffer buf;
+    binary_serializer sink(buf);
+    bool r = sink.apply(team) && sink.apply(Team{});
+    assert(r);
+    incremental_deserializer<Team> source;
+    std::vector<Team> received;
+    for (size_t pos = 0; pos < buf.size(); ++pos) {
+      auto status = source.feed(make_span(buf.data() + pos, 1));
+      while (status == decode_status::done) {
+        received.emplace_back(source.value());
+        status = source.feed({});
+      }
+      assert(status == decode_status::need_more);
+    }
+    assert(received.size() == 2);
+    auto &x = received[0];
+    assert(x.name == "blue" && x.members.size() == 2);
+    assert(x.members["tom"].tags == p1.tags);
+    assert(x.members["jerry"].name == "jerry");
+    assert(x.shifts == team.shifts && x.coach && x.coach->name == "tom");
+    assert(x.lead && x.lead->name == "jerry" && x.lead == x.deputy);
+    assert(received[1].members.empty() && received[1].shifts.empty());
+    assert(!received[1].coach && !received[1].lead);
+  }
+  std::cout << "nested: ok\n";
+  // Malformed input.
+  {
+    byte_buffer buf;
+    binary_serializer sink(buf);
+    sink.set_typed_stream(true);
+    bool r = sink.apply(p1);
+    assert(r);
+    buf[0] = std::byte{0x7F};
+    incremental_deserializer<Person> source{
+        [](binary_deserializer &src) { src.set_typed_stream(true); }};
+    assert(source.feed(make_span(buf)) == decode_status::failed);
+    assert(source.get_error() != error_code::success);
+    // Decoding stops after the first error.
+    assert(source.feed({}) == decode_status::failed);
+  }
+  // Messages that exceed the limit fail before their bytes arrive. In the
+  // typed stream mode, the header announces the size.
+  for (auto typed : {false, true}) {
+    byte_buffer buf;
+    binary_serializer sink(buf);
+    sink.set_typed_stream(typed);
+    bool r = sink.apply(p1);
+    assert(r);
+    incremental_deserializer<Person> source{
+        [typed](binary_deserializer &src) { src.set_typed_stream(typed); },
+        typed ? size_t{4} : buf.size() - 1};
+    auto status = decode_status::need_more;
+    auto pos = size_t{0};
+    for (; pos < buf.size(); ++pos) {
+      status = source.feed(make_span(buf.data() + pos, 1));
+      if (status != decode_status::need_more)
+        break;
+    }
+    assert(status == decode_status::failed);
+    assert(pos == (typed ? size_t{5} : buf.size() - 2));
+  }
+  // Settings that the decoder cannot resume.
+  {
+    incremental_deserializer<Person> source{
+        [](binary_deserializer &src) { src.set_presence_bitmaps(true); }};
+    assert(source.feed({}) == decode_status::failed);
+    assert(source.get_error() != error_code::success);
+  }
+  std::cout << "errors: ok\n";
+  return 0;
+}
@@ -0,0 +1,100 @@
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/binary_serializer.hpp"
+#include "../src/lazy_sequence.hpp"
+
+class Row {
+public:
+  int64_t id;
+  std::string payload;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Row &x) {
+  return f.object(x).fields(f.field("id", x.id),
+                            f.field("payload", x.payload));
+}
+
+template <> struct type_id<Row> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+int main() {
+  std::vector<Row> rows;
+  for (int64_t i = 0; i < 1000; ++i)
+    rows.push_back(Row{i, std::string(static_cast<size_t>(i % 50), 'x')});
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  auto r = sink.apply(rows) && sink.apply(int32_t{42});
+  assert(r);
+  // Range-based for loop.
+  {
+    binary_deserializer source{buf};
+    lazy_sequence<Row> seq{source};
+    assert(seq.ok() && seq.size() == rows.size());
+    int64_t expected = 0;
+    for (auto &row : seq) {
+      assert(row.id == expected);
+      assert(row.payload.size() == static_cast<size_t>(expected % 50));
+      ++expected;
+    }
+    assert(expected == 1000 && seq.ok() && seq.remaining() == 0);
+    // The deserializer continues after the sequence.
+    int32_t trailer = 0;
+    r = source.apply(trailer);
+    assert(r && trailer == 42);
+    // A range can only be traversed once.
+    assert(seq.begin() == seq.end());
+  }
+  std::cout << "range: ok\n";
+  // Pulling elements with next.
+  {
+    binary_deserializer source{buf};
+    lazy_sequence<Row> seq{source};
+    Row row;
+    size_t count = 0;
+    while (seq.next(row))
+      ++count;
+    assert(count == 1000 && seq.ok());
+  }
+  std::cout << "next: ok\n";
+  // Empty sequences.
+  {
+    byte_buffer empty;
+    binary_serializer empty_sink(empty);
+    r = empty_sink.apply(std::vector<Row>{});
+    assert(r);
+    binary_deserializer source{empty};
+    lazy_sequence<Row> seq{source};
+    assert(seq.ok() && seq.size() == 0 && seq.begin() == seq.end());
+    assert(source.remaining() == 0);
+  }
+  std::cout << "empty: ok\n";
+  // Truncated input stops the iteration.
+  {
+    binary_deserializer source{buf.data(), buf.size() / 2};
+    lazy_sequence<Row> seq{source};
+    size_t count = 0;
+    for (auto it = seq.begin(); it != seq.end(); ++it)
+      ++count;
+    assert(count > 0 && count < 1000 && !seq.ok());
+  }
+  // Columnar lists have no elements to load one at a time.
+  {
+    binary_deserializer source{buf};
+    source.set_columnar_lists(true);
+    lazy_sequence<Row> seq{source};
+    assert(!seq.ok() && seq.begin() == seq.end());
+    assert(source.get_error() != error_code::success);
+    // Lists of other types keep their layout.
+    binary_deserializer other{buf};
+    other.set_columnar_lists(true);
+    lazy_sequence<int64_t> ids{other};
+    assert(ids.ok() && ids.size() == rows.size());
+  }
+  std::cout << "errors: ok\n";
+  return 0;
+}
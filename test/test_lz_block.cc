@@ -0,0 +1,147 @@
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/binary_deserializer.hpp"
+#include "../src/binary_serializer.hpp"
+#include "../src/lz_block.hpp"
+
+class Trade {
+public:
+  std::string symbol;
+  std::string venue;
+  int64_t price;
+  int32_t quantity;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Trade &x) {
+  return f.object(x).fields(f.field("symbol", x.symbol),
+                            f.field("venue", x.venue),
+                            f.field("price", x.price),
+                            f.field("quantity", x.quantity));
+}
+
+void roundtrip(const byte_buffer &input) {
+  byte_buffer compressed;
+  lz_compress(make_span(input), compressed);
+  byte_buffer output(input.size());
+  bool r = lz_decompress(make_span(compressed), make_span(output));
+  assert(r);
+  assert(output == input);
+  // truncated input never decodes
+  if (!input.empty()) {
+    auto truncated = make_span(compressed.data(), compressed.size() - 1);
+    r = lz_decompress(as_bytes(truncated), make_span(output));
+    assert(!r);
+  }
+}
+
+int main() {
+  std::mt19937 rng{42};
+  byte_buffer random(10000);
+  for (auto &b : random)
+    b = static_cast<std::byte>(rng());
+  byte_buffer runs(10000, std::byte{7});
+  byte_buffer small{std::byte{1}, std::byte{2}, std::byte{3}};
+  roundtrip({});
+  roundtrip(small);
+  roundtrip(random);
+  roundtrip(runs);
+  // frames: serialized records compress, random data is stored raw
+  std::vector<Trade> trades;
+  for (int i = 0; i < 1000; ++i)
+    trades.push_back(Trade{"SYM" + std::to_string(i % 17), "XNAS", 1000 + i,
+                           i % 100});
+  byte_buffer payload;
+  binary_serializer sink(payload);
+  bool r = sink.apply(trades);
+  assert(r);
+  byte_buffer frames;
+  write_frame(make_span(payload), frames);
+  auto compressed_size = frames.size();
+  write_frame(make_span(random), frames);
+  write_frame(make_span(small), frames);
+  assert(frames[0] == static_cast<std::byte>(frame_method::lz));
+  assert(compressed_size < payload.size() / 2);
+  span<const std::byte> input = make_span(frames);
+  byte_buffer scratch;
+  span<const std::byte> decoded;
+  r = read_frame(input, scratch, decoded);
+  assert(r);
+  binary_deserializer source{decoded};
+  std::vector<Trade> received;
+  r = source.apply(received);
+  assert(r && received.size() == trades.size());
+  assert(received.back().symbol == trades.back().symbol);
+  r = read_frame(input, scratch, decoded);
+  assert(r && decoded.size() == random.size());
+  assert(decoded.data() != scratch.data()); // raw frames are not copied
+  r = read_frame(input, scratch, decoded);
+  assert(r && decoded.size() == small.size() && input.empty());
+  std::cout << "compressed " << payload.size() << " bytes of trades into "
+            << compressed_size << " bytes\n";
+  // frames with a payload size beyond the expansion limit of their input
+  {
+    byte_buffer bad{static_cast<std::byte>(frame_method::lz)};
+    for (auto x : {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F, 0x08})
+      bad.emplace_back(static_cast<std::byte>(x));
+    bad.resize(bad.size() + 8);
+    span<const std::byte> bad_input = make_span(bad);
+    byte_buffer bad_scratch;
+    r = read_frame(bad_input, bad_scratch, decoded);
+    assert(!r && bad_scratch.capacity() == 0);
+  }
+  // small messages compress against a trained dictionary
+  std::vector<byte_buffer> messages;
+  for (int i = 0; i < 200; ++i) {
+    byte_buffer msg;
+    binary_serializer out(msg);
+    Trade t{"instrument.equity.SYM" + std::to_string(i % 50),
+            "venue.nasdaq.primary", 1000 + i, i};
+    r = out.apply(t);
+    assert(r);
+    messages.emplace_back(std::move(msg));
+  }
+  std::vector<span<const std::byte>> samples;
+  for (size_t i = 0; i < 100; ++i)
+    samples.emplace_back(make_span(messages[i]));
+  auto dict = lz_dictionary::train(make_span(samples), 4096);
+  assert(!dict.content().empty() && dict.content().size() <= 4096);
+  size_t plain_size = 0;
+  size_t dict_size = 0;
+  for (size_t i = 100; i < messages.size(); ++i) {
+    auto &msg = messages[i];
+    byte_buffer plain;
+    byte_buffer compressed;
+    lz_compress(make_span(msg), plain);
+    lz_compress(make_span(msg), compressed, dict);
+    plain_size += plain.size();
+    dict_size += compressed.size();
+    byte_buffer output(msg.size());
+    r = lz_decompress(make_span(compressed), make_span(output), dict);
+    assert(r && output == msg);
+    byte_buffer frame;
+    write_frame(make_span(msg), frame, dict, frame_options{16, 8});
+    span<const std::byte> frame_input = make_span(frame);
+    r = read_frame(frame_input, scratch, decoded, dict);
+    assert(r && frame_input.empty());
+    assert(byte_buffer(decoded.begin(), decoded.end()) == msg);
+  }
+  assert(dict_size < plain_size);
+  // A divisor of 0 accepts any saving.
+  {
+    auto &msg = messages.back();
+    byte_buffer frame;
+    write_frame(make_span(msg), frame, frame_options{16, 0});
+    span<const std::byte> frame_input = make_span(frame);
+    r = read_frame(frame_input, scratch, decoded);
+    assert(r && frame_input.empty());
+    assert(byte_buffer(decoded.begin(), decoded.end()) == msg);
+  }
+  std::cout << "dictionary: " << dict_size << " bytes instead of "
+            << plain_size << " bytes for 100 small messages\n";
+  return 0;
+}
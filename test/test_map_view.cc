@@ -0,0 +1,236 @@
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../src/binary_serializer.hpp"
+#include "../src/map_view.hpp"
+#include "allocation_counter.hpp"
+
+class Slot {
+public:
+  int32_t day = 0;
+  int32_t hour = 0;
+};
+
+bool operator==(const Slot &a, const Slot &b) {
+  return a.day == b.day && a.hour == b.hour;
+}
+
+template <class Inspector> bool inspect(Inspector &f, Slot &x) {
+  return f.object(x).fields(f.field("day", x.day), f.field("hour", x.hour));
+}
+
+class Account {
+public:
+  int64_t balance = 0;
+  std::map<std::string, int32_t> limits;
+  std::vector<Slot> slots;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Account &x) {
+  return f.object(x).fields(f.field("balance", x.balance),
+                            f.field("limits", x.limits),
+                            f.field("slots", x.slots));
+}
+
+class Bank {
+public:
+  std::string name;
+  std::unordered_map<std::string, Account> accounts;
+  int32_t branch = 0;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Bank &x) {
+  return f.object(x).fields(f.field("name", x.name),
+                            f.field("accounts", x.accounts),
+                            f.field("branch", x.branch));
+}
+
+// A key with a hash but without operator<.
+class Cell {
+public:
+  int32_t row = 0;
+  int32_t col = 0;
+};
+
+bool operator==(const Cell &a, const Cell &b) {
+  return a.row == b.row && a.col == b.col;
+}
+
+namespace std {
+
+template <> struct hash<Cell> {
+  size_t operator()(const Cell &x) const noexcept {
+    return hash<int64_t>{}(int64_t{x.row} << 32 | uint32_t(x.col));
+  }
+};
+
+} // namespace std
+
+template <class Inspector> bool inspect(Inspector &f, Cell &x) {
+  return f.object(x).fields(f.field("row", x.row), f.field("col", x.col));
+}
+
+template <> struct type_id<Account> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+template <> struct type_id<Bank> {
+  static constexpr type_id_t value = first_custom_type_id + 1;
+};
+
+template <> struct type_id<Slot> {
+  static constexpr type_id_t value = first_custom_type_id + 2;
+};
+
+Bank make_bank() {
+  Bank x;
+  x.name = "central";
+  x.branch = 7;
+  for (int64_t i = 0; i < 100; ++i) {
+    auto key = "account-" + std::to_string(i * 7 % 100);
+    auto hour = static_cast<int32_t>(i % 24);
+    x.accounts[key] = Account{i,
+                              {{"daily", static_cast<int32_t>(i)}},
+                              {{1, hour}, {2, hour + 1}, {3, hour + 2}}};
+  }
+  return x;
+}
+
+int main() {
+  // Top-level maps.
+  {
+    std::map<std::string, int32_t> xs;
+    for (int32_t i = 0; i < 50; ++i)
+      xs["key-" + std::to_string(i)] = i;
+    byte_buffer buf;
+    binary_serializer sink(buf);
+    sink.set_indexed_maps(true);
+    auto r = sink.apply(xs);
+    assert(r);
+    map_view<std::string, int32_t> view{make_span(buf)};
+    assert(view.ok() && view.size() == 50);
+    std::vector<std::string> keys;
+    for (int32_t i = 0; i < 50; ++i)
+      keys.push_back("key-" + std::to_string(i));
+    auto before = allocations;
+    for (int32_t i = 0; i < 50; ++i) {
+      auto value = int32_t{-1};
+      assert(view.find(keys[static_cast<size_t>(i)], value) && value == i);
+    }
+    assert(view.contains("key-7") && !view.contains("key-50"));
+    assert(!view.contains("") && !view.contains("zzz"));
+    assert(allocations == before);
+    // Loading still works in the indexed maps mode.
+    std::map<std::string, int32_t> ys;
+    binary_deserializer source{buf};
+    source.set_indexed_maps(true);
+    r = source.apply(ys);
+    assert(r && ys == xs && source.remaining() == 0);
+    // Keys other than strings.
+    std::unordered_map<int32_t, std::string> zs{{3, "c"}, {1, "a"}, {2, "b"}};
+    buf.clear();
+    binary_serializer int_sink(buf);
+    int_sink.set_indexed_maps(true);
+    r = int_sink.apply(zs);
+    assert(r);
+    map_view<int32_t, std::string> int_view{make_span(buf)};
+    std::string str;
+    assert(int_view.find(2, str) && str == "b");
+    assert(int_view.find(3, str) && str == "c");
+    assert(!int_view.find(4, str) && !int_view.contains(0));
+  }
+  // Keys without operator< only work without indexed maps.
+  {
+    std::unordered_map<Cell, int32_t> xs{{Cell{1, 2}, 3}, {Cell{4, 5}, 6}};
+    byte_buffer buf;
+    binary_serializer sink(buf);
+    auto r = sink.apply(xs);
+    assert(r);
+    std::unordered_map<Cell, int32_t> ys;
+    binary_deserializer source{buf};
+    r = source.apply(ys);
+    assert(r && ys == xs);
+    buf.clear();
+    sink.seek(0);
+    sink.set_indexed_maps(true);
+    assert(!sink.apply(xs) && sink.get_error());
+  }
+  std::cout << "top-level maps: ok\n";
+  // Maps inside of objects with all layout options.
+  for (int mode = 0; mode < 4; ++mode) {
+    auto nested_object_lengths = (mode & 1) != 0;
+    auto columnar_lists = (mode & 2) != 0;
+    auto bank = make_bank();
+    byte_buffer buf;
+    binary_serializer sink(buf);
+    sink.set_indexed_maps(true);
+    sink.set_presence_bitmaps(true);
+    sink.set_nested_object_lengths(nested_object_lengths);
+    sink.set_columnar_lists(columnar_lists);
+    auto r = sink.apply(bank);
+    assert(r);
+    binary_deserializer source{buf};
+    source.set_indexed_maps(true);
+    source.set_presence_bitmaps(true);
+    source.set_nested_object_lengths(nested_object_lengths);
+    source.set_columnar_lists(columnar_lists);
+    // Read the fields by hand to find the map.
+    std::string name;
+    r = source.begin_object(type_id_v<Bank>, "Bank") &&
+        source.begin_field("name") && source.apply(name) &&
+        source.end_field() && source.begin_field("accounts");
+    assert(r && name == "central");
+    map_view<std::string, Account> view{source};
+    assert(view.ok() && view.size() == 100);
+    auto branch = int32_t{0};
+    r = source.end_field() && source.begin_field("branch") &&
+        source.apply(branch) && source.end_field() && source.end_object();
+    assert(r && branch == 7 && source.remaining() == 0);
+    Account account;
+    assert(view.find("account-42", account));
+    assert(account.balance == bank.accounts["account-42"].balance);
+    assert(account.limits == bank.accounts["account-42"].limits);
+    assert(account.slots == bank.accounts["account-42"].slots);
+    assert(!view.find("account-100", account));
+    // Loading the whole object.
+    Bank copy;
+    source.reset(make_span(buf));
+    r = source.apply(copy);
+    assert(r && copy.accounts.size() == 100 && copy.branch == 7);
+    assert(copy.accounts["account-13"].limits == bank.accounts["account-13"]
+                                                     .limits);
+    // Skipping the map in a single step.
+    source.reset(make_span(buf));
+    source.set_field_mask(0b100);
+    copy = Bank{};
+    r = source.apply(copy);
+    assert(r && copy.accounts.empty() && copy.branch == 7);
+  }
+  std::cout << "nested maps: ok\n";
+  // Malformed input.
+  {
+    std::map<std::string, int32_t> xs{{"a", 1}, {"b", 2}};
+    byte_buffer buf;
+    binary_serializer sink(buf);
+    sink.set_indexed_maps(true);
+    auto r = sink.apply(xs);
+    assert(r);
+    for (size_t size = 0; size < buf.size(); ++size) {
+      map_view<std::string, int32_t> view{make_span(buf.data(), size)};
+      assert(!view.ok() && !view.contains("a"));
+    }
+    // An entry offset points past the entries.
+    auto tmp = buf;
+    tmp[1 + 4 + 3] = std::byte{0x7F};
+    map_view<std::string, int32_t> view{make_span(tmp)};
+    auto value = int32_t{0};
+    assert(view.ok() && view.find("b", value) && !view.find("a", value));
+  }
+  std::cout << "errors: ok\n";
+  return 0;
+}
@@ -0,0 +1,143 @@
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../src/message.hpp"
+
+class Point {
+public:
+  int32_t x;
+  int32_t y;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Point &p) {
+  return f.object(p).fields(f.field("x", p.x), f.field("y", p.y));
+}
+
+template <> struct type_id<Point> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+// Counts live instances and throws from its constructors on demand.
+class Fragile {
+public:
+  static inline int live = 0;
+  static inline bool fail = false;
+
+  int32_t value = 0;
+
+  Fragile() {
+    if (fail)
+      throw std::runtime_error("default");
+    ++live;
+  }
+
+  Fragile(const Fragile &other) : value(other.value) {
+    if (fail)
+      throw std::runtime_error("copy");
+    ++live;
+  }
+
+  ~Fragile() { --live; }
+};
+
+template <class Inspector> bool inspect(Inspector &f, Fragile &x) {
+  return f.object(x).fields(f.field("value", x.value));
+}
+
+template <> struct type_id<Fragile> {
+  static constexpr type_id_t value = first_custom_type_id + 1;
+};
+
+/// Returns whether `fun` throws.
+template <class F> bool throws(F fun) {
+  try {
+    fun();
+    return false;
+  } catch (const std::runtime_error &) {
+    return true;
+  }
+}
+
+int main() {
+  // builtin types are registered by default
+  auto meta = global_meta_object(type_id_v<stl_sting>);
+  assert(meta != nullptr && meta->size == sizeof(std::string));
+  assert(global_meta_object(first_custom_type_id) == nullptr);
+  register_meta_object<Point>();
+  assert(global_meta_object(first_custom_type_id) == &meta_object_for<Point>());
+  // construction and access
+  auto msg = message::make(int32_t{42}, std::string{"hello"}, 2.5,
+                           Point{1, 2});
+  assert(msg.size() == 4);
+  assert((msg.match_elements<int32_t, std::string, double, Point>()));
+  assert(!(msg.match_elements<int32_t, std::string>()));
+  assert(msg.get_as<int32_t>(0) == 42);
+  assert(msg.get_as<std::string>(1) == "hello");
+  assert(msg.get_as<double>(2) == 2.5);
+  assert(msg.get_as<Point>(3).y == 2);
+  for (size_t i = 0; i < msg.size(); ++i)
+    assert(reinterpret_cast<uintptr_t>(msg.get(i)) %
+               global_meta_object(msg.type_at(i))->alignment ==
+           0);
+  // copies are deep
+  auto copy = msg;
+  copy.get_mutable_as<std::string>(1) += " world";
+  assert(msg.get_as<std::string>(1) == "hello");
+  assert(copy.get_as<std::string>(1) == "hello world");
+  std::cout << "construction: ok\n";
+  // round trip through the registry
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  auto empty = message{};
+  auto r = sink.apply(msg) && sink.apply(empty);
+  assert(r);
+  binary_deserializer source{buf};
+  message loaded = message::make(std::string{"replaced"});
+  message loaded_empty = message::make(int8_t{1});
+  r = source.apply(loaded) && source.apply(loaded_empty);
+  assert(r);
+  assert(source.remaining() == 0);
+  assert((loaded.match_elements<int32_t, std::string, double, Point>()));
+  assert(loaded.get_as<int32_t>(0) == 42);
+  assert(loaded.get_as<std::string>(1) == "hello");
+  assert(loaded.get_as<double>(2) == 2.5);
+  assert(loaded.get_as<Point>(3).x == 1 && loaded.get_as<Point>(3).y == 2);
+  assert(loaded_empty.empty());
+  std::cout << "round trip: ok\n";
+  // unknown type IDs and truncated input are rejected
+  byte_buffer bad{std::byte{1}, std::byte{0x7F}, std::byte{0x7F}};
+  binary_deserializer bad_source{bad};
+  r = bad_source.apply(loaded);
+  assert(!r && loaded.size() == 4);
+  buf.resize(buf.size() - 3);
+  binary_deserializer short_source{buf};
+  r = short_source.apply(loaded);
+  assert(!r);
+  std::cout << "errors: ok\n";
+  // throwing constructors destroy only the elements constructed before
+  {
+    register_meta_object<Fragile>();
+    Fragile x;
+    auto fragile = message::make(x, std::string{"tail"}, x);
+    assert(Fragile::live == 3);
+    Fragile::fail = true;
+    assert(throws([&] { message::make(std::string{"head"}, x, x); }));
+    assert(throws([&] { message copy{fragile}; }));
+    assert(Fragile::live == 3);
+    byte_buffer fragile_buf;
+    binary_serializer fragile_sink(fragile_buf);
+    r = fragile_sink.apply(fragile);
+    assert(r);
+    binary_deserializer fragile_source{fragile_buf};
+    assert(throws([&] { static_cast<void>(fragile_source.apply(loaded)); }));
+    Fragile::fail = false;
+    assert(Fragile::live == 3 && loaded.size() == 4);
+  }
+  assert(Fragile::live == 0);
+  std::cout << "exceptions: ok\n";
+  return 0;
+}
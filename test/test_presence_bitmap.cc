@@ -0,0 +1,134 @@
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <variant>
+
+#include "../src/binary_deserializer.hpp"
+#include "../src/binary_serializer.hpp"
+
+class Address {
+public:
+  std::string city;
+  std::optional<std::string> street;
+  std::optional<int32_t> number;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Address &x) {
+  return f.object(x).fields(f.field("city", x.city),
+                            f.field("street", x.street),
+                            f.field("number", x.number));
+}
+
+bool operator==(const Address &x, const Address &y) {
+  return x.city == y.city && x.street == y.street && x.number == y.number;
+}
+
+class Profile {
+public:
+  int64_t id;
+  std::optional<std::string> name;
+  std::optional<std::string> email;
+  std::optional<int32_t> age;
+  std::optional<double> score;
+  std::optional<int64_t> parent;
+  std::optional<int64_t> group;
+  std::optional<uint8_t> level;
+  std::optional<uint16_t> flags;
+  int32_t region;
+  std::optional<Address> home;
+  std::optional<std::variant<int32_t, std::string>> tag;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Profile &x) {
+  return f.object(x).fields(
+      f.field("id", x.id), f.field("name", x.name), f.field("email", x.email),
+      f.field("age", x.age), f.field("score", x.score),
+      f.field("parent", x.parent), f.field("group", x.group),
+      f.field("level", x.level), f.field("flags", x.flags),
+      f.field("region", x.region).fallback(-1), f.field("home", x.home),
+      f.field("tag", x.tag));
+}
+
+bool operator==(const Profile &x, const Profile &y) {
+  return x.id == y.id && x.name == y.name && x.email == y.email &&
+         x.age == y.age && x.score == y.score && x.parent == y.parent &&
+         x.group == y.group && x.level == y.level && x.flags == y.flags &&
+         x.region == y.region && x.home == y.home && x.tag == y.tag;
+}
+
+template <> struct type_id<Address> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+template <> struct type_id<Profile> {
+  static constexpr type_id_t value = first_custom_type_id + 1;
+};
+
+size_t round_trip(const Profile &x, bool presence_bitmaps) {
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  sink.set_presence_bitmaps(presence_bitmaps);
+  sink.begin_checksum();
+  auto r = sink.apply(x) && sink.end_checksum();
+  assert(r);
+  Profile y;
+  binary_deserializer source{buf};
+  source.set_presence_bitmaps(presence_bitmaps);
+  source.begin_checksum();
+  r = source.apply(y) && source.verify_checksum();
+  assert(r);
+  assert(source.remaining() == 0);
+  assert(x == y);
+  return buf.size();
+}
+
+int main() {
+  // The eight optional fields, the fallback field and the nested optional
+  // object fit into two bytes. The optional variant encodes absence in its
+  // index.
+  static_assert(
+      decltype(std::declval<binary_serializer &>().field(
+          "", std::declval<std::optional<int32_t> &>()))::presence_flags == 1);
+  static_assert(
+      decltype(std::declval<binary_serializer &>().field(
+          "", std::declval<std::optional<std::variant<int32_t, std::string>>
+                               &>()))::presence_flags == 0);
+  Profile sparse;
+  sparse.id = 42;
+  sparse.region = -1;
+  sparse.age = 30;
+  assert(round_trip(sparse, true) + 8 == round_trip(sparse, false));
+  std::cout << "sparse: ok\n";
+  Profile full{1,
+               "alice",
+               "alice@example.org",
+               31,
+               4.5,
+               7,
+               8,
+               3,
+               0xFFFF,
+               5,
+               Address{"Hamburg", "Main St.", std::nullopt},
+               std::string{"admin"}};
+  assert(round_trip(full, true) + 9 == round_trip(full, false));
+  full.tag = 17;
+  full.home->street = std::nullopt;
+  round_trip(full, true);
+  std::cout << "full: ok\n";
+  // Truncated bitmaps fail to load.
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  sink.set_presence_bitmaps(true);
+  auto r = sink.apply(sparse);
+  assert(r);
+  Profile tmp;
+  binary_deserializer source{buf.data(), sizeof(int64_t) + 1};
+  source.set_presence_bitmaps(true);
+  r = source.apply(tmp);
+  assert(!r);
+  std::cout << "errors: ok\n";
+  return 0;
+}
@@ -0,0 +1,166 @@
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "../src/binary_deserializer.hpp"
+#include "../src/binary_serializer.hpp"
+#include "allocation_counter.hpp"
+
+class Address {
+public:
+  std::string city;
+  std::vector<std::string> lines;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Address &x) {
+  return f.object(x).fields(f.field("city", x.city), f.field("lines", x.lines));
+}
+
+bool operator==(const Address &x, const Address &y) {
+  return x.city == y.city && x.lines == y.lines;
+}
+
+class Record {
+public:
+  int64_t id = 0;
+  std::string name;
+  std::vector<double> prices;
+  Address address;
+  std::optional<std::string> note;
+  std::variant<int32_t, std::string> code;
+  std::map<std::string, int32_t> counters;
+  std::pair<std::u16string, bool> label;
+  std::array<int16_t, 3> dims = {};
+  std::optional<Address> billing;
+  std::vector<bool> bits;
+  int32_t version = 0;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Record &x) {
+  return f.object(x).fields(
+      f.field("id", x.id), f.field("name", x.name),
+      f.field("prices", x.prices), f.field("address", x.address),
+      f.field("note", x.note), f.field("code", x.code),
+      f.field("counters", x.counters), f.field("label", x.label),
+      f.field("dims", x.dims), f.field("billing", x.billing),
+      f.field("bits", x.bits), f.field("version", x.version));
+}
+
+template <> struct type_id<Address> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+template <> struct type_id<Record> {
+  static constexpr type_id_t value = first_custom_type_id + 1;
+};
+
+Record make_record(int64_t id) {
+  Record x;
+  x.id = id;
+  x.name = "a name that is long enough to live on the heap";
+  x.prices = {1.5, 2.5, 3.5};
+  x.address = Address{"Berlin", {"first line", "second line"}};
+  x.note = "a note that is long enough to live on the heap";
+  x.code = std::string{"a code that is long enough to live on the heap"};
+  x.counters = {{"a key that is long enough to live on the heap", 1}};
+  x.label = {u"label", true};
+  x.dims = {1, 2, 3};
+  x.billing = Address{"Paris", {"billing line"}};
+  x.bits = {true, false, true};
+  x.version = 7;
+  return x;
+}
+
+byte_buffer encode(const std::vector<Record> &xs, bool nested_object_lengths) {
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  sink.set_nested_object_lengths(nested_object_lengths);
+  for (auto &x : xs) {
+    auto r = sink.apply(x);
+    assert(r);
+  }
+  return buf;
+}
+
+int main() {
+  std::vector<Record> records{make_record(1), make_record(2), make_record(3)};
+  // All fields get loaded by default.
+  auto buf = encode(records, true);
+  {
+    binary_deserializer source{buf};
+    source.set_nested_object_lengths(true);
+    for (auto &expected : records) {
+      Record x;
+      auto r = source.apply(x);
+      assert(r);
+      assert(x.name == expected.name && x.address == expected.address);
+      assert(x.billing == expected.billing && x.version == expected.version);
+    }
+    assert(source.remaining() == 0);
+  }
+  std::cout << "all fields: ok\n";
+  // Selecting "id" and "version" skips the other fields without allocating.
+  {
+    binary_deserializer source{buf};
+    source.set_nested_object_lengths(true);
+    source.set_field_mask((uint64_t{1} << 0) | (uint64_t{1} << 11));
+    std::vector<Record> xs(records.size());
+    auto before = allocations;
+    for (auto &x : xs) {
+      auto r = source.apply(x);
+      assert(r);
+    }
+    assert(allocations == before);
+    assert(source.remaining() == 0);
+    for (size_t i = 0; i < xs.size(); ++i) {
+      assert(xs[i].id == records[i].id && xs[i].version == 7);
+      assert(xs[i].name.empty() && xs[i].prices.empty());
+      assert(!xs[i].note && !xs[i].billing && xs[i].counters.empty());
+    }
+  }
+  std::cout << "projection: ok\n";
+  // Selected nested objects get loaded with all of their fields.
+  {
+    binary_deserializer source{buf};
+    source.set_nested_object_lengths(true);
+    source.set_field_mask(uint64_t{1} << 9);
+    Record x;
+    auto r = source.apply(x);
+    assert(r);
+    assert(x.billing == records[0].billing && x.id == 0);
+  }
+  std::cout << "nested objects: ok\n";
+  // Without nested object lengths, skipped objects get loaded into
+  // temporaries.
+  {
+    auto plain = encode(records, false);
+    assert(plain.size() < buf.size());
+    binary_deserializer source{plain};
+    source.set_field_mask(uint64_t{1} << 11);
+    for (size_t i = 0; i < records.size(); ++i) {
+      Record x;
+      auto r = source.apply(x);
+      assert(r && x.version == 7 && !x.billing);
+    }
+    assert(source.remaining() == 0);
+  }
+  std::cout << "fallback: ok\n";
+  // Truncated input fails while skipping.
+  {
+    binary_deserializer source{buf.data(), 20};
+    source.set_nested_object_lengths(true);
+    source.set_field_mask(uint64_t{1} << 11);
+    Record x;
+    auto r = source.apply(x);
+    assert(!r);
+  }
+  std::cout << "errors: ok\n";
+  return 0;
+}
@@ -0,0 +1,188 @@
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "../src/schema_fingerprint.hpp"
+
+class Order {
+public:
+  int64_t id;
+  std::string symbol;
+  std::vector<int32_t> quantities;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Order &x) {
+  return f.object(x).fields(f.field("id", x.id), f.field("symbol", x.symbol),
+                            f.field("quantities", x.quantities));
+}
+
+// same layout as Order
+class OrderCopy {
+public:
+  int64_t id;
+  std::string symbol;
+  std::vector<int32_t> quantities;
+};
+
+template <class Inspector> bool inspect(Inspector &f, OrderCopy &x) {
+  return f.object(x).fields(f.field("id", x.id), f.field("symbol", x.symbol),
+                            f.field("quantities", x.quantities));
+}
+
+// wider element type
+class OrderV2 {
+public:
+  int64_t id;
+  std::string symbol;
+  std::vector<int64_t> quantities;
+};
+
+template <class Inspector> bool inspect(Inspector &f, OrderV2 &x) {
+  return f.object(x).fields(f.field("id", x.id), f.field("symbol", x.symbol),
+                            f.field("quantities", x.quantities));
+}
+
+// renamed field
+class OrderRenamed {
+public:
+  int64_t id;
+  std::string ticker;
+  std::vector<int32_t> quantities;
+};
+
+template <class Inspector> bool inspect(Inspector &f, OrderRenamed &x) {
+  return f.object(x).fields(f.field("id", x.id), f.field("ticker", x.ticker),
+                            f.field("quantities", x.quantities));
+}
+
+class Book {
+public:
+  std::map<std::string, std::vector<Order>> orders;
+  std::variant<int32_t, std::string> owner;
+  std::optional<double> limit;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Book &x) {
+  return f.object(x).fields(f.field("orders", x.orders),
+                            f.field("owner", x.owner),
+                            f.field("limit", x.limit));
+}
+
+class BookV2 {
+public:
+  std::map<std::string, std::vector<OrderV2>> orders;
+  std::variant<int32_t, std::string> owner;
+  std::optional<double> limit;
+};
+
+template <class Inspector> bool inspect(Inspector &f, BookV2 &x) {
+  return f.object(x).fields(f.field("orders", x.orders),
+                            f.field("owner", x.owner),
+                            f.field("limit", x.limit));
+}
+
+// recursive type
+class Tree {
+public:
+  int32_t value;
+  std::vector<Tree> children;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Tree &x) {
+  return f.object(x).fields(f.field("value", x.value),
+                            f.field("children", x.children));
+}
+
+// two versions of the same type, with the same type ID
+class Quote {
+public:
+  int32_t price;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Quote &x) {
+  return f.object(x).fields(f.field("price", x.price));
+}
+
+class QuoteV2 {
+public:
+  int64_t price;
+};
+
+template <class Inspector> bool inspect(Inspector &f, QuoteV2 &x) {
+  return f.object(x).fields(f.field("price", x.price));
+}
+
+template <> struct type_id<Quote> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+template <> struct type_id<QuoteV2> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+class Feed {
+public:
+  std::variant<int32_t, Quote> last;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Feed &x) {
+  return f.object(x).fields(f.field("last", x.last));
+}
+
+class FeedV2 {
+public:
+  std::variant<int32_t, QuoteV2> last;
+};
+
+template <class Inspector> bool inspect(Inspector &f, FeedV2 &x) {
+  return f.object(x).fields(f.field("last", x.last));
+}
+
+class OptionalFeed {
+public:
+  std::optional<std::variant<int32_t, Quote>> last;
+};
+
+template <class Inspector> bool inspect(Inspector &f, OptionalFeed &x) {
+  return f.object(x).fields(f.field("last", x.last));
+}
+
+class OptionalFeedV2 {
+public:
+  std::optional<std::variant<int32_t, QuoteV2>> last;
+};
+
+template <class Inspector> bool inspect(Inspector &f, OptionalFeedV2 &x) {
+  return f.object(x).fields(f.field("last", x.last));
+}
+
+int main() {
+  auto order = schema_fingerprint<Order>();
+  assert(order != 0);
+  assert(order == schema_fingerprint<Order>());
+  assert(order == schema_fingerprint<OrderCopy>());
+  assert(order != schema_fingerprint<OrderV2>());
+  assert(order != schema_fingerprint<OrderRenamed>());
+  std::cout << "flat objects: ok\n";
+  // changes in nested element types propagate to the outer fingerprint
+  assert(schema_fingerprint<Book>() != 0);
+  assert(schema_fingerprint<Book>() != schema_fingerprint<BookV2>());
+  assert(schema_fingerprint<std::vector<int32_t>>() !=
+         schema_fingerprint<std::vector<int64_t>>());
+  assert(schema_fingerprint<std::vector<int32_t>>() !=
+         schema_fingerprint<int32_t>());
+  std::cout << "nested objects: ok\n";
+  assert(schema_fingerprint<Tree>() != 0);
+  std::cout << "recursive objects: ok\n";
+  // changes in any alternative of a variant propagate as well
+  assert(schema_fingerprint<Feed>() != schema_fingerprint<FeedV2>());
+  assert(schema_fingerprint<OptionalFeed>() !=
+         schema_fingerprint<OptionalFeedV2>());
+  std::cout << "variants: ok\n";
+  return 0;
+}
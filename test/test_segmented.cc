@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/binary_serializer.hpp"
+#include "../src/segmented_deserializer.hpp"
+
+class Person {
+public:
+  std::string name;
+  int age;
+  std::vector<int64_t> scores;
+  std::u16string nick;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Person &x) {
+  return f.object(x).fields(f.field("name", x.name), f.field("age", x.age),
+                            f.field("scores", x.scores),
+                            f.field("nick", x.nick));
+}
+
+// splits `buf` into segments of `chunk` bytes each
+std::vector<span<const std::byte>> split(const byte_buffer &buf,
+                                         size_t chunk) {
+  std::vector<span<const std::byte>> result;
+  for (size_t pos = 0; pos < buf.size(); pos += chunk)
+    result.emplace_back(buf.data() + pos, std::min(chunk, buf.size() - pos));
+  return result;
+}
+
+int main() {
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  Person p{"a name longer than a few segments", 42, {1, -2, 300000}, u"nick"};
+  bool r = sink.apply(p) && sink.apply(3.5) && sink.apply(std::string{"end"});
+  assert(r);
+  for (size_t chunk : {1, 2, 3, 7, 16, 1024}) {
+    auto segments = split(buf, chunk);
+    segmented_deserializer source{make_span(segments)};
+    Person q;
+    double d = 0;
+    std::string s;
+    r = source.apply(q) && source.apply(d) && source.apply(s);
+    assert(r);
+    assert(q.name == p.name && q.age == p.age && q.scores == p.scores);
+    assert(q.nick == p.nick && d == 3.5 && s == "end");
+    assert(source.remaining() == 0);
+    std::cout << "chunk size " << chunk << ": ok\n";
+  }
+  // a truncated chain reports end of stream
+  auto segments = split(buf, 5);
+  segments.pop_back();
+  segmented_deserializer source{make_span(segments)};
+  std::string s;
+  Person q;
+  r = source.apply(q) && source.apply(s);
+  assert(!r);
+  return 0;
+}
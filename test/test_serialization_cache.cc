@@ -0,0 +1,180 @@
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/binary_deserializer.hpp"
+#include "../src/binary_serializer.hpp"
+#include "../src/serialization_cache.hpp"
+
+class Level {
+public:
+  int32_t price = 0;
+  int32_t size = 0;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Level &x) {
+  return f.object(x).fields(f.field("price", x.price),
+                            f.field("size", x.size));
+}
+
+class Instrument {
+public:
+  std::string symbol;
+  std::map<std::string, int32_t> limits;
+  std::vector<double> ticks;
+  std::vector<Level> levels;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Instrument &x) {
+  return f.object(x).fields(f.field("symbol", x.symbol),
+                            f.field("limits", x.limits),
+                            f.field("ticks", x.ticks),
+                            f.field("levels", x.levels));
+}
+
+class Order {
+public:
+  int64_t id = 0;
+  cacheable<Instrument> instrument;
+  int32_t quantity = 0;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Order &x) {
+  return f.object(x).fields(f.field("id", x.id),
+                            f.field("instrument", x.instrument),
+                            f.field("quantity", x.quantity));
+}
+
+template <> struct type_id<Instrument> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+template <> struct type_id<Order> {
+  static constexpr type_id_t value = first_custom_type_id + 1;
+};
+
+template <> struct type_id<Level> {
+  static constexpr type_id_t value = first_custom_type_id + 2;
+};
+
+std::shared_ptr<const Instrument> make_instrument(std::string symbol) {
+  auto x = std::make_shared<Instrument>();
+  x->symbol = std::move(symbol);
+  x->limits = {{"max", 1000}, {"min", 1}};
+  x->ticks.assign(50, 0.25);
+  x->levels = {{100, 5}, {101, 7}};
+  return x;
+}
+
+byte_buffer serialize(const Order &x, serialization_cache *cache,
+                      bool nested_object_lengths = false,
+                      bool columnar_lists = false) {
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  sink.set_cache(cache);
+  sink.set_nested_object_lengths(nested_object_lengths);
+  sink.set_columnar_lists(columnar_lists);
+  auto r = sink.apply(x);
+  assert(r);
+  return buf;
+}
+
+int main() {
+  auto instrument = make_instrument("ACME");
+  Order order{1, cacheable<Instrument>{instrument}, 10};
+  auto expected = serialize(order, nullptr);
+  // The first save fills the cache, later saves copy the bytes.
+  {
+    serialization_cache cache{1024};
+    assert(serialize(order, &cache) == expected);
+    assert(cache.hits() == 0 && cache.misses() == 1 && cache.entries() == 1);
+    for (int i = 0; i < 3; ++i)
+      assert(serialize(order, &cache) == expected);
+    assert(cache.hits() == 3 && cache.misses() == 1);
+    Order copy;
+    binary_deserializer source{expected};
+    auto r = source.apply(copy);
+    assert(r && copy.instrument->symbol == "ACME");
+    assert(copy.instrument->ticks == instrument->ticks);
+  }
+  std::cout << "hits: ok\n";
+  // Versions, hashes and serializer settings select different entries.
+  {
+    serialization_cache cache{4096};
+    serialize(order, &cache);
+    auto other = order;
+    other.instrument = cacheable<Instrument>{make_instrument("XYZ"), 1};
+    auto buf = serialize(other, &cache);
+    assert(buf == serialize(other, nullptr));
+    assert(cache.misses() == 2);
+    assert(serialize(order, &cache, true) == serialize(order, nullptr, true));
+    assert(cache.misses() == 3 && cache.entries() == 3);
+    auto columnar = serialize(order, &cache, false, true);
+    assert(columnar == serialize(order, nullptr, false, true));
+    assert(columnar != expected);
+    assert(cache.misses() == 4 && cache.entries() == 4);
+    auto a = order;
+    a.instrument = cacheable<Instrument>::with_hash(make_instrument("ACME"), 7);
+    auto b = order;
+    b.instrument = cacheable<Instrument>::with_hash(make_instrument("ACME"), 7);
+    assert(serialize(a, &cache) == expected);
+    assert(serialize(b, &cache) == expected);
+    assert(cache.hits() == 1 && cache.misses() == 5);
+  }
+  std::cout << "keys: ok\n";
+  // The cache evicts the least recently used entries.
+  {
+    byte_buffer buf;
+    binary_serializer sink(buf);
+    auto r = sink.apply(*instrument);
+    assert(r);
+    serialization_cache cache{2 * buf.size()};
+    std::vector<Order> orders;
+    for (int i = 0; i < 3; ++i)
+      orders.push_back(
+          Order{i, cacheable<Instrument>{make_instrument("ACME")}, 1});
+    serialize(orders[0], &cache);
+    serialize(orders[1], &cache);
+    serialize(orders[0], &cache);
+    serialize(orders[2], &cache);
+    assert(cache.entries() == 2 && cache.size() <= cache.capacity());
+    serialize(orders[0], &cache);
+    assert(cache.hits() == 2);
+    serialize(orders[1], &cache);
+    assert(cache.hits() == 2 && cache.misses() == 4);
+    serialization_cache tiny{buf.size() - 1};
+    serialize(order, &tiny);
+    assert(tiny.entries() == 0);
+  }
+  std::cout << "eviction: ok\n";
+  // Saving a cacheable without a value fails.
+  {
+    byte_buffer buf;
+    binary_serializer sink(buf);
+    assert(!sink.apply(Order{}));
+  }
+  std::cout << "errors: ok\n";
+  // Concurrent serializers share one cache.
+  {
+    serialization_cache cache{1024};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i)
+      threads.emplace_back([&] {
+        for (int j = 0; j < 100; ++j) {
+          auto r = serialize(order, &cache) == expected;
+          assert(r);
+          static_cast<void>(r);
+        }
+      });
+    for (auto &t : threads)
+      t.join();
+    assert(cache.hits() + cache.misses() == 400 && cache.entries() == 1);
+  }
+  std::cout << "threads: ok\n";
+  return 0;
+}
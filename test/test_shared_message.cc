@@ -0,0 +1,102 @@
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/binary_serializer.hpp"
+#include "../src/shared_message.hpp"
+
+// Counts how often any thread decodes a `Quote`.
+static std::atomic<size_t> loads{0};
+
+class Quote {
+public:
+  std::string symbol;
+  std::vector<double> prices;
+  int64_t timestamp = 0;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Quote &x) {
+  return f.object(x)
+      .on_load([] {
+        ++loads;
+        return true;
+      })
+      .fields(f.field("symbol", x.symbol), f.field("prices", x.prices),
+              f.field("timestamp", x.timestamp));
+}
+
+template <> struct type_id<Quote> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+byte_buffer make_bytes(bool typed_stream = false) {
+  Quote x;
+  x.symbol = "ACME";
+  x.prices.assign(100, 1.5);
+  x.timestamp = 42;
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  sink.set_typed_stream(typed_stream);
+  auto r = sink.apply(x);
+  assert(r);
+  return buf;
+}
+
+int main() {
+  // Copies share the decoded value.
+  {
+    shared_message<Quote> msg{make_bytes()};
+    auto copy = msg;
+    assert(msg.use_count() == 2 && !copy.decoded());
+    assert(msg.bytes().size() == make_bytes().size());
+    auto before = loads.load();
+    assert(copy->symbol == "ACME" && copy->timestamp == 42);
+    assert(msg.decoded() && loads == before + 1);
+    assert(msg.get() == copy.get() && msg->prices.size() == 100);
+    assert(msg.get_error() == error_code::success && loads == before + 1);
+  }
+  std::cout << "copies: ok\n";
+  // Concurrent readers decode the buffer once.
+  {
+    shared_message<Quote> msg{make_bytes()};
+    auto before = loads.load();
+    std::vector<std::thread> threads;
+    std::atomic<size_t> matches{0};
+    for (int i = 0; i < 16; ++i)
+      threads.emplace_back([msg, &matches] {
+        if (msg.get() != nullptr && msg->timestamp == 42)
+          ++matches;
+      });
+    for (auto &t : threads)
+      t.join();
+    assert(matches == 16 && loads == before + 1);
+    assert(msg.use_count() == 1);
+  }
+  std::cout << "threads: ok\n";
+  // Configuring the deserializer.
+  {
+    auto typed = [](binary_deserializer &source) {
+      source.set_typed_stream(true);
+    };
+    shared_message<Quote> msg{make_bytes(true), typed};
+    assert(msg.get() != nullptr && msg->symbol == "ACME");
+  }
+  std::cout << "configure: ok\n";
+  // Invalid buffers fail for all readers.
+  {
+    auto bytes = make_bytes();
+    bytes.resize(bytes.size() / 2);
+    shared_message<Quote> msg{bytes};
+    auto copy = msg;
+    assert(msg.get() == nullptr && copy.get() == nullptr);
+    assert(copy.get_error() != error_code::success && msg.decoded());
+    shared_message<Quote> empty;
+    assert(!empty && empty.get() == nullptr && !empty.decoded());
+  }
+  std::cout << "errors: ok\n";
+  return 0;
+}
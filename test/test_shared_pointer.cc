@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../src/binary_deserializer.hpp"
+#include "../src/binary_serializer.hpp"
+#include "../src/incremental_deserializer.hpp"
+#include "../src/schema_fingerprint.hpp"
+#include "../src/segmented_deserializer.hpp"
+
+class Profile {
+public:
+  std::string name;
+  std::vector<int32_t> scores;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Profile &x) {
+  return f.object(x).fields(f.field("name", x.name),
+                            f.field("scores", x.scores));
+}
+
+class Node {
+public:
+  int32_t id = 0;
+  std::vector<std::shared_ptr<Node>> children;
+  std::unique_ptr<Profile> profile;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Node &x) {
+  return f.object(x).fields(f.field("id", x.id),
+                            f.field("children", x.children),
+                            f.field("profile", x.profile));
+}
+
+class Feed {
+public:
+  std::vector<std::shared_ptr<const Profile>> authors;
+  std::shared_ptr<Node> root;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Feed &x) {
+  return f.object(x).fields(f.field("authors", x.authors),
+                            f.field("root", x.root));
+}
+
+template <> struct type_id<Profile> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+template <> struct type_id<Node> {
+  static constexpr type_id_t value = first_custom_type_id + 1;
+};
+
+template <> struct type_id<Feed> {
+  static constexpr type_id_t value = first_custom_type_id + 2;
+};
+
+std::shared_ptr<const Profile> make_profile(std::string name) {
+  auto x = std::make_shared<Profile>();
+  x->name = std::move(name);
+  x->scores.assign(100, 7);
+  return x;
+}
+
+template <class T> byte_buffer serialize(const T &x) {
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  auto r = sink.apply(x);
+  assert(r);
+  return buf;
+}
+
+int main() {
+  // Each distinct object gets written once.
+  {
+    auto alice = make_profile("alice");
+    auto bob = make_profile("bob");
+    Feed feed;
+    for (int i = 0; i < 50; ++i)
+      feed.authors.push_back(i % 2 == 0 ? alice : bob);
+    feed.authors.push_back(nullptr);
+    auto buf = serialize(feed);
+    Feed flat;
+    for (auto &author : feed.authors)
+      flat.authors.push_back(author ? std::make_shared<Profile>(*author)
+                                    : nullptr);
+    assert(buf.size() * 10 < serialize(flat).size());
+    Feed copy;
+    binary_deserializer source{buf};
+    auto r = source.apply(copy);
+    assert(r && source.remaining() == 0 && copy.authors.size() == 51);
+    assert(copy.authors[0]->name == "alice" && copy.authors[1]->name == "bob");
+    for (size_t i = 2; i < 50; ++i)
+      assert(copy.authors[i] == copy.authors[i % 2]);
+    assert(copy.authors[50] == nullptr && copy.root == nullptr);
+    // Objects get shared only within one top-level object.
+    Feed other;
+    source.reset(buf);
+    r = source.apply(other);
+    assert(r && other.authors[0] != copy.authors[0]);
+  }
+  std::cout << "dedup: ok\n";
+  // Graphs with diamonds and cycles.
+  {
+    auto shared = std::make_shared<Node>();
+    shared->id = 3;
+    shared->profile = std::make_unique<Profile>();
+    shared->profile->name = "leaf";
+    auto left = std::make_shared<Node>();
+    left->id = 1;
+    left->children = {shared};
+    auto right = std::make_shared<Node>();
+    right->id = 2;
+    right->children = {shared, shared};
+    Feed feed;
+    feed.root = std::make_shared<Node>();
+    feed.root->children = {left, right};
+    // Adds a cycle from the leaf back to the root.
+    shared->children = {feed.root};
+    auto buf = serialize(feed);
+    shared->children.clear();
+    Feed copy;
+    binary_deserializer source{buf};
+    auto r = source.apply(copy);
+    assert(r && source.remaining() == 0);
+    auto &root = copy.root;
+    auto &leaf = root->children[0]->children[0];
+    assert(leaf->id == 3 && leaf->profile->name == "leaf");
+    assert(root->children[1]->children[0] == leaf);
+    assert(root->children[1]->children[1] == leaf);
+    assert(leaf->children.size() == 1 && leaf->children[0] == root);
+    leaf->children.clear();
+  }
+  std::cout << "graphs: ok\n";
+  // Segmented and incremental input.
+  {
+    auto shared = std::make_shared<Node>();
+    shared->id = 7;
+    Feed feed;
+    feed.authors = {make_profile("carol"), nullptr};
+    feed.authors[1] = feed.authors[0];
+    feed.root = std::make_shared<Node>();
+    feed.root->children = {shared, shared};
+    auto buf = serialize(feed);
+    auto check = [](const Feed &copy) {
+      assert(copy.authors.size() == 2 && copy.authors[0]->name == "carol");
+      assert(copy.authors[0] == copy.authors[1]);
+      auto &children = copy.root->children;
+      assert(children.size() == 2 && children[0]->id == 7);
+      assert(children[0] == children[1]);
+    };
+    for (size_t segment_size : {size_t{1}, size_t{3}, size_t{64}}) {
+      std::vector<span<const std::byte>> segments;
+      for (size_t pos = 0; pos < buf.size(); pos += segment_size) {
+        auto n = std::min(segment_size, buf.size() - pos);
+        segments.push_back(make_span(buf.data() + pos, n));
+      }
+      Feed copy;
+      segmented_deserializer source{make_span(segments)};
+      auto r = source.apply(copy);
+      assert(r && source.remaining() == 0);
+      check(copy);
+    }
+    incremental_deserializer<Feed> decoder;
+    auto status = decode_status::need_more;
+    for (size_t pos = 0; pos < buf.size(); pos += 3) {
+      auto n = std::min(size_t{3}, buf.size() - pos);
+      status = decoder.feed(make_span(buf.data() + pos, n));
+      assert(status != decode_status::failed);
+    }
+    assert(status == decode_status::done);
+    check(decoder.value());
+  }
+  std::cout << "segments: ok\n";
+  // Shared objects outside of objects.
+  {
+    auto str = std::make_shared<std::string>(100, 'x');
+    std::vector<std::shared_ptr<std::string>> xs{str, str, str};
+    auto buf = serialize(xs);
+    assert(buf.size() < 110);
+    std::vector<std::shared_ptr<std::string>> ys;
+    binary_deserializer source{buf};
+    auto r = source.apply(ys);
+    assert(r && ys.size() == 3 && *ys[0] == *str);
+    assert(ys[0] == ys[1] && ys[1] == ys[2]);
+  }
+  std::cout << "values: ok\n";
+  // Invalid back-references.
+  {
+    auto alice = std::make_shared<const Profile>(Profile{"a", {}});
+    Feed feed;
+    feed.authors = {alice, alice};
+    auto buf = serialize(feed);
+    // The back-reference is the byte before the `root` pointer.
+    auto &tag = buf[buf.size() - 2];
+    assert(tag == std::byte{5});
+    tag = std::byte{6};
+    Feed copy;
+    binary_deserializer source{buf};
+    assert(!source.apply(copy));
+    // Back-references to an object of another type.
+    auto str = std::make_shared<std::string>("abc");
+    byte_buffer bad;
+    binary_serializer sink(bad);
+    auto r = sink.apply(str) && sink.begin_sequence(bad.size() + 1);
+    assert(r);
+    std::shared_ptr<std::string> x;
+    std::shared_ptr<std::string> y;
+    binary_deserializer same{bad};
+    r = same.apply(x) && same.apply(y);
+    assert(r && x == y);
+    std::shared_ptr<std::u32string> z;
+    binary_deserializer other{bad};
+    r = other.apply(x) && other.apply(z);
+    assert(!r && z == nullptr);
+  }
+  std::cout << "errors: ok\n";
+  // Recursive types have a fingerprint.
+  assert(schema_fingerprint<Node>() != schema_fingerprint<Profile>());
+  std::cout << "fingerprint: ok\n";
+  return 0;
+}
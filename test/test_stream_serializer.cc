@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/binary_serializer.hpp"
+#include "../src/incremental_deserializer.hpp"
+#include "../src/stream_serializer.hpp"
+
+class Reply {
+public:
+  std::string status;
+  std::vector<std::string> rows;
+  std::vector<int64_t> ids;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Reply &x) {
+  return f.object(x).fields(f.field("status", x.status),
+                            f.field("rows", x.rows), f.field("ids", x.ids));
+}
+
+int main() {
+  Reply reply;
+  reply.status = "ok";
+  for (int i = 0; i < 10000; ++i) {
+    reply.rows.emplace_back("row number " + std::to_string(i));
+    reply.ids.emplace_back(i * 7);
+  }
+  reply.rows.emplace_back(std::string(5000, 'x'));
+  // reference encoding
+  byte_buffer expected;
+  binary_serializer ref(expected);
+  bool r = ref.apply(reply);
+  assert(r);
+  // loopback: the sink pushes each piece straight into the receiver
+  constexpr size_t capacity = 512;
+  incremental_deserializer<Reply> receiver;
+  byte_buffer received;
+  size_t largest_piece = 0;
+  size_t decoded = 0;
+  auto sink = [&](span<const std::byte> bytes) {
+    largest_piece = std::max(largest_piece, bytes.size());
+    received.insert(received.end(), bytes.begin(), bytes.end());
+    if (receiver.feed(bytes) == decode_status::done)
+      ++decoded;
+    return true;
+  };
+  stream_serializer<decltype(sink)> out{sink, capacity};
+  r = out.apply(reply) && out.flush();
+  assert(r);
+  assert(received == expected);
+  assert(out.total() == expected.size());
+  assert(decoded == 1);
+  assert(receiver.value().rows == reply.rows);
+  assert(receiver.value().ids == reply.ids);
+  std::cout << "encoded " << expected.size() << " bytes, largest window "
+            << largest_piece << " bytes\n";
+  return 0;
+}
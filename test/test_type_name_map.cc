@@ -0,0 +1,58 @@
+#include <cassert>
+#include <iostream>
+#include <string>
+
+#include "../src/type_name_map.hpp"
+
+class Point {};
+
+class Line {};
+
+template <> struct type_id<Point> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+template <> struct type_name<Point> {
+  static constexpr std::string_view value = "point";
+};
+
+template <> struct type_id<Line> {
+  static constexpr type_id_t value = first_custom_type_id + 1;
+};
+
+template <> struct type_name<Line> {
+  static constexpr std::string_view value = "line";
+};
+
+#define MyTypes(_)                                                             \
+  _(Point)                                                                     \
+  _(Line)
+
+constexpr type_name_entry my_names[] = {Lists(TypeNameEntry)
+                                            MyTypes(TypeNameEntry)};
+
+constexpr type_name_map<std::size(my_names)> my_type_names{my_names};
+
+// lookups work at compile time
+static_assert(type_id_by_name("udf_bool") == type_id_v<bool>);
+static_assert(type_id_by_name("udf_stl_sting") == type_id_v<std::string>);
+static_assert(type_id_by_name("point") == invalid_type_id);
+static_assert(my_type_names.find("point") == type_id_v<Point>);
+
+int main() {
+  for (auto &entry : builtin_type_names)
+    assert(type_id_by_name(std::string{entry.name}) == entry.id);
+  for (auto &entry : my_names)
+    assert(my_type_names.find(std::string{entry.name}) == entry.id);
+  assert(type_id_by_name("") == invalid_type_id);
+  assert(type_id_by_name("udf_boo") == invalid_type_id);
+  assert(type_id_by_name("udf_bool ") == invalid_type_id);
+  assert(my_type_names.find("udf_line") == invalid_type_id);
+  std::cout << "lookups: ok\n";
+  // duplicate names resolve to the first entry
+  constexpr type_name_entry dups[] = {{"a", 1}, {"b", 2}, {"a", 3}};
+  constexpr type_name_map<3> dup_map{dups};
+  static_assert(dup_map.find("a") == 1 && dup_map.find("b") == 2);
+  std::cout << "duplicates: ok\n";
+  return 0;
+}
@@ -0,0 +1,135 @@
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/binary_serializer.hpp"
+#include "../src/typed_dispatcher.hpp"
+
+class Login {
+public:
+  std::string user;
+  int64_t time;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Login &x) {
+  return f.object(x).fields(f.field("user", x.user), f.field("time", x.time));
+}
+
+class Trade {
+public:
+  int32_t instrument;
+  std::vector<int64_t> prices;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Trade &x) {
+  return f.object(x).fields(f.field("instrument", x.instrument),
+                            f.field("prices", x.prices));
+}
+
+class Heartbeat {
+public:
+  int64_t time;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Heartbeat &x) {
+  return f.object(x).fields(f.field("time", x.time));
+}
+
+class Rejected {
+public:
+  Heartbeat beat;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Rejected &x) {
+  return f.object(x)
+      .on_save([] { return false; })
+      .fields(f.field("beat", x.beat));
+}
+
+template <> struct type_id<Login> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+template <> struct type_id<Trade> {
+  static constexpr type_id_t value = first_custom_type_id + 1;
+};
+
+template <> struct type_id<Heartbeat> {
+  static constexpr type_id_t value = first_custom_type_id + 2;
+};
+
+template <> struct type_id<Rejected> {
+  static constexpr type_id_t value = first_custom_type_id + 3;
+};
+
+int main() {
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  sink.set_typed_stream(true);
+  sink.begin_checksum();
+  Trade big{7, std::vector<int64_t>(2000, 42)};
+  auto r = sink.apply(Login{"alice", 1}) && sink.apply(Heartbeat{2}) &&
+           sink.apply(big) && sink.apply(Heartbeat{3}) &&
+           sink.apply(Login{"bob", 4});
+  assert(r);
+  r = sink.end_checksum();
+  assert(r);
+  // Objects without handler get skipped.
+  std::vector<std::string> users;
+  size_t trades = 0;
+  typed_dispatcher dispatcher;
+  dispatcher.add<Login>([&](Login &x) { users.emplace_back(x.user); });
+  dispatcher.add<Trade>([&](Trade &x) {
+    assert(x.prices == big.prices);
+    ++trades;
+  });
+  binary_deserializer source{buf};
+  source.set_typed_stream(true);
+  source.begin_checksum();
+  type_id_t type = 0;
+  r = source.fetch_next_object_type(type);
+  assert(r && type == type_id_v<Login>);
+  for (int i = 0; i < 5; ++i) {
+    r = dispatcher.dispatch(source);
+    assert(r);
+  }
+  r = source.verify_checksum();
+  assert(r);
+  assert(source.remaining() == 0);
+  assert((users == std::vector<std::string>{"alice", "bob"}));
+  assert(trades == 1 && dispatcher.skipped() == 2);
+  std::cout << "dispatch: ok\n";
+  // Loading an object of the wrong type fails.
+  binary_deserializer typed_source{buf};
+  typed_source.set_typed_stream(true);
+  Trade trade;
+  r = typed_source.apply(trade);
+  assert(!r && typed_source.depth() == 0);
+  // Failed objects leave the serializer at the top level.
+  byte_buffer after_error;
+  binary_serializer error_sink(after_error);
+  error_sink.set_typed_stream(true);
+  r = error_sink.apply(Rejected{});
+  assert(!r && error_sink.depth() == 0);
+  after_error.clear();
+  error_sink.seek(0);
+  r = error_sink.apply(Heartbeat{6});
+  assert(r && after_error.size() == sizeof(type_id_t) + 4 + sizeof(int64_t));
+  Heartbeat beat;
+  binary_deserializer error_source{after_error};
+  error_source.set_typed_stream(true);
+  r = error_source.apply(beat);
+  assert(r && beat.time == 6);
+  // Without the typed stream mode, objects carry no type information.
+  byte_buffer plain;
+  binary_serializer plain_sink(plain);
+  r = plain_sink.apply(Heartbeat{5});
+  assert(r && plain.size() == sizeof(int64_t));
+  binary_deserializer plain_source{plain};
+  r = plain_source.fetch_next_object_type(type);
+  assert(!r);
+  std::cout << "errors: ok\n";
+  return 0;
+}
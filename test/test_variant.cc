@@ -0,0 +1,55 @@
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <variant>
+
+#include "../src/binary_deserializer.hpp"
+#include "../src/binary_serializer.hpp"
+
+using payload = std::variant<int32_t, double, std::string>;
+
+class Event {
+public:
+  int32_t id;
+  payload value;
+  std::optional<payload> extra;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Event &x) {
+  return f.object(x).fields(f.field("id", x.id), f.field("value", x.value),
+                            f.field("extra", x.extra));
+}
+
+int main() {
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  Event events[] = {{1, int32_t{7}, std::nullopt},
+                    {2, 2.5, payload{std::string{"x"}}},
+                    {3, std::string{"a string value"}, payload{int32_t{-1}}}};
+  for (auto &event : events) {
+    auto r = sink.apply(event);
+    assert(r);
+  }
+  // Loading into an Event that holds another alternative replaces it.
+  binary_deserializer source{buf};
+  Event e{0, std::string{"previous"}, payload{1.0}};
+  for (auto &event : events) {
+    auto r = source.apply(e);
+    assert(r);
+    assert(e.id == event.id && e.value == event.value);
+    assert(e.extra == event.extra);
+  }
+  assert(source.remaining() == 0);
+  std::cout << "round trip: ok\n";
+  // An alternative index beyond the last alternative is rejected.
+  byte_buffer bad{std::byte{0}, std::byte{0}, std::byte{0}, std::byte{4},
+                  std::byte{3}, std::byte{0}, std::byte{0}, std::byte{0},
+                  std::byte{0}};
+  binary_deserializer bad_source{bad};
+  auto r = bad_source.apply(e);
+  assert(!r);
+  std::cout << "invalid index: ok\n";
+  return 0;
+}
@@ -0,0 +1,218 @@
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "../src/binary_deserializer.hpp"
+#include "../src/binary_serializer.hpp"
+#include "allocation_counter.hpp"
+
+static size_t callbacks = 0;
+
+class Item {
+public:
+  std::string sku;
+  int32_t count = 0;
+  bool gift = false;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Item &x) {
+  return f.object(x)
+      .on_load([] {
+        ++callbacks;
+        return true;
+      })
+      .fields(f.field("sku", x.sku), f.field("count", x.count),
+              f.field("gift", x.gift));
+}
+
+class Order {
+public:
+  int64_t id = 0;
+  bool paid = false;
+  std::vector<Item> items;
+  std::optional<std::string> note;
+  std::variant<int32_t, std::string> customer;
+  std::map<std::string, std::vector<bool>> flags;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Order &x) {
+  return f.object(x).fields(f.field("id", x.id), f.field("paid", x.paid),
+                            f.field("items", x.items), f.field("note", x.note),
+                            f.field("customer", x.customer),
+                            f.field("flags", x.flags));
+}
+
+class Leaf {
+public:
+  int32_t value = 0;
+};
+
+template <class Inspector> bool inspect(Inspector &f, Leaf &x) {
+  return f.object(x).fields(f.field("value", x.value));
+}
+
+using timestamp = std::chrono::time_point<std::chrono::system_clock,
+                                          std::chrono::milliseconds>;
+
+// Fields with custom `inspector_access` specializations.
+class Tree {
+public:
+  std::unique_ptr<Leaf> left;
+  std::shared_ptr<Leaf> right;
+  std::shared_ptr<Leaf> same;
+  std::unique_ptr<Leaf> none;
+  timestamp time;
+  std::chrono::seconds timeout{0};
+};
+
+template <class Inspector> bool inspect(Inspector &f, Tree &x) {
+  return f.object(x).fields(f.field("left", x.left), f.field("right", x.right),
+                            f.field("same", x.same), f.field("none", x.none),
+                            f.field("time", x.time),
+                            f.field("timeout", x.timeout));
+}
+
+template <> struct type_id<Item> {
+  static constexpr type_id_t value = first_custom_type_id;
+};
+
+template <> struct type_id<Order> {
+  static constexpr type_id_t value = first_custom_type_id + 1;
+};
+
+Order make_order() {
+  Order x;
+  x.id = 42;
+  x.paid = true;
+  x.items = {Item{"apple", 3, false}, Item{"pear", 1, true}};
+  x.note = "leave at the door";
+  x.customer = std::string{"bob"};
+  x.flags = {{"express", {true, false}}};
+  return x;
+}
+
+byte_buffer encode(const Order &x, bool nested_object_lengths) {
+  byte_buffer buf;
+  binary_serializer sink(buf);
+  sink.set_nested_object_lengths(nested_object_lengths);
+  auto r = sink.apply(x);
+  assert(r);
+  return buf;
+}
+
+bool verify(const byte_buffer &buf, bool nested_object_lengths = false) {
+  binary_deserializer source{buf};
+  source.set_nested_object_lengths(nested_object_lengths);
+  return source.verify<Order>() && source.remaining() == 0;
+}
+
+int main() {
+  auto buf = encode(make_order(), false);
+  // Layout: id (8), paid (1), items: count (1), "apple" (1 + 5), 3 (4),
+  // false (1), "pear" (1 + 4), 1 (4), true (1), note: flag (1), ...
+  constexpr size_t paid_pos = 8;
+  constexpr size_t items_pos = 9;
+  constexpr size_t gift_pos = 10 + 6 + 4;
+  constexpr size_t note_pos = 10 + 2 * 11 - 1;
+  assert(verify(buf));
+  auto before = allocations;
+  assert(verify(buf));
+  assert(allocations == before);
+  assert(callbacks == 0);
+  std::cout << "valid: ok\n";
+  {
+    auto tmp = buf;
+    tmp[paid_pos] = std::byte{2};
+    assert(!verify(tmp));
+    tmp = buf;
+    tmp[gift_pos] = std::byte{7};
+    assert(!verify(tmp));
+    tmp = buf;
+    tmp[note_pos] = std::byte{2};
+    assert(!verify(tmp));
+    // The element count exceeds the input.
+    tmp = buf;
+    tmp[items_pos] = std::byte{0x7F};
+    assert(!verify(tmp));
+    // The variant index is out of bounds.
+    auto order = make_order();
+    order.note = std::nullopt;
+    tmp = encode(order, false);
+    auto customer_pos = note_pos + 1;
+    assert(verify(tmp));
+    tmp[customer_pos] = std::byte{2};
+    assert(!verify(tmp));
+    // Truncated input.
+    for (size_t size = 0; size < buf.size(); ++size) {
+      binary_deserializer source{buf.data(), size};
+      assert(!source.verify<Order>());
+    }
+  }
+  std::cout << "invalid: ok\n";
+  {
+    auto tmp = encode(make_order(), true);
+    assert(verify(tmp, true));
+    // The size of the first item does not match its encoding.
+    auto size_pos = items_pos + 1 + 3;
+    assert(tmp[size_pos] == std::byte{11});
+    tmp[size_pos] = std::byte{10};
+    assert(!verify(tmp, true));
+  }
+  std::cout << "nested object lengths: ok\n";
+  {
+    Tree tree;
+    tree.left = std::make_unique<Leaf>(Leaf{1});
+    tree.right = std::make_shared<Leaf>(Leaf{2});
+    tree.same = tree.right;
+    tree.time = timestamp{std::chrono::milliseconds{1700000000000}};
+    tree.timeout = std::chrono::seconds{30};
+    byte_buffer tmp;
+    binary_serializer sink(tmp);
+    auto r = sink.apply(tree);
+    assert(r);
+    binary_deserializer source{tmp};
+    auto before = allocations;
+    r = source.verify<Tree>();
+    assert(r && source.remaining() == 0 && allocations == before);
+    // The tag of a unique pointer cannot be a back-reference.
+    tmp[0] = std::byte{2};
+    source.reset(tmp);
+    assert(!source.verify<Tree>());
+    for (size_t size = 0; size < tmp.size(); ++size) {
+      source.reset(make_span(tmp.data(), size));
+      assert(!source.verify<Tree>());
+    }
+  }
+  std::cout << "custom access: ok\n";
+  // Sizes with more than 32 bits.
+  {
+    byte_buffer tmp{std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF},
+                    std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF},
+                    std::byte{0x00}};
+    binary_deserializer source{tmp};
+    assert(!source.verify<std::string>() && !source.truncated());
+    tmp = {std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF},
+           std::byte{0x1F}};
+    source.reset(tmp);
+    assert(!source.verify<std::string>() && !source.truncated());
+    // The largest size is valid, but exceeds the input.
+    tmp[4] = std::byte{0x0F};
+    source.reset(tmp);
+    assert(!source.verify<std::string>() && source.truncated());
+  }
+  std::cout << "sizes: ok\n";
+  // Loading still runs the callbacks.
+  Order x;
+  binary_deserializer source{buf};
+  auto r = source.apply(x);
+  assert(r && callbacks == 2 && x.items[1].gift);
+  std::cout << "load: ok\n";
+  return 0;
+}